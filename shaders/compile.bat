@@ -1,2 +1,4 @@
-glslc.exe shader.vert -o vert.spv
-glslc.exe shader.frag -o frag.spv
\ No newline at end of file
+glslc.exe --target-env=vulkan1.2 shader.vert -o vert.spv
+glslc.exe --target-env=vulkan1.2 shader.frag -o frag.spv
+glslc.exe --target-env=vulkan1.2 cull.comp -o cull.spv
+glslc.exe --target-env=vulkan1.2 compact.comp -o compact.spv
\ No newline at end of file
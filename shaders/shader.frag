@@ -1,12 +1,16 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragTextureIndex;
 
 layout(location = 0) out vec4 outColor;
 
-layout(binding = 1) uniform sampler2D u_texSampler;
+// Bindless texture table, see BindlessTextureTable
+layout(set = 1, binding = 0) uniform sampler u_sampler;
+layout(set = 1, binding = 1) uniform texture2D u_textures[];
 
 void main() {
-    outColor = texture(u_texSampler, fragTexCoord);
+    outColor = texture(sampler2D(u_textures[nonuniformEXT(fragTextureIndex)], u_sampler), fragTexCoord);
 }
\ No newline at end of file
@@ -1,8 +1,7 @@
 #version 450
 #extension GL_KHR_vulkan_glsl : enable
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
+layout(set = 0, binding = 0) uniform UniformBufferObject {
     mat4 view;
     mat4 proj;
 } ubo;
@@ -11,11 +10,17 @@ layout(location = 0) in vec3 vao_inPosition;
 layout(location = 1) in vec3 vao_inColor;
 layout(location = 2) in vec2 vao_inTexCoord;
 
+// Per instance, see InstanceData. The matrix takes up locations 3 to 6
+layout(location = 3) in mat4 inst_inModel;
+layout(location = 7) in uint inst_inTextureIndex;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTextureIndex;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(vao_inPosition, 1.0);
+    gl_Position = ubo.proj * ubo.view * inst_inModel * vec4(vao_inPosition, 1.0);
     fragColor = vao_inColor;
     fragTexCoord = vao_inTexCoord;
+    fragTextureIndex = inst_inTextureIndex;
 }
\ No newline at end of file
@@ -1,5 +1,18 @@
 #include "files.h"
 
+#include <filesystem>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace Engine
 {
 	void Filesystem::ReadFile(const std::string& Filename, std::vector<char>& data)
@@ -20,4 +33,87 @@ namespace Engine
 
 		file.close();
 	}
+
+	bool Filesystem::FileExists(const std::string& Filename)
+	{
+		std::error_code error;
+		return std::filesystem::is_regular_file(Filename, error);
+	}
+
+	void MappedFile::Open(const std::string& Filename)
+	{
+		Close();
+
+#ifdef _WIN32
+		auto file = CreateFileA(Filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("Failed to open file.");
+
+		LARGE_INTEGER fileSize{};
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			CloseHandle(file);
+			throw std::runtime_error("Failed to get file size.");
+		}
+
+		auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+		{
+			CloseHandle(file);
+			throw std::runtime_error("Failed to map file.");
+		}
+
+		auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!view)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			throw std::runtime_error("Failed to map file.");
+		}
+
+		this->FileHandle = file;
+		this->MappingHandle = mapping;
+		this->Data = static_cast<const uint8_t*>(view);
+		this->Size = static_cast<size_t>(fileSize.QuadPart);
+#else
+		auto file = open(Filename.c_str(), O_RDONLY);
+		if (file < 0)
+			throw std::runtime_error("Failed to open file.");
+
+		struct stat info{};
+		if (fstat(file, &info) != 0 || info.st_size == 0)
+		{
+			close(file);
+			throw std::runtime_error("Failed to get file size.");
+		}
+
+		auto view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		close(file);
+
+		if (view == MAP_FAILED)
+			throw std::runtime_error("Failed to map file.");
+
+		this->Data = static_cast<const uint8_t*>(view);
+		this->Size = static_cast<size_t>(info.st_size);
+#endif
+	}
+
+	void MappedFile::Close()
+	{
+		if (!this->Data)
+			return;
+
+#ifdef _WIN32
+		UnmapViewOfFile(this->Data);
+		CloseHandle(this->MappingHandle);
+		CloseHandle(this->FileHandle);
+#else
+		munmap(const_cast<uint8_t*>(this->Data), this->Size);
+#endif
+
+		this->Data = nullptr;
+		this->Size = 0;
+		this->FileHandle = nullptr;
+		this->MappingHandle = nullptr;
+	}
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <cstdint>
 
 namespace Engine
 {
@@ -10,5 +11,42 @@ namespace Engine
 	{
 	public:
 		static void ReadFile(const std::string& Filename, std::vector<char>& data);
+
+		static bool FileExists(const std::string& Filename);
+	};
+
+	// Read-only mapping of a whole file. Unmapped on Close or destruction.
+	class MappedFile
+	{
+	private:
+		const uint8_t* Data = nullptr;
+		size_t Size = 0;
+
+		// Platform handles, kept opaque so the header doesn't drag in windows.h
+		void* FileHandle = nullptr;
+		void* MappingHandle = nullptr;
+
+	public:
+		void Open(const std::string& Filename);
+		void Close();
+
+		const uint8_t* GetData() const
+		{
+			return this->Data;
+		}
+
+		size_t GetSize() const
+		{
+			return this->Size;
+		}
+
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile()
+		{
+			Close();
+		}
 	};
 }
\ No newline at end of file
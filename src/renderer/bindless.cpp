@@ -0,0 +1,146 @@
+#include "renderer/bindless.h"
+
+#include <algorithm>
+
+namespace Engine
+{
+	BindlessTextureTable::BindlessTextureTable(std::shared_ptr<VulkanDeviceContext> devCtx, vk::Sampler sampler, uint32_t capacity) :
+		DeviceContext(devCtx)
+	{
+		auto properties = this->DeviceContext->PhysicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>();
+		const auto& properties12 = properties.get<vk::PhysicalDeviceVulkan12Properties>();
+
+		this->Capacity = std::min({
+			capacity,
+			properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+			properties12.maxPerStageDescriptorUpdateAfterBindSampledImages });
+
+		this->SlotViews.resize(this->Capacity);
+
+		// Popped from the back, so low slots go out first
+		this->FreeSlots.resize(this->Capacity);
+		for (uint32_t i = 0; i < this->Capacity; i++)
+			this->FreeSlots[i] = this->Capacity - 1 - i;
+
+		CreateDescriptorSetLayout(sampler);
+		CreateDescriptorPool();
+
+		vk::DescriptorSetAllocateInfo allocInfo(
+			this->DescriptorPool,
+			1, &this->DescriptorSetLayout);
+
+		this->DescriptorSet = this->DeviceContext->LogicalDevice.allocateDescriptorSets(allocInfo)[0];
+	}
+
+	void BindlessTextureTable::CreateDescriptorSetLayout(vk::Sampler sampler)
+	{
+		std::array<vk::DescriptorSetLayoutBinding, 2> bindings{};
+
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = vk::DescriptorType::eSampler;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = vk::ShaderStageFlagBits::eFragment;
+		bindings[0].pImmutableSamplers = &sampler;
+
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = vk::DescriptorType::eSampledImage;
+		bindings[1].descriptorCount = this->Capacity;
+		bindings[1].stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+		// Most slots are empty, and they get written while frames using the set are in flight
+		const std::array<vk::DescriptorBindingFlags, 2> bindingFlags = {
+			vk::DescriptorBindingFlags{},
+			vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind
+		};
+
+		vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo(
+			static_cast<uint32_t>(bindingFlags.size()),
+			bindingFlags.data());
+
+		vk::DescriptorSetLayoutCreateInfo layoutInfo(
+			vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool,
+			static_cast<uint32_t>(bindings.size()),
+			bindings.data());
+		layoutInfo.pNext = &bindingFlagsInfo;
+
+		this->DescriptorSetLayout = this->DeviceContext->LogicalDevice.createDescriptorSetLayout(layoutInfo);
+	}
+
+	void BindlessTextureTable::CreateDescriptorPool()
+	{
+		std::array<vk::DescriptorPoolSize, 2> poolSizes{};
+
+		poolSizes[0].type = vk::DescriptorType::eSampler;
+		poolSizes[0].descriptorCount = 1;
+		poolSizes[1].type = vk::DescriptorType::eSampledImage;
+		poolSizes[1].descriptorCount = this->Capacity;
+
+		vk::DescriptorPoolCreateInfo poolInfo(
+			vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+			1,
+			static_cast<uint32_t>(poolSizes.size()),
+			poolSizes.data());
+
+		this->DescriptorPool = this->DeviceContext->LogicalDevice.createDescriptorPool(poolInfo);
+	}
+
+	void BindlessTextureTable::Write(uint32_t slot, const Image& image)
+	{
+		vk::DescriptorImageInfo imageInfo(
+			VK_NULL_HANDLE,
+			image.ImageView,
+			vk::ImageLayout::eShaderReadOnlyOptimal);
+
+		vk::WriteDescriptorSet descWrite{};
+		descWrite.dstSet = this->DescriptorSet;
+		descWrite.dstBinding = 1;
+		descWrite.dstArrayElement = slot;
+		descWrite.descriptorType = vk::DescriptorType::eSampledImage;
+		descWrite.descriptorCount = 1;
+		descWrite.pImageInfo = &imageInfo;
+
+		this->DeviceContext->LogicalDevice.updateDescriptorSets(descWrite, nullptr);
+
+		this->SlotViews[slot] = image.ImageView;
+	}
+
+	uint32_t BindlessTextureTable::Add(const Image& image)
+	{
+		if (this->FreeSlots.empty())
+			throw std::runtime_error("Bindless texture table is full.");
+
+		const auto slot = this->FreeSlots.back();
+		this->FreeSlots.pop_back();
+
+		Write(slot, image);
+
+		return slot;
+	}
+
+	void BindlessTextureTable::Remove(uint32_t slot)
+	{
+		this->SlotViews[slot] = VK_NULL_HANDLE;
+
+		this->DeviceContext->Deletion->Defer([this, slot]()
+			{
+				this->FreeSlots.push_back(slot);
+			});
+	}
+
+	uint32_t BindlessTextureTable::Refresh(uint32_t slot, const Image& image)
+	{
+		if (this->SlotViews[slot] == image.ImageView)
+			return slot;
+
+		const auto newSlot = Add(image);
+		Remove(slot);
+
+		return newSlot;
+	}
+
+	void BindlessTextureTable::Destroy()
+	{
+		this->DeviceContext->LogicalDevice.destroyDescriptorPool(this->DescriptorPool);
+		this->DeviceContext->LogicalDevice.destroyDescriptorSetLayout(this->DescriptorSetLayout);
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "renderer/vulkandevicecontext.h"
+#include "renderer/image.h"
+
+namespace Engine
+{
+	constexpr uint32_t DefaultBindlessCapacity = 16384;
+	constexpr uint32_t InvalidBindlessSlot = UINT32_MAX;
+
+	// One descriptor set holding every texture, bound once per command buffer. Binding 0 is an
+	// immutable sampler, binding 1 a partially bound, update-after-bind texture2D array, and
+	// shaders pick a texture by its slot. Slots are written while the set is bound by frames
+	// in flight, so a slot is never rewritten until those frames retire. When an image gets a
+	// new view (the defragmenter moved it) Refresh gives it a new slot and retires the old one.
+	class BindlessTextureTable
+	{
+	private:
+		std::shared_ptr<VulkanDeviceContext> DeviceContext;
+
+		vk::DescriptorPool DescriptorPool;
+		uint32_t Capacity;
+
+		// View written to each slot, null when free
+		std::vector<vk::ImageView> SlotViews;
+		std::vector<uint32_t> FreeSlots;
+
+		void CreateDescriptorSetLayout(vk::Sampler sampler);
+		void CreateDescriptorPool();
+		void Write(uint32_t slot, const Image& image);
+
+	public:
+		vk::DescriptorSetLayout DescriptorSetLayout;
+		vk::DescriptorSet DescriptorSet;
+
+		// The image needs a view. Sampling it has to wait until it's resident.
+		uint32_t Add(const Image& image);
+
+		// The slot can be handed out again once the frames in flight are done with it
+		void Remove(uint32_t slot);
+
+		// Returns slot, or a new slot if the image's view has changed since it was written
+		uint32_t Refresh(uint32_t slot, const Image& image);
+
+		uint32_t GetCapacity() const
+		{
+			return this->Capacity;
+		}
+
+		void Destroy();
+
+		// sampler is baked into the layout, so it has to outlive it (i.e. come from the sampler cache).
+		// capacity is clamped to what the device allows for update-after-bind sampled images.
+		BindlessTextureTable(std::shared_ptr<VulkanDeviceContext> devCtx, vk::Sampler sampler, uint32_t capacity = DefaultBindlessCapacity);
+	};
+}
@@ -0,0 +1,204 @@
+#include "renderer/commandrecorder.h"
+
+#include <algorithm>
+
+namespace Engine
+{
+	FrameCommandPools::FrameCommandPools(std::shared_ptr<VulkanDeviceContext> devCtx, uint32_t framesInFlight, uint32_t slotCount) :
+		DeviceContext(devCtx)
+	{
+		// Reset as a whole every frame, never per buffer
+		vk::CommandPoolCreateInfo poolInfo(
+			vk::CommandPoolCreateFlagBits::eTransient,
+			this->DeviceContext->QueueFamilies.GraphicsFamily.value());
+
+		this->Frames.resize(framesInFlight);
+		for (auto& pools : this->Frames)
+		{
+			pools.resize(slotCount);
+			for (auto& pool : pools)
+				pool.Handle = this->DeviceContext->LogicalDevice.createCommandPool(poolInfo);
+		}
+	}
+
+	void FrameCommandPools::BeginFrame(uint32_t frame)
+	{
+		// Keeps the memory around, next frame records about as much again
+		for (auto& pool : this->Frames[frame])
+		{
+			this->DeviceContext->LogicalDevice.resetCommandPool(pool.Handle);
+
+			pool.Primary.Used = 0;
+			pool.Secondary.Used = 0;
+		}
+	}
+
+	vk::CommandBuffer FrameCommandPools::Allocate(uint32_t frame, uint32_t slot, vk::CommandBufferLevel level)
+	{
+		auto& pool = this->Frames[frame][slot];
+		auto& buffers = level == vk::CommandBufferLevel::ePrimary ? pool.Primary : pool.Secondary;
+
+		if (buffers.Used == buffers.Buffers.size())
+		{
+			vk::CommandBufferAllocateInfo allocInfo(pool.Handle, level, 1);
+			buffers.Buffers.push_back(this->DeviceContext->LogicalDevice.allocateCommandBuffers(allocInfo).front());
+		}
+
+		return buffers.Buffers[buffers.Used++];
+	}
+
+	void FrameCommandPools::Destroy()
+	{
+		// Destroying a pool frees its command buffers
+		for (auto& pools : this->Frames)
+		{
+			for (auto& pool : pools)
+				this->DeviceContext->LogicalDevice.destroyCommandPool(pool.Handle);
+		}
+
+		this->Frames.clear();
+	}
+
+	ParallelCommandRecorder::ParallelCommandRecorder(uint32_t threadCount, uint32_t minDrawsPerRange) :
+		MinDrawsPerRange(std::max(minDrawsPerRange, 1u)),
+		Workers(threadCount)
+	{
+		this->Ranges.resize(GetSlotCount());
+	}
+
+	void ParallelCommandRecorder::Record(
+		vk::CommandBuffer primary,
+		FrameCommandPools& pools,
+		uint32_t frame,
+		const vk::CommandBufferInheritanceInfo& inheritance,
+		uint32_t drawCount,
+		const RecordRange& record)
+	{
+		if (drawCount == 0)
+			return;
+
+		if (pools.GetSlotCount() < GetSlotCount())
+			throw std::invalid_argument("Frame command pools need a slot per recording thread.");
+
+		// Enough draws per range to pay for the hand off, no more ranges than threads
+		const auto wanted = (drawCount + this->MinDrawsPerRange - 1) / this->MinDrawsPerRange;
+		const auto slots = std::min(wanted, GetSlotCount());
+		const auto perRange = (drawCount + slots - 1) / slots;
+
+		// Rounding perRange up can leave the last slots with nothing, e.g. 5 draws over 4 slots
+		const auto rangeCount = (drawCount + perRange - 1) / perRange;
+
+		auto recordRange = [this, &pools, frame, &inheritance, &record, drawCount, perRange](uint32_t index)
+		{
+			auto& range = this->Ranges[index];
+
+			try
+			{
+				range.CommandBuffer = pools.Allocate(frame, index, vk::CommandBufferLevel::eSecondary);
+
+				vk::CommandBufferBeginInfo beginInfo(
+					vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+					&inheritance);
+				range.CommandBuffer.begin(beginInfo);
+
+				const auto first = index * perRange;
+				record(range.CommandBuffer, first, std::min(perRange, drawCount - first));
+
+				range.CommandBuffer.end();
+			}
+			catch (...)
+			{
+				range.Error = std::current_exception();
+			}
+		};
+
+		for (uint32_t i = 1; i < rangeCount; i++)
+			this->Workers.Submit([&recordRange, i]() { recordRange(i); });
+
+		// Take the first range here instead of sitting in WaitIdle
+		recordRange(0);
+
+		this->Workers.WaitIdle();
+
+		std::vector<vk::CommandBuffer> secondaries;
+		secondaries.reserve(rangeCount);
+
+		std::exception_ptr error;
+		for (uint32_t i = 0; i < rangeCount; i++)
+		{
+			if (this->Ranges[i].Error && !error)
+				error = this->Ranges[i].Error;
+			this->Ranges[i].Error = nullptr;
+
+			secondaries.push_back(this->Ranges[i].CommandBuffer);
+		}
+
+		if (error)
+			std::rethrow_exception(error);
+
+		// In range order, so draws land in the same order they would have single threaded
+		primary.executeCommands(secondaries);
+	}
+
+	CommandBufferCache::CommandBufferCache(std::shared_ptr<VulkanDeviceContext> devCtx, uint32_t framesInFlight, uint32_t imageCount) :
+		DeviceContext(devCtx),
+		FramesInFlight(framesInFlight)
+	{
+		vk::CommandPoolCreateInfo poolInfo(
+			vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+			this->DeviceContext->QueueFamilies.GraphicsFamily.value());
+
+		this->Pool = this->DeviceContext->LogicalDevice.createCommandPool(poolInfo);
+
+		Reserve(imageCount);
+	}
+
+	void CommandBufferCache::Reserve(uint32_t imageCount)
+	{
+		const auto count = imageCount * this->FramesInFlight;
+		if (count <= this->Entries.size())
+			return;
+
+		vk::CommandBufferAllocateInfo allocInfo(
+			this->Pool,
+			vk::CommandBufferLevel::ePrimary,
+			count - static_cast<uint32_t>(this->Entries.size()));
+
+		for (auto& commandBuffer : this->DeviceContext->LogicalDevice.allocateCommandBuffers(allocInfo))
+		{
+			Entry entry{};
+			entry.CommandBuffer = commandBuffer;
+			this->Entries.push_back(entry);
+		}
+	}
+
+	vk::CommandBuffer CommandBufferCache::Get(uint32_t imageIndex, uint32_t frame, uint64_t revision, const std::function<void(vk::CommandBuffer)>& record)
+	{
+		Reserve(imageIndex + 1);
+
+		auto& entry = this->Entries[imageIndex * this->FramesInFlight + frame];
+		if (entry.Recorded && entry.Revision == revision)
+			return entry.CommandBuffer;
+
+		// Stale until it's been recorded again, in case record throws
+		entry.Recorded = false;
+		entry.CommandBuffer.reset();
+
+		// No simultaneous use, the same buffer is never in flight twice
+		vk::CommandBufferBeginInfo beginInfo{};
+		entry.CommandBuffer.begin(beginInfo);
+		record(entry.CommandBuffer);
+		entry.CommandBuffer.end();
+
+		entry.Revision = revision;
+		entry.Recorded = true;
+
+		return entry.CommandBuffer;
+	}
+
+	void CommandBufferCache::Destroy()
+	{
+		this->DeviceContext->LogicalDevice.destroyCommandPool(this->Pool);
+		this->Entries.clear();
+	}
+}
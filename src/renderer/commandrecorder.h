@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+#include <memory>
+#include <exception>
+#include <functional>
+#include <cstdint>
+
+#include "threadpool.h"
+#include "renderer/vulkandevicecontext.h"
+
+namespace Engine
+{
+	// Below this many draws a range isn't worth handing to another thread
+	constexpr uint32_t DefaultMinDrawsPerRange = 256;
+
+	// A command pool per frame in flight and per recording thread. Buffers are handed out linearly
+	// and never freed or reset one by one; the whole frame's pools are reset in one go once its
+	// frame has finished on the GPU and the same buffers are handed out again.
+	class FrameCommandPools
+	{
+	private:
+		struct Level
+		{
+			std::vector<vk::CommandBuffer> Buffers;
+			size_t Used = 0;
+		};
+
+		struct Pool
+		{
+			vk::CommandPool Handle;
+			Level Primary;
+			Level Secondary;
+		};
+
+		std::shared_ptr<VulkanDeviceContext> DeviceContext;
+
+		// Frames[frame][thread slot]
+		std::vector<std::vector<Pool>> Frames;
+
+	public:
+		// Call once the GPU is done with the frame's previous submission, before anything is allocated
+		void BeginFrame(uint32_t frame);
+
+		// The frame's next unused buffer in slot's pool, not begun. Only one thread may use a slot
+		// at a time. Stays valid until the frame's next BeginFrame.
+		vk::CommandBuffer Allocate(uint32_t frame, uint32_t slot, vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
+
+		uint32_t GetSlotCount() const
+		{
+			return this->Frames.empty() ? 0 : static_cast<uint32_t>(this->Frames.front().size());
+		}
+
+		// Call once the device is idle
+		void Destroy();
+
+		FrameCommandPools(std::shared_ptr<VulkanDeviceContext> devCtx, uint32_t framesInFlight, uint32_t slotCount);
+	};
+
+	// Records the draws of a render pass as secondary command buffers spread over a worker pool.
+	// Each range records on its own thread slot of a FrameCommandPools, so nothing is shared
+	// between threads. Slot 0 is the calling thread.
+	class ParallelCommandRecorder
+	{
+	public:
+		// Records draws [first, first + count) into a secondary that's already begun inside the
+		// render pass. Secondaries inherit nothing but the pass, so bind everything the draws need.
+		using RecordRange = std::function<void(vk::CommandBuffer commandBuffer, uint32_t first, uint32_t count)>;
+
+	private:
+		struct Range
+		{
+			vk::CommandBuffer CommandBuffer;
+			std::exception_ptr Error;
+		};
+
+		std::vector<Range> Ranges;
+
+		uint32_t MinDrawsPerRange;
+
+		// Last so the workers are joined before anything they touch goes away
+		ThreadPool Workers;
+
+	public:
+		// Records drawCount draws over the workers into secondaries from the frame's pools, and
+		// executes them in primary, which must be inside a pass begun with eSecondaryCommandBuffers.
+		// pools needs GetSlotCount slots and BeginFrame already called for frame. Rethrows anything
+		// a worker threw.
+		void Record(
+			vk::CommandBuffer primary,
+			FrameCommandPools& pools,
+			uint32_t frame,
+			const vk::CommandBufferInheritanceInfo& inheritance,
+			uint32_t drawCount,
+			const RecordRange& record);
+
+		// Worker threads plus the calling thread
+		uint32_t GetSlotCount() const
+		{
+			return this->Workers.GetThreadCount() + 1;
+		}
+
+		// 0 threads means one per hardware thread
+		ParallelCommandRecorder(uint32_t threadCount = 0, uint32_t minDrawsPerRange = DefaultMinDrawsPerRange);
+	};
+
+	// Primary command buffers recorded once per (swapchain image, frame slot) and replayed until
+	// the revision they were recorded at goes stale. A buffer is only ever submitted from its own
+	// frame slot, so once that slot's last frame has finished it can be re-recorded.
+	class CommandBufferCache
+	{
+	private:
+		struct Entry
+		{
+			vk::CommandBuffer CommandBuffer;
+			uint64_t Revision = 0;
+			bool Recorded = false;
+		};
+
+		std::shared_ptr<VulkanDeviceContext> DeviceContext;
+
+		// Buffers are reset one at a time as they go stale
+		vk::CommandPool Pool;
+
+		uint32_t FramesInFlight;
+
+		// Entries[image * FramesInFlight + frame], only ever grows
+		std::vector<Entry> Entries;
+
+	public:
+		// The buffer for imageIndex in this frame slot, recorded from scratch by record first if it
+		// was recorded at a different revision. The frame slot must not be in use by the GPU.
+		vk::CommandBuffer Get(uint32_t imageIndex, uint32_t frame, uint64_t revision, const std::function<void(vk::CommandBuffer)>& record);
+
+		// Makes room for a swap chain with more images, nothing is freed here since older frame
+		// slots might still be executing
+		void Reserve(uint32_t imageCount);
+
+		// Call once the device is idle
+		void Destroy();
+
+		CommandBufferCache(std::shared_ptr<VulkanDeviceContext> devCtx, uint32_t framesInFlight, uint32_t imageCount);
+	};
+}
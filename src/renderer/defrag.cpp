@@ -0,0 +1,230 @@
+#include "renderer/defrag.h"
+
+#include <algorithm>
+
+namespace Engine
+{
+	void Defragmenter::Register(std::shared_ptr<Image> image, std::function<void(uint32_t)> patchFrame)
+	{
+		Movable movable{};
+		movable.Allocation = &image->ImageAllocation;
+		movable.Ticket = &image->Ticket;
+		movable.Texture = std::move(image);
+		movable.PatchFrame = std::move(patchFrame);
+
+		this->Movables.push_back(std::move(movable));
+	}
+
+	void Defragmenter::Unregister(const MemAllocation* allocation)
+	{
+		// Descriptor sets still waiting on a patch are about to lose the resource anyway
+		auto it = std::remove_if(this->Movables.begin(), this->Movables.end(),
+			[&](const Movable& movable)
+			{
+				return movable.Allocation == allocation;
+			});
+		this->Movables.erase(it, this->Movables.end());
+	}
+
+	bool Defragmenter::MoveBuffer(Movable& movable, UploadBarrierBatch& postCopy, std::vector<PlannedCopy>& copies)
+	{
+		vk::Buffer newBuffer;
+		MemAllocation newAllocation;
+
+		if (!this->DeviceContext->MemManager->RelocateBuffer(newBuffer, newAllocation, movable.BufferSize, movable.BufferUsage, *movable.Allocation))
+			return false;
+
+		PlannedCopy copy{};
+		copy.SrcBuffer = *movable.Buffer;
+		copy.DstBuffer = newBuffer;
+		copy.Size = movable.BufferSize;
+		copies.push_back(copy);
+
+		vk::BufferMemoryBarrier barrier(
+			vk::AccessFlagBits::eTransferWrite,
+			movable.DstAccess,
+			VK_QUEUE_FAMILY_IGNORED,
+			VK_QUEUE_FAMILY_IGNORED,
+			newBuffer,
+			0,
+			VK_WHOLE_SIZE);
+
+		postCopy.SrcStages |= vk::PipelineStageFlagBits::eTransfer;
+		postCopy.DstStages |= movable.DstStage;
+		postCopy.BufferBarriers.push_back(barrier);
+
+		this->DeviceContext->Deletion->DeferBuffer(*movable.Buffer, *movable.Allocation);
+
+		*movable.Buffer = newBuffer;
+		*movable.Allocation = newAllocation;
+
+		return true;
+	}
+
+	bool Defragmenter::MoveImage(Movable& movable, UploadBarrierBatch& preCopy, UploadBarrierBatch& postCopy, std::vector<PlannedCopy>& copies)
+	{
+		auto& image = *movable.Texture;
+
+		vk::Image newImage;
+		MemAllocation newAllocation;
+
+		if (!this->DeviceContext->MemManager->RelocateImage(newImage, newAllocation, image.Width, image.Height, image.MipLevels, image.Format, Image::TextureUsage, *movable.Allocation))
+			return false;
+
+		PlannedCopy copy{};
+		copy.SrcImage = image.VulkanImage;
+		copy.DstImage = newImage;
+		copy.Extent = vk::Extent3D{ image.Width, image.Height, 1 };
+		copy.MipLevels = image.MipLevels;
+		copies.push_back(copy);
+
+		vk::ImageMemoryBarrier barrier{};
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = image.MipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		// The old image is never sampled again, so it stays in eTransferSrcOptimal until it's freed
+		auto src = barrier;
+		src.image = image.VulkanImage;
+		src.oldLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		src.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+		src.srcAccessMask = vk::AccessFlagBits::eShaderRead;
+		src.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+
+		auto dst = barrier;
+		dst.image = newImage;
+		dst.oldLayout = vk::ImageLayout::eUndefined;
+		dst.newLayout = vk::ImageLayout::eTransferDstOptimal;
+		dst.srcAccessMask = vk::AccessFlagBits::eNone;
+		dst.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+
+		preCopy.SrcStages |= vk::PipelineStageFlagBits::eFragmentShader;
+		preCopy.DstStages |= vk::PipelineStageFlagBits::eTransfer;
+		preCopy.ImageBarriers.push_back(src);
+		preCopy.ImageBarriers.push_back(dst);
+
+		auto ready = barrier;
+		ready.image = newImage;
+		ready.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+		ready.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		ready.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		ready.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+		postCopy.SrcStages |= vk::PipelineStageFlagBits::eTransfer;
+		postCopy.DstStages |= vk::PipelineStageFlagBits::eFragmentShader;
+		postCopy.ImageBarriers.push_back(ready);
+
+		this->DeviceContext->Deletion->DeferImageView(image.ImageView);
+		this->DeviceContext->Deletion->DeferImage(image.VulkanImage, *movable.Allocation);
+
+		image.VulkanImage = newImage;
+		image.ImageAllocation = newAllocation;
+		image.CreateImageView(image.Format);
+
+		return true;
+	}
+
+	void Defragmenter::RecordMoves(vk::CommandBuffer& commandBuffer, uint32_t frameIndex)
+	{
+		const uint32_t slotBit = 1u << frameIndex;
+		const uint32_t allSlots = (1u << this->FramesInFlight) - 1;
+
+		// This slot's last frame has finished, so its descriptor sets are free to update
+		for (auto& movable : this->Movables)
+		{
+			if (movable.UnpatchedSlots & slotBit)
+			{
+				movable.PatchFrame(frameIndex);
+				movable.UnpatchedSlots &= ~slotBit;
+			}
+		}
+
+		auto& memManager = this->DeviceContext->MemManager;
+		auto& uploader = this->DeviceContext->Uploader;
+		const auto& memProperties = memManager->GetMemoryProperties();
+
+		UploadBarrierBatch preCopy;
+		UploadBarrierBatch postCopy;
+		std::vector<PlannedCopy> copies;
+		vk::DeviceSize bytesMoved = 0;
+
+		for (uint32_t type = 0; type < memProperties.memoryTypeCount && bytesMoved < this->BytesPerFrame; type++)
+		{
+			if (!(memProperties.memoryTypes[type].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal))
+				continue;
+
+			auto source = memManager->PickCompactionSource(type);
+			if (!source)
+				continue;
+
+			for (auto& movable : this->Movables)
+			{
+				if (movable.Allocation->Block != source || !uploader->IsResident(*movable.Ticket))
+					continue;
+
+				// Always let one move through, or anything bigger than the budget would never move
+				if (bytesMoved > 0 && bytesMoved + movable.Allocation->Size > this->BytesPerFrame)
+					break;
+
+				const auto size = movable.Allocation->Size;
+				const auto moved = movable.Texture
+					? MoveImage(movable, preCopy, postCopy, copies)
+					: MoveBuffer(movable, postCopy, copies);
+
+				if (!moved)
+					continue;
+
+				bytesMoved += size;
+
+				if (movable.PatchFrame)
+				{
+					movable.PatchFrame(frameIndex);
+					movable.UnpatchedSlots = allSlots & ~slotBit;
+				}
+			}
+		}
+
+		if (copies.empty())
+			return;
+
+		preCopy.Record(commandBuffer);
+
+		for (const auto& copy : copies)
+		{
+			if (copy.SrcBuffer)
+			{
+				vk::BufferCopy region(0, 0, copy.Size);
+				commandBuffer.copyBuffer(copy.SrcBuffer, copy.DstBuffer, 1, &region);
+			}
+			else
+			{
+				std::vector<vk::ImageCopy> regions(copy.MipLevels);
+				for (uint32_t level = 0; level < copy.MipLevels; level++)
+				{
+					regions[level].srcSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1);
+					regions[level].dstSubresource = regions[level].srcSubresource;
+					regions[level].extent = vk::Extent3D{
+						std::max(1u, copy.Extent.width >> level),
+						std::max(1u, copy.Extent.height >> level),
+						1 };
+				}
+
+				commandBuffer.copyImage(
+					copy.SrcImage, vk::ImageLayout::eTransferSrcOptimal,
+					copy.DstImage, vk::ImageLayout::eTransferDstOptimal,
+					static_cast<uint32_t>(regions.size()), regions.data());
+			}
+		}
+
+		postCopy.Record(commandBuffer);
+	}
+
+	void Defragmenter::Destroy()
+	{
+		this->Movables.clear();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include "renderer/vulkandevicecontext.h"
+#include "renderer/vulkanmem.h"
+#include "renderer/upload.h"
+#include "renderer/vertex.h"
+#include "renderer/image.h"
+
+namespace Engine
+{
+	constexpr vk::DeviceSize DefaultDefragBytesPerFrame = 8ull * 1024 * 1024;
+
+	// Incrementally packs device local resources into fewer memory blocks. Each frame it takes
+	// the least used block of a memory type, re-creates some of the resources living there in
+	// fuller blocks and copies them over on the graphics queue, up to a byte budget.
+	// Handles are swapped as soon as the copy is recorded. Descriptor sets are patched one frame
+	// slot at a time as each slot comes around, and the old resources go to the deletion queue.
+	class Defragmenter
+	{
+	private:
+		struct Movable
+		{
+			MemAllocation* Allocation;
+			const UploadTicket* Ticket;
+
+			// Buffers
+			vk::Buffer* Buffer = nullptr;
+			vk::DeviceSize BufferSize = 0;
+			vk::BufferUsageFlags BufferUsage;
+			vk::PipelineStageFlags DstStage;
+			vk::AccessFlags DstAccess;
+
+			// Images, held so the image can't go away while it's registered
+			std::shared_ptr<Image> Texture;
+
+			// Points a frame slot's descriptor sets at the new location
+			std::function<void(uint32_t)> PatchFrame;
+
+			// Frame slots still pointing at the old location
+			uint32_t UnpatchedSlots = 0;
+		};
+
+		struct PlannedCopy
+		{
+			vk::Buffer SrcBuffer;
+			vk::Buffer DstBuffer;
+			vk::DeviceSize Size = 0;
+
+			vk::Image SrcImage;
+			vk::Image DstImage;
+			vk::Extent3D Extent;
+			uint32_t MipLevels = 1;
+		};
+
+		std::shared_ptr<VulkanDeviceContext> DeviceContext;
+
+		uint32_t FramesInFlight;
+		vk::DeviceSize BytesPerFrame;
+
+		std::vector<Movable> Movables;
+
+		bool MoveBuffer(Movable& movable, UploadBarrierBatch& postCopy, std::vector<PlannedCopy>& copies);
+		bool MoveImage(Movable& movable, UploadBarrierBatch& preCopy, UploadBarrierBatch& postCopy, std::vector<PlannedCopy>& copies);
+
+		void Unregister(const MemAllocation* allocation);
+
+	public:
+		template<typename T>
+		void Register(VertexInputBuffer<T>& buffer)
+		{
+			Movable movable{};
+			movable.Allocation = &buffer.BufferAllocation;
+			movable.Ticket = &buffer.Ticket;
+			movable.Buffer = &buffer.Buffer;
+			movable.BufferSize = buffer.BufferSize;
+			movable.BufferUsage = VertexInputBuffer<T>::Usage;
+			movable.DstStage = vk::PipelineStageFlagBits::eVertexInput;
+			movable.DstAccess = T::AccessType;
+
+			this->Movables.push_back(movable);
+		}
+
+		// patchFrame rewrites whatever descriptor sets of that frame slot reference the image.
+		// Can be empty when nothing needs patching, e.g. the bindless table notices on its own.
+		void Register(std::shared_ptr<Image> image, std::function<void(uint32_t)> patchFrame);
+
+		// Call before destroying anything that was registered, it's never touched again
+		template<typename T>
+		void Unregister(VertexInputBuffer<T>& buffer)
+		{
+			Unregister(&buffer.BufferAllocation);
+		}
+
+		void Unregister(Image& image)
+		{
+			Unregister(&image.ImageAllocation);
+		}
+
+		// Call after frameIndex's last frame has finished on the GPU, before anything that uses the
+		// registered resources is recorded into commandBuffer
+		void RecordMoves(vk::CommandBuffer& commandBuffer, uint32_t frameIndex);
+
+		void Destroy();
+
+		Defragmenter(std::shared_ptr<VulkanDeviceContext> devCtx, uint32_t framesInFlight, vk::DeviceSize bytesPerFrame = DefaultDefragBytesPerFrame) :
+			DeviceContext(devCtx),
+			FramesInFlight(framesInFlight),
+			BytesPerFrame(bytesPerFrame)
+		{}
+	};
+}
\ No newline at end of file
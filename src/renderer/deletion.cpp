@@ -0,0 +1,59 @@
+#include "renderer/deletion.h"
+
+namespace Engine
+{
+	void DeletionQueue::DeferBuffer(vk::Buffer buffer, MemAllocation allocation)
+	{
+		Defer([this, buffer, allocation]() mutable
+			{
+				this->MemManager.DestroyBuffer(buffer, allocation);
+			});
+	}
+
+	void DeletionQueue::DeferImage(vk::Image image, MemAllocation allocation)
+	{
+		Defer([this, image, allocation]() mutable
+			{
+				this->MemManager.DestroyImage(image, allocation);
+			});
+	}
+
+	void DeletionQueue::DeferImageView(vk::ImageView view)
+	{
+		Defer([this, view]()
+			{
+				this->LogicalDevice.destroyImageView(view);
+			});
+	}
+
+	void DeletionQueue::DeferSampler(vk::Sampler sampler)
+	{
+		Defer([this, sampler]()
+			{
+				this->LogicalDevice.destroySampler(sampler);
+			});
+	}
+
+	void DeletionQueue::Collect()
+	{
+		if (this->Entries.empty())
+			return;
+
+		const auto completed = this->Frames.GetCompletedValue();
+
+		while (!this->Entries.empty() && this->Entries.front().Frame <= completed)
+		{
+			this->Entries.front().Deleter();
+			this->Entries.pop_front();
+		}
+	}
+
+	void DeletionQueue::Flush()
+	{
+		while (!this->Entries.empty())
+		{
+			this->Entries.front().Deleter();
+			this->Entries.pop_front();
+		}
+	}
+}
\ No newline at end of file
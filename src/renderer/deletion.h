@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <deque>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+#include "renderer/vulkanmem.h"
+#include "renderer/frametimeline.h"
+
+namespace Engine
+{
+	// Holds on to GPU resources until no frame in flight can still reference them.
+	// Everything deferred is tagged with the frame timeline value of the next frame to be
+	// submitted, and freed once the timeline has reached it.
+	class DeletionQueue
+	{
+	private:
+		struct Entry
+		{
+			uint64_t Frame;
+			std::function<void()> Deleter;
+		};
+
+		vk::Device& LogicalDevice;
+		VulkanMemManager& MemManager;
+		const FrameTimeline& Frames;
+
+		// Sorted by Frame, since timeline values only go up
+		std::deque<Entry> Entries;
+
+	public:
+		void Defer(std::function<void()> deleter)
+		{
+			this->Entries.push_back({ this->Frames.GetNextValue(), std::move(deleter) });
+		}
+
+		void DeferBuffer(vk::Buffer buffer, MemAllocation allocation);
+		void DeferImage(vk::Image image, MemAllocation allocation);
+		void DeferImageView(vk::ImageView view);
+		void DeferSampler(vk::Sampler sampler);
+
+		// Frees everything the frames finished on the GPU so far cover, never blocks
+		void Collect();
+
+		// Frees everything, the device must be idle
+		void Flush();
+
+		DeletionQueue(vk::Device& device, VulkanMemManager& memManager, const FrameTimeline& frames) :
+			LogicalDevice(device),
+			MemManager(memManager),
+			Frames(frames)
+		{}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include "renderer/framepacing.h"
+
+namespace Engine
+{
+	LatencyTracker::LatencyTracker(const char* reportPath)
+	{
+		if (reportPath == nullptr)
+			return;
+
+		this->Report.open(reportPath, std::ios::trunc);
+		if (this->Report.is_open())
+			this->Report << "present_id,input_to_present_ms,source\n";
+	}
+
+	void LatencyTracker::Queued(uint64_t presentId, bool waitable)
+	{
+		if (!waitable)
+		{
+			Write(presentId, this->InputTime, false);
+			return;
+		}
+
+		this->Pending.push_back({ presentId, this->InputTime });
+	}
+
+	void LatencyTracker::Presented(uint64_t presentId)
+	{
+		while (!this->Pending.empty() && this->Pending.front().PresentId <= presentId)
+		{
+			Write(this->Pending.front().PresentId, this->Pending.front().InputTime, true);
+			this->Pending.pop_front();
+		}
+	}
+
+	void LatencyTracker::Write(uint64_t presentId, Clock::time_point inputTime, bool measured)
+	{
+		if (!this->Report.is_open())
+			return;
+
+		const auto latency = std::chrono::duration<double, std::milli>(Clock::now() - inputTime).count();
+
+		this->Report << presentId << ',' << latency << ',' << (measured ? "present_wait" : "queue_present") << '\n';
+	}
+}
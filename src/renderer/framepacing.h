@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <cstdint>
+
+namespace Engine
+{
+	constexpr uint32_t MaxFramesInFlight = 4;
+
+	// How the swap chain picks its present mode, falls back to FIFO when the preferred ones are missing
+	enum class PresentModePreference
+	{
+		// Mailbox. Never tears and never waits on vblank, the newest finished frame is shown
+		Throughput,
+
+		// Immediate, then mailbox. Frames go out as soon as they're done and may tear
+		Latency,
+
+		// FIFO. Every frame is shown and the CPU is throttled to the refresh rate
+		VSync
+	};
+
+	struct FramePacing
+	{
+		// 1 to MaxFramesInFlight. More hides CPU/GPU hitches, fewer cuts latency
+		uint32_t FramesInFlight = 2;
+
+		PresentModePreference PresentMode = PresentModePreference::Throughput;
+
+		// Waits for the previous frame to be presented before sampling input, so input is as fresh
+		// as it can be. Without VK_KHR_present_wait it waits for the GPU to finish it instead.
+		bool LowLatency = false;
+
+		// Per frame input to present latency is written here as CSV, null to skip it
+		const char* LatencyReportPath = "latency_report.csv";
+	};
+
+	// Matches up when each frame sampled its input with when it reached the screen.
+	// With present wait that's when the driver says it was presented, without it the best we
+	// have is when vkQueuePresentKHR returned, which is marked as such in the report.
+	class LatencyTracker
+	{
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct PendingFrame
+		{
+			uint64_t PresentId;
+			Clock::time_point InputTime;
+		};
+
+		// Presented but not seen on screen yet, in present order
+		std::deque<PendingFrame> Pending;
+
+		Clock::time_point InputTime;
+		std::ofstream Report;
+
+		void Write(uint64_t presentId, Clock::time_point inputTime, bool measured);
+
+	public:
+		// Call right after input has been polled
+		void InputSampled()
+		{
+			this->InputTime = Clock::now();
+		}
+
+		// Call once the frame has been handed to vkQueuePresentKHR. If waitable, Presented is
+		// called for it later, otherwise it's reported right away.
+		void Queued(uint64_t presentId, bool waitable);
+
+		// Everything up to and including presentId is on screen as of now
+		void Presented(uint64_t presentId);
+
+		// Oldest frame not known to be on screen, 0 if there's none
+		uint64_t GetOldestPending() const
+		{
+			return this->Pending.empty() ? 0 : this->Pending.front().PresentId;
+		}
+
+		// Present ids start over with a new swap chain, nothing pending will be waited on anymore
+		void Drop()
+		{
+			this->Pending.clear();
+		}
+
+		explicit LatencyTracker(const char* reportPath);
+	};
+}
@@ -0,0 +1,36 @@
+#include "renderer/frametimeline.h"
+
+namespace Engine
+{
+	FrameTimeline::FrameTimeline(vk::Device& device) :
+		LogicalDevice(device)
+	{
+		vk::SemaphoreTypeCreateInfo timelineInfo(vk::SemaphoreType::eTimeline, 0);
+
+		vk::SemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.pNext = &timelineInfo;
+
+		this->Semaphore = this->LogicalDevice.createSemaphore(semaphoreInfo);
+	}
+
+	bool FrameTimeline::Wait(uint64_t value, uint64_t timeout) const
+	{
+		// Nothing was ever submitted for it, or it's already done
+		if (value == 0)
+			return true;
+
+		vk::SemaphoreWaitInfo waitInfo({}, 1, &this->Semaphore, &value);
+
+		const auto result = this->LogicalDevice.waitSemaphores(waitInfo, timeout);
+		if (result == vk::Result::eTimeout)
+			return false;
+
+		vk::resultCheck(result, "Failed to wait for the frame timeline.");
+		return true;
+	}
+
+	void FrameTimeline::Destroy()
+	{
+		this->LogicalDevice.destroySemaphore(this->Semaphore);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+
+namespace Engine
+{
+	// One timeline semaphore for the graphics queue. Every frame signals the next value once its
+	// work is done, so frame N having finished is just the counter reaching N. Anything that has
+	// to know when the GPU is done with something keys off these values instead of frame slots.
+	class FrameTimeline
+	{
+	private:
+		vk::Device& LogicalDevice;
+
+		// Value of the last frame submitted
+		uint64_t Submitted = 0;
+
+	public:
+		vk::Semaphore Semaphore;
+
+		// What the next frame submitted signals, work done on the CPU now is done before it
+		uint64_t GetNextValue() const
+		{
+			return this->Submitted + 1;
+		}
+
+		uint64_t GetSubmittedValue() const
+		{
+			return this->Submitted;
+		}
+
+		uint64_t GetCompletedValue() const
+		{
+			return this->LogicalDevice.getSemaphoreCounterValue(this->Semaphore);
+		}
+
+		// Blocks until the GPU gets to value, false if it timed out
+		bool Wait(uint64_t value, uint64_t timeout = UINT64_MAX) const;
+
+		// Call once the submit signalling GetNextValue is in, returns its value
+		uint64_t FrameSubmitted()
+		{
+			return ++this->Submitted;
+		}
+
+		// Call once the device is idle
+		void Destroy();
+
+		explicit FrameTimeline(vk::Device& device);
+	};
+}
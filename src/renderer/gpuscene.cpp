@@ -0,0 +1,470 @@
+#include "renderer/gpuscene.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "files.h"
+
+namespace Engine
+{
+	// Matches local_size_x in cull.comp and compact.comp
+	constexpr uint32_t CullGroupSize = 64;
+
+	static vk::ShaderModule LoadShaderModule(vk::Device& device, const std::string& path)
+	{
+		std::vector<char> code;
+		Filesystem::ReadFile(path, code);
+
+		vk::ShaderModuleCreateInfo createInfo{};
+		createInfo.codeSize = code.size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+		return device.createShaderModule(createInfo);
+	}
+
+	GpuScene::GpuScene(std::shared_ptr<VulkanDeviceContext> devCtx, uint32_t framesInFlight, uint32_t maxObjects, uint32_t maxMeshes, uint32_t maxUpdatesPerFrame) :
+		DeviceContext(devCtx),
+		MaxObjects(maxObjects),
+		MaxMeshes(maxMeshes),
+		MaxUpdatesPerFrame(maxUpdatesPerFrame)
+	{
+		CreateBuffers(framesInFlight);
+		CreateDescriptorSets(framesInFlight);
+		CreatePipelines();
+	}
+
+	void GpuScene::CreateBuffers(uint32_t framesInFlight)
+	{
+		auto& memManager = *this->DeviceContext->MemManager;
+
+		this->TemplatesSize = (this->MaxMeshes * sizeof(vk::DrawIndexedIndirectCommand) + 15) & ~vk::DeviceSize(15);
+		this->UploadSegmentSize = this->TemplatesSize + this->MaxUpdatesPerFrame * sizeof(GpuObject);
+
+		memManager.CreateBuffer(
+			this->ObjectBuffer,
+			this->ObjectBufferAllocation,
+			this->MaxObjects * sizeof(GpuObject),
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			MemoryCategory::Storage);
+
+		// Copied out of on the graphics queue in the frame's own command buffer
+		memManager.CreateBuffer(
+			this->UploadBuffer,
+			this->UploadBufferAllocation,
+			this->UploadSegmentSize * framesInFlight,
+			vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			MemoryCategory::Staging);
+
+		this->UploadData = static_cast<uint8_t*>(memManager.MapMemory(this->UploadBufferAllocation));
+
+		const auto commandsSize = this->MaxMeshes * sizeof(vk::DrawIndexedIndirectCommand);
+		const auto drawUsage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst;
+
+		this->Frames.resize(framesInFlight);
+		for (auto& frame : this->Frames)
+		{
+			memManager.CreateBuffer(
+				frame.Commands,
+				frame.CommandsAllocation,
+				commandsSize,
+				drawUsage,
+				vk::MemoryPropertyFlagBits::eDeviceLocal,
+				MemoryCategory::Storage);
+
+			memManager.CreateBuffer(
+				frame.Draws,
+				frame.DrawsAllocation,
+				this->DrawsOffset + commandsSize,
+				drawUsage,
+				vk::MemoryPropertyFlagBits::eDeviceLocal,
+				MemoryCategory::Storage);
+
+			memManager.CreateBuffer(
+				frame.Instances,
+				frame.InstancesAllocation,
+				this->MaxObjects * sizeof(InstanceData),
+				vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer,
+				vk::MemoryPropertyFlagBits::eDeviceLocal,
+				MemoryCategory::Vertex);
+		}
+	}
+
+	void GpuScene::CreateDescriptorSets(uint32_t framesInFlight)
+	{
+		auto& device = this->DeviceContext->LogicalDevice;
+
+		// Objects, per mesh draws, instances, compacted draws
+		std::array<vk::DescriptorSetLayoutBinding, 4> bindings{};
+		for (uint32_t i = 0; i < bindings.size(); i++)
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = vk::ShaderStageFlagBits::eCompute;
+		}
+
+		vk::DescriptorSetLayoutCreateInfo layoutInfo(
+			{},
+			static_cast<uint32_t>(bindings.size()),
+			bindings.data());
+
+		this->DescriptorSetLayout = device.createDescriptorSetLayout(layoutInfo);
+
+		const vk::DescriptorPoolSize poolSize(vk::DescriptorType::eStorageBuffer, framesInFlight * static_cast<uint32_t>(bindings.size()));
+
+		vk::DescriptorPoolCreateInfo poolInfo(
+			{},
+			framesInFlight,
+			1, &poolSize);
+
+		this->DescriptorPool = device.createDescriptorPool(poolInfo);
+
+		std::vector<vk::DescriptorSetLayout> layouts(framesInFlight, this->DescriptorSetLayout);
+		vk::DescriptorSetAllocateInfo allocInfo(this->DescriptorPool, layouts);
+
+		const auto sets = device.allocateDescriptorSets(allocInfo);
+
+		// Nothing here is ever re-created, so the sets are written once
+		for (uint32_t i = 0; i < framesInFlight; i++)
+		{
+			auto& frame = this->Frames[i];
+			frame.DescriptorSet = sets[i];
+
+			const std::array<vk::DescriptorBufferInfo, 4> bufferInfos = {
+				vk::DescriptorBufferInfo(this->ObjectBuffer, 0, VK_WHOLE_SIZE),
+				vk::DescriptorBufferInfo(frame.Commands, 0, VK_WHOLE_SIZE),
+				vk::DescriptorBufferInfo(frame.Instances, 0, VK_WHOLE_SIZE),
+				vk::DescriptorBufferInfo(frame.Draws, 0, VK_WHOLE_SIZE)
+			};
+
+			std::array<vk::WriteDescriptorSet, 4> writes{};
+			for (uint32_t binding = 0; binding < writes.size(); binding++)
+			{
+				writes[binding].dstSet = frame.DescriptorSet;
+				writes[binding].dstBinding = binding;
+				writes[binding].descriptorCount = 1;
+				writes[binding].descriptorType = vk::DescriptorType::eStorageBuffer;
+				writes[binding].pBufferInfo = &bufferInfos[binding];
+			}
+
+			device.updateDescriptorSets(writes, nullptr);
+		}
+	}
+
+	void GpuScene::CreatePipelines()
+	{
+		auto& device = this->DeviceContext->LogicalDevice;
+
+		const vk::PushConstantRange pushConstantRange(
+			vk::ShaderStageFlagBits::eCompute,
+			0,
+			sizeof(CullPushConstants));
+
+		vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &this->DescriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		this->PipelineLayout = device.createPipelineLayout(pipelineLayoutInfo);
+
+		auto createPipeline = [this, &device](const std::string& path)
+		{
+			const auto module = LoadShaderModule(device, path);
+
+			vk::ComputePipelineCreateInfo pipelineInfo(
+				{},
+				vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eCompute, module, "main"),
+				this->PipelineLayout);
+
+			const auto pipeline = device.createComputePipeline(VK_NULL_HANDLE, pipelineInfo).value;
+
+			device.destroyShaderModule(module);
+
+			return pipeline;
+		};
+
+		this->CullPipeline = createPipeline("shaders/cull.spv");
+		this->CompactPipeline = createPipeline("shaders/compact.spv");
+	}
+
+	uint32_t GpuScene::AddMesh(const std::vector<Vertex>& vertices, const std::vector<Index>& indices)
+	{
+		if (this->Vertices)
+			throw std::runtime_error("Meshes have to be added before the scene is committed.");
+
+		if (this->Meshes.size() >= this->MaxMeshes)
+			throw std::runtime_error("GPU scene is out of meshes, raise the mesh budget.");
+
+		if (vertices.empty() || indices.empty())
+			throw std::invalid_argument("Mesh has no geometry.");
+
+		// Sphere around the bounding box, loose but cheap to test
+		glm::vec3 min = vertices.front().pos;
+		glm::vec3 max = vertices.front().pos;
+		for (const auto& vertex : vertices)
+		{
+			min = glm::min(min, vertex.pos);
+			max = glm::max(max, vertex.pos);
+		}
+
+		const auto center = (min + max) * 0.5f;
+
+		float radius = 0.0f;
+		for (const auto& vertex : vertices)
+			radius = std::max(radius, glm::length(vertex.pos - center));
+
+		MeshRange mesh{};
+		mesh.IndexCount = static_cast<uint32_t>(indices.size());
+		mesh.FirstIndex = static_cast<uint32_t>(this->PendingIndices.size());
+		mesh.VertexOffset = static_cast<int32_t>(this->PendingVertices.size());
+		mesh.Bounds = glm::vec4(center, radius);
+
+		this->PendingVertices.insert(this->PendingVertices.end(), vertices.begin(), vertices.end());
+		this->PendingIndices.insert(this->PendingIndices.end(), indices.begin(), indices.end());
+
+		this->Meshes.push_back(mesh);
+		this->ObjectsPerMesh.push_back(0);
+
+		return static_cast<uint32_t>(this->Meshes.size() - 1);
+	}
+
+	void GpuScene::Commit()
+	{
+		if (this->Vertices)
+			throw std::runtime_error("GPU scene was already committed.");
+
+		if (this->Meshes.empty())
+			throw std::runtime_error("GPU scene has no meshes to commit.");
+
+		this->Vertices = std::make_unique<VertexInputBuffer<Vertex>>(this->DeviceContext, this->PendingVertices);
+		this->Indices = std::make_unique<VertexInputBuffer<Index>>(this->DeviceContext, this->PendingIndices);
+
+		// The buffers keep their own copy
+		this->PendingVertices = {};
+		this->PendingIndices = {};
+	}
+
+	uint32_t GpuScene::AddObject(uint32_t mesh, uint32_t material, const glm::mat4& transform)
+	{
+		if (mesh >= this->Meshes.size())
+			throw std::invalid_argument("Mesh doesn't exist.");
+
+		if (this->Objects.size() >= this->MaxObjects)
+			throw std::runtime_error("GPU scene is out of objects, raise the object budget.");
+
+		GpuObject object{};
+		object.Model = transform;
+		object.Bounds = this->Meshes[mesh].Bounds;
+		object.Mesh = mesh;
+		object.Material = material;
+
+		const auto id = static_cast<uint32_t>(this->Objects.size());
+
+		this->Objects.push_back(object);
+		this->ObjectsPerMesh[mesh]++;
+
+		this->Dirty.push_back(true);
+		this->DirtyQueue.push_back(id);
+
+		return id;
+	}
+
+	void GpuScene::UpdateObject(uint32_t object, uint32_t material, const glm::mat4& transform)
+	{
+		if (object >= this->Objects.size())
+			throw std::invalid_argument("Object doesn't exist.");
+
+		this->Objects[object].Model = transform;
+		this->Objects[object].Material = material;
+
+		// Already queued objects go out with whatever they hold by then
+		if (this->Dirty[object])
+			return;
+
+		this->Dirty[object] = true;
+		this->DirtyQueue.push_back(object);
+	}
+
+	std::array<glm::vec4, 6> GpuScene::GetFrustumPlanes(const glm::mat4& viewProj)
+	{
+		auto row = [&viewProj](int i)
+		{
+			return glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+		};
+
+		// Vulkan clip space, depth goes from 0 to w
+		std::array<glm::vec4, 6> planes = {
+			row(3) + row(0),
+			row(3) - row(0),
+			row(3) + row(1),
+			row(3) - row(1),
+			row(2),
+			row(3) - row(2)
+		};
+
+		for (auto& plane : planes)
+			plane /= glm::length(glm::vec3(plane));
+
+		return planes;
+	}
+
+	void GpuScene::RecordCulling(vk::CommandBuffer commandBuffer, uint32_t frame, const glm::mat4& viewProj)
+	{
+		if (!this->Vertices)
+			return;
+
+		auto& frameBuffers = this->Frames[frame];
+
+		const auto meshCount = GetMeshCount();
+		const auto segmentOffset = this->UploadSegmentSize * frame;
+
+		auto* segment = this->UploadData + segmentOffset;
+
+		// Every mesh gets room for all of its objects, the culling pass counts up instanceCount
+		uint32_t firstInstance = 0;
+		for (uint32_t mesh = 0; mesh < meshCount; mesh++)
+		{
+			const auto& range = this->Meshes[mesh];
+
+			const vk::DrawIndexedIndirectCommand command(range.IndexCount, 0, range.FirstIndex, range.VertexOffset, firstInstance);
+			std::memcpy(segment + mesh * sizeof(command), &command, sizeof(command));
+
+			firstInstance += this->ObjectsPerMesh[mesh];
+		}
+
+		// Changed objects, neighbours in both the segment and the object buffer go out as one copy
+		std::vector<vk::BufferCopy> objectCopies;
+		for (uint32_t i = 0; i < this->MaxUpdatesPerFrame && !this->DirtyQueue.empty(); i++)
+		{
+			const auto object = this->DirtyQueue.front();
+			this->DirtyQueue.pop_front();
+			this->Dirty[object] = false;
+
+			const auto srcOffset = this->TemplatesSize + i * sizeof(GpuObject);
+			std::memcpy(segment + srcOffset, &this->Objects[object], sizeof(GpuObject));
+
+			const vk::BufferCopy copy(segmentOffset + srcOffset, object * sizeof(GpuObject), sizeof(GpuObject));
+
+			auto* last = objectCopies.empty() ? nullptr : &objectCopies.back();
+			if (last && last->srcOffset + last->size == copy.srcOffset && last->dstOffset + last->size == copy.dstOffset)
+				last->size += copy.size;
+			else
+				objectCopies.push_back(copy);
+
+			// New objects are queued in order, so everything below has been copied by now
+			this->UploadedCount = std::max(this->UploadedCount, object + 1);
+		}
+
+		// Earlier frames' culling can still be reading the objects about to be overwritten
+		if (!objectCopies.empty())
+		{
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, nullptr);
+			commandBuffer.copyBuffer(this->UploadBuffer, this->ObjectBuffer, objectCopies);
+		}
+
+		const vk::BufferCopy templateCopy(segmentOffset, 0, meshCount * sizeof(vk::DrawIndexedIndirectCommand));
+		commandBuffer.copyBuffer(this->UploadBuffer, frameBuffers.Commands, templateCopy);
+		commandBuffer.fillBuffer(frameBuffers.Draws, 0, sizeof(uint32_t), 0);
+
+		const vk::MemoryBarrier uploadBarrier(
+			vk::AccessFlagBits::eTransferWrite,
+			vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, uploadBarrier, nullptr, nullptr);
+
+		CullPushConstants pushConstants{};
+		pushConstants.FrustumPlanes = GetFrustumPlanes(viewProj);
+		pushConstants.ObjectCount = this->UploadedCount;
+		pushConstants.MeshCount = meshCount;
+
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->PipelineLayout, 0, 1, &frameBuffers.DescriptorSet, 0, nullptr);
+		commandBuffer.pushConstants(this->PipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
+
+		if (pushConstants.ObjectCount > 0)
+		{
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, this->CullPipeline);
+			commandBuffer.dispatch((pushConstants.ObjectCount + CullGroupSize - 1) / CullGroupSize, 1, 1);
+		}
+
+		const vk::MemoryBarrier cullBarrier(
+			vk::AccessFlagBits::eShaderWrite,
+			vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, cullBarrier, nullptr, nullptr);
+
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, this->CompactPipeline);
+		commandBuffer.dispatch((meshCount + CullGroupSize - 1) / CullGroupSize, 1, 1);
+
+		const vk::MemoryBarrier drawBarrier(
+			vk::AccessFlagBits::eShaderWrite,
+			vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eVertexAttributeRead);
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput,
+			{}, drawBarrier, nullptr, nullptr);
+	}
+
+	void GpuScene::RecordDraws(vk::CommandBuffer commandBuffer, uint32_t frame) const
+	{
+		if (!this->Vertices)
+			return;
+
+		const auto& frameBuffers = this->Frames[frame];
+		const auto meshCount = GetMeshCount();
+		constexpr vk::DeviceSize offset = 0;
+		constexpr uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+
+		commandBuffer.bindVertexBuffers(0, 1, &this->Vertices->Buffer, &offset);
+		commandBuffer.bindVertexBuffers(1, 1, &frameBuffers.Instances, &offset);
+		commandBuffer.bindIndexBuffer(this->Indices->Buffer, 0, Index::IndexType);
+
+		if (this->DeviceContext->DrawIndirectCountSupported)
+		{
+			commandBuffer.drawIndexedIndirectCount(frameBuffers.Draws, this->DrawsOffset, frameBuffers.Draws, 0, meshCount, stride);
+			return;
+		}
+
+		// Every mesh's draw, the ones that culled everything have no instances
+		if (this->DeviceContext->MultiDrawIndirectSupported)
+		{
+			commandBuffer.drawIndexedIndirect(frameBuffers.Commands, 0, meshCount, stride);
+			return;
+		}
+
+		for (uint32_t mesh = 0; mesh < meshCount; mesh++)
+			commandBuffer.drawIndexedIndirect(frameBuffers.Commands, mesh * stride, 1, stride);
+	}
+
+	void GpuScene::Destroy()
+	{
+		auto& deletion = this->DeviceContext->Deletion;
+		auto& device = this->DeviceContext->LogicalDevice;
+
+		if (this->Vertices)
+		{
+			this->Vertices->Destroy();
+			this->Indices->Destroy();
+		}
+
+		deletion->DeferBuffer(this->ObjectBuffer, this->ObjectBufferAllocation);
+		deletion->DeferBuffer(this->UploadBuffer, this->UploadBufferAllocation);
+
+		for (auto& frame : this->Frames)
+		{
+			deletion->DeferBuffer(frame.Commands, frame.CommandsAllocation);
+			deletion->DeferBuffer(frame.Draws, frame.DrawsAllocation);
+			deletion->DeferBuffer(frame.Instances, frame.InstancesAllocation);
+		}
+
+		this->Frames.clear();
+		this->UploadData = nullptr;
+
+		device.destroyPipeline(this->CullPipeline);
+		device.destroyPipeline(this->CompactPipeline);
+		device.destroyPipelineLayout(this->PipelineLayout);
+		device.destroyDescriptorPool(this->DescriptorPool);
+		device.destroyDescriptorSetLayout(this->DescriptorSetLayout);
+	}
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "renderer/vulkandevicecontext.h"
+#include "renderer/vulkanmem.h"
+#include "renderer/vertex.h"
+
+namespace Engine
+{
+	// One object as the culling shader sees it, matches cull.comp
+	struct GpuObject
+	{
+		glm::mat4 Model;
+
+		// Bounding sphere in model space, radius in w
+		glm::vec4 Bounds;
+
+		uint32_t Mesh;
+		uint32_t Material;
+		uint32_t Padding[2];
+	};
+
+	// Matches cull.comp and compact.comp
+	struct CullPushConstants
+	{
+		std::array<glm::vec4, 6> FrustumPlanes;
+		uint32_t ObjectCount;
+		uint32_t MeshCount;
+	};
+
+	// Objects drawn without the CPU looking at them every frame. Transforms and bounds live in a
+	// device local storage buffer, and only objects that changed are copied in, a capped number
+	// per frame. Each frame a compute pass frustum culls every object, writes the survivors'
+	// instance data grouped per mesh and bumps that mesh's indirect draw, then a second pass
+	// compacts the non-empty draws and writes their count. Meshes share one vertex and index
+	// buffer, so the whole scene is a single drawIndexedIndirectCount.
+	// Without draw indirect count the uncompacted draws are used, empty ones just draw nothing.
+	class GpuScene
+	{
+	private:
+		struct MeshRange
+		{
+			uint32_t IndexCount;
+			uint32_t FirstIndex;
+			int32_t VertexOffset;
+			glm::vec4 Bounds;
+		};
+
+		// Everything written by the frame's passes, only touched by that frame slot
+		struct FrameBuffers
+		{
+			// Per mesh draw, reset from the CPU's templates every frame
+			vk::Buffer Commands;
+			MemAllocation CommandsAllocation;
+
+			// Draw count, then the compacted draws from DrawsOffset
+			vk::Buffer Draws;
+			MemAllocation DrawsAllocation;
+
+			// InstanceData of every visible object, grouped per mesh
+			vk::Buffer Instances;
+			MemAllocation InstancesAllocation;
+
+			vk::DescriptorSet DescriptorSet;
+		};
+
+		// The count is padded out so the draws after it stay 16 byte aligned
+		static constexpr vk::DeviceSize DrawsOffset = 16;
+
+		std::shared_ptr<VulkanDeviceContext> DeviceContext;
+
+		uint32_t MaxObjects;
+		uint32_t MaxMeshes;
+		uint32_t MaxUpdatesPerFrame;
+
+		// Geometry until Commit
+		std::vector<Vertex> PendingVertices;
+		std::vector<Index> PendingIndices;
+		std::vector<MeshRange> Meshes;
+
+		// CPU copy of every object, the GPU one catches up through Dirty
+		std::vector<GpuObject> Objects;
+		std::vector<uint32_t> ObjectsPerMesh;
+
+		// Objects to copy over, oldest first. New objects are always queued in index order.
+		std::deque<uint32_t> DirtyQueue;
+		std::vector<bool> Dirty;
+
+		// Objects [0, UploadedCount) have reached the GPU at least once
+		uint32_t UploadedCount = 0;
+
+		vk::Buffer ObjectBuffer;
+		MemAllocation ObjectBufferAllocation;
+
+		// Per frame segment of draw templates, then object updates from TemplatesSize
+		vk::Buffer UploadBuffer;
+		MemAllocation UploadBufferAllocation;
+		uint8_t* UploadData = nullptr;
+		vk::DeviceSize UploadSegmentSize = 0;
+		vk::DeviceSize TemplatesSize = 0;
+
+		std::vector<FrameBuffers> Frames;
+
+		vk::DescriptorPool DescriptorPool;
+		vk::DescriptorSetLayout DescriptorSetLayout;
+		vk::PipelineLayout PipelineLayout;
+		vk::Pipeline CullPipeline;
+		vk::Pipeline CompactPipeline;
+
+		void CreateBuffers(uint32_t framesInFlight);
+		void CreateDescriptorSets(uint32_t framesInFlight);
+		void CreatePipelines();
+
+		// Normalized, pointing inwards
+		static std::array<glm::vec4, 6> GetFrustumPlanes(const glm::mat4& viewProj);
+
+	public:
+		// Shared by every mesh, null until Commit. Don't draw until both are resident.
+		std::unique_ptr<VertexInputBuffer<Vertex>> Vertices;
+		std::unique_ptr<VertexInputBuffer<Index>> Indices;
+
+		// Returns the mesh id. Only before Commit.
+		uint32_t AddMesh(const std::vector<Vertex>& vertices, const std::vector<Index>& indices);
+
+		// Uploads the meshes added so far
+		void Commit();
+
+		// Returns the object id, material is the bindless slot of its texture
+		uint32_t AddObject(uint32_t mesh, uint32_t material, const glm::mat4& transform);
+
+		// Reaches the GPU over the next frames, oldest changes first
+		void UpdateObject(uint32_t object, uint32_t material, const glm::mat4& transform);
+
+		// Outside a render pass. Copies this frame's object changes and draw templates, then culls
+		// against viewProj and leaves the draws and instances ready for RecordDraws. Call once the
+		// GPU is done with frame's previous submission.
+		void RecordCulling(vk::CommandBuffer commandBuffer, uint32_t frame, const glm::mat4& viewProj);
+
+		// Inside the render pass, with a pipeline taking InstanceData at binding 1 bound. Only
+		// depends on frame and the geometry buffers, so it can be recorded once and replayed.
+		void RecordDraws(vk::CommandBuffer commandBuffer, uint32_t frame) const;
+
+		uint32_t GetMeshCount() const
+		{
+			return static_cast<uint32_t>(this->Meshes.size());
+		}
+
+		uint32_t GetObjectCount() const
+		{
+			return static_cast<uint32_t>(this->Objects.size());
+		}
+
+		// Call once the device is idle
+		void Destroy();
+
+		GpuScene(std::shared_ptr<VulkanDeviceContext> devCtx, uint32_t framesInFlight, uint32_t maxObjects, uint32_t maxMeshes, uint32_t maxUpdatesPerFrame);
+	};
+}
@@ -1,10 +1,183 @@
 #include "renderer/image.h"
 
+#include <cstdlib>
+
+namespace Engine
+{
+	static void* StbMalloc(size_t size);
+	static void* StbRealloc(void* pointer, size_t size);
+	static void StbFree(void* pointer);
+}
+
+#define STBI_MALLOC(size) Engine::StbMalloc(size)
+#define STBI_REALLOC(pointer, size) Engine::StbRealloc(pointer, size)
+#define STBI_FREE(pointer) Engine::StbFree(pointer)
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <cmath>
+#include <array>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <filesystem>
+#include <span>
+
+#include "files.h"
+#include "renderer/ktx2.h"
+#include "renderer/texturecache.h"
+
 namespace Engine
 {
+	// vkCmdBlitImage with a linear filter needs all three of these
+	static bool SupportsLinearBlit(const vk::PhysicalDevice& physicalDevice, vk::Format format)
+	{
+		constexpr auto required = vk::FormatFeatureFlagBits::eBlitSrc
+			| vk::FormatFeatureFlagBits::eBlitDst
+			| vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+
+		auto features = physicalDevice.getFormatProperties(format).optimalTilingFeatures;
+
+		return (features & required) == required;
+	}
+
+	// Lets DecodeStb point stb_image's output at decode staging. stb has no way to pass a buffer in,
+	// but it allocates the output in one go at width * height * 4, so while armed the first
+	// allocation of that size gets the staging memory. Anything else, or the output ending up
+	// somewhere else after all, just means a heap decode.
+	struct StbOutputTarget
+	{
+		uint8_t* Data = nullptr;
+		size_t Size = 0;
+		bool Taken = false;
+	};
+
+	// The JPEG decoder asks for one byte more than the image, so level 0 gets that much extra room
+	constexpr size_t StbOutputSlack = 1;
+
+	static thread_local StbOutputTarget StbOutput;
+
+	static void* StbMalloc(size_t size)
+	{
+		if (StbOutput.Data && !StbOutput.Taken && size >= StbOutput.Size && size <= StbOutput.Size + StbOutputSlack)
+		{
+			StbOutput.Taken = true;
+			return StbOutput.Data;
+		}
+
+		return std::malloc(size);
+	}
+
+	static void* StbRealloc(void* pointer, size_t size)
+	{
+		if (pointer && pointer == StbOutput.Data)
+		{
+			// Outgrew the staging memory, carry on on the heap
+			auto* moved = std::malloc(size);
+			if (moved)
+				std::memcpy(moved, pointer, std::min(size, StbOutput.Size + StbOutputSlack));
+
+			StbOutput.Taken = false;
+			return moved;
+		}
+
+		return std::realloc(pointer, size);
+	}
+
+	static void StbFree(void* pointer)
+	{
+		if (pointer && pointer == StbOutput.Data)
+		{
+			StbOutput.Taken = false;
+			return;
+		}
+
+		std::free(pointer);
+	}
+
+	static size_t RgbaLevelSize(uint32_t width, uint32_t height, uint32_t level)
+	{
+		return static_cast<size_t>(std::max(1u, width >> level)) * std::max(1u, height >> level) * 4;
+	}
+
+	static float SrgbToLinear(uint8_t value)
+	{
+		// Only 256 inputs, so they're worked out once
+		static const auto table = []()
+		{
+			std::array<float, 256> table{};
+			for (uint32_t i = 0; i < table.size(); i++)
+			{
+				const float c = i / 255.0f;
+				table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			return table;
+		}();
+
+		return table[value];
+	}
+
+	static uint8_t LinearToSrgb(float value)
+	{
+		const float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+		return static_cast<uint8_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+
+	// 2x2 box filter for sRGB RGBA8, for formats the GPU can't blit. Odd edges reuse the last texel.
+	// Colour is averaged in linear space like a blit would, alpha is linear already.
+	// levels[0] is the full size image, every other level is written from the one above it.
+	static void GenerateMipsOnCpu(
+		const std::vector<uint8_t*>& levels,
+		uint32_t width,
+		uint32_t height)
+	{
+		const uint8_t* src = levels[0];
+		uint32_t srcWidth = width;
+		uint32_t srcHeight = height;
+
+		for (uint32_t level = 1; level < levels.size(); level++)
+		{
+			const auto dstWidth = std::max(1u, srcWidth / 2);
+			const auto dstHeight = std::max(1u, srcHeight / 2);
+
+			auto* dst = levels[level];
+
+			for (uint32_t y = 0; y < dstHeight; y++)
+			{
+				const auto y0 = std::min(y * 2, srcHeight - 1);
+				const auto y1 = std::min(y * 2 + 1, srcHeight - 1);
+
+				for (uint32_t x = 0; x < dstWidth; x++)
+				{
+					const auto x0 = std::min(x * 2, srcWidth - 1);
+					const auto x1 = std::min(x * 2 + 1, srcWidth - 1);
+
+					for (uint32_t c = 0; c < 3; c++)
+					{
+						const float sum = SrgbToLinear(src[(y0 * srcWidth + x0) * 4 + c])
+							+ SrgbToLinear(src[(y0 * srcWidth + x1) * 4 + c])
+							+ SrgbToLinear(src[(y1 * srcWidth + x0) * 4 + c])
+							+ SrgbToLinear(src[(y1 * srcWidth + x1) * 4 + c]);
+
+						dst[(y * dstWidth + x) * 4 + c] = LinearToSrgb(sum / 4.0f);
+					}
+
+					const uint32_t alpha = src[(y0 * srcWidth + x0) * 4 + 3]
+						+ src[(y0 * srcWidth + x1) * 4 + 3]
+						+ src[(y1 * srcWidth + x0) * 4 + 3]
+						+ src[(y1 * srcWidth + x1) * 4 + 3];
+
+					dst[(y * dstWidth + x) * 4 + 3] = static_cast<uint8_t>((alpha + 2) / 4);
+				}
+			}
+
+			src = dst;
+			srcWidth = dstWidth;
+			srcHeight = dstHeight;
+		}
+	}
+
 	void Image::CreateImageView(vk::Format format)
 	{
 		vk::ImageViewCreateInfo createInfo{};
@@ -19,7 +192,7 @@ namespace Engine
 
 		createInfo.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
 		createInfo.subresourceRange.baseMipLevel = 0;
-		createInfo.subresourceRange.levelCount = 1;
+		createInfo.subresourceRange.levelCount = this->MipLevels;
 		createInfo.subresourceRange.baseArrayLayer = 0;
 		createInfo.subresourceRange.layerCount = 1;
 
@@ -28,59 +201,219 @@ namespace Engine
 		this->ImageView = this->DeviceContext->LogicalDevice.createImageView(createInfo);
 	}
 
-	void Image::CreateTextureImage(const char* texturePath)
+	std::shared_ptr<Image> Image::Load(std::shared_ptr<VulkanDeviceContext> devCtx, const std::string& texturePath)
+	{
+		return devCtx->Textures->Get(texturePath);
+	}
+
+	void Image::Decode(const vk::PhysicalDevice& physicalDevice, const std::string& texturePath, DecodedTexture& decoded, bool cpuMips, DecodeStagingRing* staging)
+	{
+		const std::filesystem::path path(texturePath);
+
+		if (path.extension() == ".ktx2")
+		{
+			if (!DecodeKtx2(physicalDevice, texturePath, decoded))
+				throw std::runtime_error("Texture format is not supported by the device.");
+
+			return;
+		}
+
+		// Prefer a baked .ktx2 sitting next to the source asset, it goes to the GPU as is
+		auto bakedPath = path;
+		bakedPath.replace_extension(".ktx2");
+
+		if (Filesystem::FileExists(bakedPath.string()) && DecodeKtx2(physicalDevice, bakedPath.string(), decoded))
+			return;
+
+		DecodeStb(physicalDevice, texturePath, decoded, cpuMips, staging);
+	}
+
+	bool Image::DecodeKtx2(const vk::PhysicalDevice& physicalDevice, const std::string& texturePath, DecodedTexture& decoded)
+	{
+		auto file = std::make_shared<MappedFile>();
+		file->Open(texturePath);
+
+		Ktx2Texture texture;
+		ParseKtx2(file->GetData(), file->GetSize(), texture);
+
+		// BC formats are optional, e.g. most mobile GPUs don't have them. Every texture goes through
+		// the linear sampler from GetSamplerInfo, so filtering has to work too.
+		constexpr auto required = vk::FormatFeatureFlagBits::eSampledImage
+			| vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+
+		auto features = physicalDevice.getFormatProperties(texture.Format).optimalTilingFeatures;
+		if ((features & required) != required)
+			return false;
+
+		decoded.Width = texture.Width;
+		decoded.Height = texture.Height;
+		decoded.MipLevels = static_cast<uint32_t>(texture.Levels.size());
+		decoded.Format = texture.Format;
+		decoded.Block = texture.Block;
+		decoded.GenerateMips = false;
+
+		// Level data goes from the mapping straight into staging, no decode
+		decoded.Levels.clear();
+		for (const auto& level : texture.Levels)
+			decoded.Levels.push_back(level.Data);
+
+		decoded.Source = std::move(file);
+
+		return true;
+	}
+
+	void Image::DecodeStb(const vk::PhysicalDevice& physicalDevice, const std::string& texturePath, DecodedTexture& decoded, bool cpuMips, DecodeStagingRing* staging)
 	{
 		int texWidth, texHeight, texChannels;
-		stbi_uc* pixels = stbi_load(texturePath, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		if (!stbi_info(texturePath.c_str(), &texWidth, &texHeight, &texChannels))
+			throw std::runtime_error("Failed to load texture image.");
+
+		decoded.Width = texWidth;
+		decoded.Height = texHeight;
+		decoded.MipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+		decoded.Format = vk::Format::eR8G8B8A8Srgb;
+		decoded.Block = TexelBlock{ 4 };
+		decoded.GenerateMips = !cpuMips && SupportsLinearBlit(physicalDevice, decoded.Format);
+
+		// Levels we fill in ourselves, back to back
+		const auto levelCount = decoded.GenerateMips ? 1u : decoded.MipLevels;
+
+		std::vector<size_t> offsets;
+		size_t totalSize = 0;
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			const auto slack = level == 0 ? StbOutputSlack : 0;
+
+			offsets.push_back(totalSize);
+			totalSize += (RgbaLevelSize(decoded.Width, decoded.Height, level) + slack + StagingAlignment - 1) & ~(StagingAlignment - 1);
+		}
+
+		// The whole chain goes in staging if it fits, otherwise it's a heap decode
+		uint8_t* staged = nullptr;
+		if (staging && staging->TryAllocate(totalSize, decoded.Staged))
+			staged = static_cast<uint8_t*>(decoded.Staged.Region.Data);
+
+		StbOutput = StbOutputTarget{ staged, RgbaLevelSize(decoded.Width, decoded.Height, 0) };
+		stbi_uc* pixels = stbi_load(texturePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		StbOutput = StbOutputTarget{};
 		
 		if (!pixels)
+		{
+			decoded.Staged = DecodeStagingAllocation{};
 			throw std::runtime_error("Failed to load texture image.");
+		}
+
+		// Shows up in the memory report, heap decodes there mean the hook above missed
+		if (staging)
+			staging->CountDecode(staged && pixels == staged);
+
+		std::vector<uint8_t*> levels;
+
+		if (staged && pixels == staged)
+		{
+			// Decoded in place, the mips go right after it
+			for (auto offset : offsets)
+				levels.push_back(staged + offset);
+		}
+		else
+		{
+			decoded.Staged = DecodeStagingAllocation{};
+			decoded.Source = std::shared_ptr<const void>(pixels, stbi_image_free);
 
-		vk::DeviceSize imageSize = texWidth * texHeight * 4;
-		vk::Buffer stagingBuffer;
-		vk::DeviceMemory stagingBufferMemory;
+			levels.push_back(pixels);
 
-		this->DeviceContext->MemManager->CreateBuffer(
-			stagingBuffer,
-			stagingBufferMemory,
-			imageSize,
-			vk::BufferUsageFlagBits::eTransferSrc,
-			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+			decoded.Mips.resize(levelCount - 1);
+			for (uint32_t level = 1; level < levelCount; level++)
+			{
+				decoded.Mips[level - 1].resize(RgbaLevelSize(decoded.Width, decoded.Height, level));
+				levels.push_back(decoded.Mips[level - 1].data());
+			}
+		}
 
-		auto data = this->DeviceContext->MemManager->MapMemory(stagingBufferMemory, 0, imageSize);
-		std::memcpy(data, pixels, static_cast<size_t>(imageSize));
-		this->DeviceContext->MemManager->UnmapMemory(stagingBufferMemory);
+		// The box filter is the slow part, so it runs here rather than on the main thread
+		GenerateMipsOnCpu(levels, decoded.Width, decoded.Height);
 
-		stbi_image_free(pixels);
+		decoded.Levels.assign(levels.begin(), levels.end());
+	}
+
+	void Image::CreateTextureImage(const DecodedTexture& decoded, uint32_t firstLevel)
+	{
+		if (firstLevel >= decoded.MipLevels || (firstLevel > 0 && decoded.GenerateMips))
+			throw std::invalid_argument("Decoded texture doesn't have the requested levels.");
+
+		if (decoded.Staged.IsValid())
+			throw std::invalid_argument("Staged textures upload once, move them in.");
+
+		this->Width = std::max(1u, decoded.Width >> firstLevel);
+		this->Height = std::max(1u, decoded.Height >> firstLevel);
+		this->MipLevels = decoded.MipLevels - firstLevel;
+		this->Format = decoded.Format;
 
 		this->DeviceContext->MemManager->CreateImage(
 			this->VulkanImage,
-			this->ImageMemory,
-			texWidth,
-			texHeight,
-			vk::Format::eR8G8B8A8Srgb,
+			this->ImageAllocation,
+			this->Width,
+			this->Height,
+			this->MipLevels,
+			this->Format,
 			vk::ImageTiling::eOptimal,
-			vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
-			vk::MemoryPropertyFlagBits::eDeviceLocal);
+			TextureUsage,
+			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			MemoryCategory::Texture);
+
+		auto& uploader = this->DeviceContext->Uploader;
+
+		if (decoded.GenerateMips)
+			this->Ticket = uploader->UploadImage(this->VulkanImage, decoded.Levels[0], this->Width, this->Height, decoded.Block.Size, this->MipLevels);
+		else
+			this->Ticket = uploader->UploadImageLevels(this->VulkanImage, std::span(decoded.Levels).subspan(firstLevel), this->Width, this->Height, decoded.Block);
+	}
+
+	void Image::CreateTextureImage(DecodedTexture&& decoded)
+	{
+		if (!decoded.Staged.IsValid())
+		{
+			CreateTextureImage(static_cast<const DecodedTexture&>(decoded));
+			return;
+		}
+
+		this->Width = decoded.Width;
+		this->Height = decoded.Height;
+		this->MipLevels = decoded.MipLevels;
+		this->Format = decoded.Format;
 
-		this->DeviceContext->MemManager->TransitionImageLayout(
+		this->DeviceContext->MemManager->CreateImage(
 			this->VulkanImage,
-			vk::Format::eR8G8B8A8Srgb,
-			vk::ImageLayout::eUndefined,
-			vk::ImageLayout::eTransferDstOptimal);
+			this->ImageAllocation,
+			this->Width,
+			this->Height,
+			this->MipLevels,
+			this->Format,
+			vk::ImageTiling::eOptimal,
+			TextureUsage,
+			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			MemoryCategory::Texture);
 
-		this->DeviceContext->MemManager->CopyBufferToImage(this->VulkanImage, stagingBuffer, texWidth, texHeight);
+		// Copies straight out of the decoder's output, nothing to memcpy
+		this->Ticket = this->DeviceContext->Uploader->UploadStagedImage(
+			this->VulkanImage,
+			decoded.Staged,
+			decoded.Levels,
+			this->Width,
+			this->Height,
+			decoded.Block,
+			this->MipLevels);
+	}
 
-		this->DeviceContext->MemManager->TransitionImageLayout(
-			this->VulkanImage, 
-			vk::Format::eR8G8B8A8Srgb, 
-			vk::ImageLayout::eTransferDstOptimal, 
-			vk::ImageLayout::eShaderReadOnlyOptimal);
+	void Image::CreateTextureImage(const char* texturePath)
+	{
+		DecodedTexture decoded;
+		Decode(this->DeviceContext->PhysicalDevice, texturePath, decoded);
 
-		this->DeviceContext->MemManager->DestroyBuffer(stagingBuffer, stagingBufferMemory);
+		CreateTextureImage(decoded);
 	}
 
-	void Image::CreateTextureSampler()
+	vk::SamplerCreateInfo Image::GetSamplerInfo(const VulkanDeviceContext& devCtx)
 	{
 		vk::SamplerCreateInfo samplerInfo{};
 
@@ -90,7 +423,7 @@ namespace Engine
 		
 		// Anisotropy
 		samplerInfo.anisotropyEnable = VK_TRUE;
-		samplerInfo.maxAnisotropy = this->DeviceContext->PhysicalDeviceProperties.limits.maxSamplerAnisotropy;
+		samplerInfo.maxAnisotropy = devCtx.PhysicalDeviceProperties.limits.maxSamplerAnisotropy;
 
 		samplerInfo.borderColor = vk::BorderColor::eIntOpaqueBlack;
 		samplerInfo.unnormalizedCoordinates = VK_FALSE;
@@ -99,8 +432,13 @@ namespace Engine
 		samplerInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
 		samplerInfo.mipLodBias = 0.0f;
 		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+		return samplerInfo;
+	}
 
-		this->Sampler = this->DeviceContext->LogicalDevice.createSampler(samplerInfo);
+	void Image::CreateTextureSampler()
+	{
+		this->Sampler = this->DeviceContext->Samplers->Get(GetSamplerInfo(*this->DeviceContext));
 	}
 }
\ No newline at end of file
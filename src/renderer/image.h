@@ -4,12 +4,39 @@
 
 #include <memory>
 #include <cstring>
+#include <string>
+#include <vector>
 
 #include "renderer/vulkandevicecontext.h"
 #include "renderer/vulkanmem.h"
+#include "renderer/upload.h"
 
 namespace Engine
 {
+	// Texels ready for upload, produced off the main thread by Image::Decode
+	struct DecodedTexture
+	{
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		uint32_t MipLevels = 1;
+		vk::Format Format = vk::Format::eUndefined;
+		TexelBlock Block{ 4 };
+
+		// Only level 0 is in Levels, the GPU blits the rest
+		bool GenerateMips = false;
+
+		// Points into Source, Mips or Staged
+		std::vector<const void*> Levels;
+
+		// stb pixels or the mapped .ktx2, freed with this
+		std::shared_ptr<const void> Source;
+		std::vector<std::vector<uint8_t>> Mips;
+
+		// Set when stb decoded (and the mips were generated) straight into decode staging.
+		// Uploads once, from there, and the space goes back once the copies have run.
+		DecodeStagingAllocation Staged;
+	};
+
 	class Image
 	{
 	private:
@@ -17,36 +44,119 @@ namespace Engine
 
 	public:
 		vk::Image VulkanImage;
-		vk::DeviceMemory ImageMemory;
+		MemAllocation ImageAllocation;
 		vk::ImageView ImageView;
 
-		// TODO: Move sampler to separate class
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		uint32_t MipLevels = 1;
+		vk::Format Format = vk::Format::eUndefined;
+
+		// Transfer source so the defragmenter can copy it somewhere else
+		constexpr static vk::ImageUsageFlags TextureUsage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled;
+
+		// Don't sample until the uploader says this is resident
+		UploadTicket Ticket;
+
+		// Owned by the device's sampler cache
 		vk::Sampler Sampler;
 
+		// .ktx2 files (or a .ktx2 next to the given file) are used as is, anything else goes
+		// through stb_image. Only reads the physical device, so it's safe on any thread.
+		// cpuMips generates the mip chain here even if the GPU could blit it. With staging, stb
+		// output lands in decode staging when there's room, instead of on the heap.
+		static void Decode(const vk::PhysicalDevice& physicalDevice, const std::string& texturePath, DecodedTexture& decoded, bool cpuMips = false, DecodeStagingRing* staging = nullptr);
+
+		// False if the device can't sample the file's format
+		static bool DecodeKtx2(const vk::PhysicalDevice& physicalDevice, const std::string& texturePath, DecodedTexture& decoded);
+		static void DecodeStb(const vk::PhysicalDevice& physicalDevice, const std::string& texturePath, DecodedTexture& decoded, bool cpuMips, DecodeStagingRing* staging);
+
+		// Shared handle from the device's texture cache, a file is only ever loaded once.
+		// Loads in the background on a miss, check Ticket before sampling.
+		static std::shared_ptr<Image> Load(std::shared_ptr<VulkanDeviceContext> devCtx, const std::string& texturePath);
+
+		// Main thread only. Texels are copied into staging before this returns. A firstLevel past
+		// 0 leaves the finer levels out, that needs every level in decoded.Levels.
+		void CreateTextureImage(const DecodedTexture& decoded, uint32_t firstLevel = 0);
+
+		// Takes the decode staging with it if there is any, copies go straight from there
+		void CreateTextureImage(DecodedTexture&& decoded);
 		void CreateTextureImage(const char* texturePath);
 		void CreateImageView(vk::Format format);
 		void CreateTextureSampler();
 
+		// What every texture samples with for now. Leaves maxLod unclamped so it doesn't
+		// depend on the image, the view already limits the mips.
+		static vk::SamplerCreateInfo GetSamplerInfo(const VulkanDeviceContext& devCtx);
+
 		void DestroyImageView()
 		{
-			this->DeviceContext->LogicalDevice.destroyImageView(this->ImageView);
+			this->DeviceContext->Deletion->DeferImageView(this->ImageView);
+			this->ImageView = VK_NULL_HANDLE;
 		}
 
+		// Takes over other's GPU image and leaves it empty. Ours is freed once the frames in
+		// flight are done with it, anything holding on to the old view has to pick up the new one.
+		void Replace(Image& other)
+		{
+			DestroyImageView();
+			this->DeviceContext->Deletion->DeferImage(this->VulkanImage, this->ImageAllocation);
+
+			this->VulkanImage = other.VulkanImage;
+			this->ImageAllocation = other.ImageAllocation;
+			this->ImageView = other.ImageView;
+			this->Width = other.Width;
+			this->Height = other.Height;
+			this->MipLevels = other.MipLevels;
+			this->Format = other.Format;
+			this->Ticket = other.Ticket;
+			this->Sampler = other.Sampler;
+
+			other.VulkanImage = VK_NULL_HANDLE;
+			other.ImageAllocation = MemAllocation{};
+			other.ImageView = VK_NULL_HANDLE;
+		}
+
+		// Freed once the frames in flight are done with it
 		void Destroy()
 		{
-			this->DeviceContext->LogicalDevice.destroySampler(this->Sampler);
+			this->Sampler = VK_NULL_HANDLE;
 
 			DestroyImageView();
 
-			this->DeviceContext->MemManager->DestroyImage(this->VulkanImage, this->ImageMemory);
+			this->DeviceContext->Deletion->DeferImage(this->VulkanImage, this->ImageAllocation);
+			this->VulkanImage = VK_NULL_HANDLE;
+			this->ImageAllocation = MemAllocation{};
 		}
 
-		// Load from file
+		// Load from file, bypasses the texture cache
 		Image(std::shared_ptr<VulkanDeviceContext> devCtx, const char* texturePath) :
 			DeviceContext(devCtx)
 		{
 			CreateTextureImage(texturePath);
-			CreateImageView(vk::Format::eR8G8B8A8Srgb);
+			CreateImageView(this->Format);
+			CreateTextureSampler();
+		}
+
+		// Filled in later by CreateTextureImage, never resident until then
+		explicit Image(std::shared_ptr<VulkanDeviceContext> devCtx) :
+			DeviceContext(devCtx)
+		{
+			this->Ticket.Value = UINT64_MAX;
+		}
+
+		// Tightly packed RGBA8, no mips. Meant for small generated textures.
+		Image(std::shared_ptr<VulkanDeviceContext> devCtx, const uint8_t* pixels, uint32_t width, uint32_t height) :
+			DeviceContext(devCtx)
+		{
+			DecodedTexture decoded;
+			decoded.Width = width;
+			decoded.Height = height;
+			decoded.Format = vk::Format::eR8G8B8A8Srgb;
+			decoded.Levels = { pixels };
+
+			CreateTextureImage(decoded);
+			CreateImageView(this->Format);
 			CreateTextureSampler();
 		}
 
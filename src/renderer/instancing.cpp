@@ -0,0 +1,70 @@
+#include "renderer/instancing.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace Engine
+{
+	InstanceBatcher::InstanceBatcher(std::shared_ptr<VulkanDeviceContext> devCtx, uint32_t framesInFlight, uint32_t instancesPerFrame) :
+		DeviceContext(devCtx),
+		InstancesPerFrame(instancesPerFrame)
+	{
+		// Rewritten every frame, the GPU reads it straight out of host memory
+		this->DeviceContext->MemManager->CreateBuffer(
+			this->InstanceBuffer,
+			this->InstanceBufferAllocation,
+			GetSegmentOffset(framesInFlight),
+			vk::BufferUsageFlagBits::eVertexBuffer,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			MemoryCategory::Vertex);
+
+		this->Data = static_cast<uint8_t*>(this->DeviceContext->MemManager->MapMemory(this->InstanceBufferAllocation));
+	}
+
+	void InstanceBatcher::Build(uint32_t frame, uint32_t meshCount, std::vector<InstanceBatch>& batches)
+	{
+		batches.clear();
+
+		if (this->Pending.size() > this->InstancesPerFrame)
+			throw std::runtime_error("Instance buffer segment exhausted, raise the per-frame budget.");
+
+		// Count per mesh, then turn the counts into where each mesh's run starts
+		this->MeshOffsets.assign(meshCount, 0);
+		for (const auto& instance : this->Pending)
+		{
+			if (instance.Mesh >= meshCount)
+			{
+				this->Pending.clear();
+				throw std::invalid_argument("Mesh doesn't exist.");
+			}
+
+			this->MeshOffsets[instance.Mesh]++;
+		}
+
+		uint32_t first = 0;
+		for (uint32_t mesh = 0; mesh < meshCount; mesh++)
+		{
+			const auto count = this->MeshOffsets[mesh];
+			if (count > 0)
+				batches.push_back({ mesh, first, count });
+
+			this->MeshOffsets[mesh] = first;
+			first += count;
+		}
+
+		auto* segment = reinterpret_cast<InstanceData*>(this->Data + GetSegmentOffset(frame));
+		for (const auto& instance : this->Pending)
+			std::memcpy(&segment[this->MeshOffsets[instance.Mesh]++], &instance.Data, sizeof(InstanceData));
+
+		this->Pending.clear();
+	}
+
+	void InstanceBatcher::Destroy()
+	{
+		this->DeviceContext->Deletion->DeferBuffer(this->InstanceBuffer, this->InstanceBufferAllocation);
+
+		this->InstanceBuffer = VK_NULL_HANDLE;
+		this->InstanceBufferAllocation = MemAllocation{};
+		this->Data = nullptr;
+	}
+}
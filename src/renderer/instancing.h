@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "renderer/vulkandevicecontext.h"
+#include "renderer/vulkanmem.h"
+#include "renderer/vertex.h"
+
+namespace Engine
+{
+	// Instances of one mesh, drawn with a single instanced draw. FirstInstance is relative to the
+	// frame's segment, so the same scene gives the same batches in every frame slot.
+	struct InstanceBatch
+	{
+		uint32_t Mesh;
+		uint32_t FirstInstance;
+		uint32_t InstanceCount;
+
+		bool operator==(const InstanceBatch&) const = default;
+	};
+
+	// Collects the frame's (mesh, material, transform) instances and groups them per mesh into a
+	// persistently mapped per-instance vertex buffer, with a segment per frame in flight.
+	// Grouping is a counting sort over the mesh ids, so it's linear in the instance and mesh count.
+	class InstanceBatcher
+	{
+	private:
+		struct PendingInstance
+		{
+			uint32_t Mesh;
+			InstanceData Data;
+		};
+
+		std::shared_ptr<VulkanDeviceContext> DeviceContext;
+
+		uint8_t* Data = nullptr;
+		uint32_t InstancesPerFrame;
+
+		// Submitted since the last Build
+		std::vector<PendingInstance> Pending;
+
+		// Scratch for the counting sort, indexed by mesh
+		std::vector<uint32_t> MeshOffsets;
+
+	public:
+		vk::Buffer InstanceBuffer;
+		MemAllocation InstanceBufferAllocation;
+
+		// material is the bindless slot of the instance's texture
+		void Submit(uint32_t mesh, uint32_t material, const glm::mat4& transform)
+		{
+			this->Pending.push_back({ mesh, { transform, material } });
+		}
+
+		// Writes everything submitted since the last call into frame's segment and replaces batches
+		// with one per mesh, in mesh order. Call once the GPU is done with frame's previous submission.
+		// Mesh ids are checked against meshCount, the pending instances are dropped if one is bad.
+		void Build(uint32_t frame, uint32_t meshCount, std::vector<InstanceBatch>& batches);
+
+		// Where frame's segment starts, bind binding 1 here
+		vk::DeviceSize GetSegmentOffset(uint32_t frame) const
+		{
+			return static_cast<vk::DeviceSize>(frame) * this->InstancesPerFrame * sizeof(InstanceData);
+		}
+
+		// Freed once the frames in flight are done with it
+		void Destroy();
+
+		InstanceBatcher(std::shared_ptr<VulkanDeviceContext> devCtx, uint32_t framesInFlight, uint32_t instancesPerFrame);
+	};
+}
@@ -0,0 +1,123 @@
+#include "renderer/ktx2.h"
+
+#include <array>
+#include <algorithm>
+#include <cstring>
+
+namespace Engine
+{
+	static constexpr std::array<uint8_t, 12> Ktx2Identifier = {
+		0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+	};
+
+	// Header layout from the KTX 2.0 spec, everything little endian
+	struct Ktx2Header
+	{
+		uint8_t Identifier[12];
+		uint32_t VkFormat;
+		uint32_t TypeSize;
+		uint32_t PixelWidth;
+		uint32_t PixelHeight;
+		uint32_t PixelDepth;
+		uint32_t LayerCount;
+		uint32_t FaceCount;
+		uint32_t LevelCount;
+		uint32_t SupercompressionScheme;
+		uint32_t DfdByteOffset;
+		uint32_t DfdByteLength;
+		uint32_t KvdByteOffset;
+		uint32_t KvdByteLength;
+		uint64_t SgdByteOffset;
+		uint64_t SgdByteLength;
+	};
+
+	struct Ktx2LevelIndex
+	{
+		uint64_t ByteOffset;
+		uint64_t ByteLength;
+		uint64_t UncompressedByteLength;
+	};
+
+	static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must be 80 bytes");
+	static_assert(sizeof(Ktx2LevelIndex) == 24, "KTX2 level index entry must be 24 bytes");
+
+	bool GetTexelBlock(vk::Format format, TexelBlock& block)
+	{
+		switch (format)
+		{
+		case vk::Format::eBc1RgbUnormBlock:
+		case vk::Format::eBc1RgbSrgbBlock:
+		case vk::Format::eBc1RgbaUnormBlock:
+		case vk::Format::eBc1RgbaSrgbBlock:
+			block = TexelBlock{ 8, 4, 4 };
+			return true;
+
+		case vk::Format::eBc3UnormBlock:
+		case vk::Format::eBc3SrgbBlock:
+		case vk::Format::eBc5UnormBlock:
+		case vk::Format::eBc5SnormBlock:
+		case vk::Format::eBc7UnormBlock:
+		case vk::Format::eBc7SrgbBlock:
+			block = TexelBlock{ 16, 4, 4 };
+			return true;
+
+		case vk::Format::eR8G8B8A8Unorm:
+		case vk::Format::eR8G8B8A8Srgb:
+			block = TexelBlock{ 4 };
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	void ParseKtx2(const uint8_t* data, size_t size, Ktx2Texture& texture)
+	{
+		if (size < sizeof(Ktx2Header))
+			throw std::runtime_error("KTX2 file is truncated.");
+
+		Ktx2Header header;
+		std::memcpy(&header, data, sizeof(header));
+
+		if (std::memcmp(header.Identifier, Ktx2Identifier.data(), Ktx2Identifier.size()) != 0)
+			throw std::runtime_error("Not a KTX2 file.");
+
+		if (header.SupercompressionScheme != 0)
+			throw std::runtime_error("Supercompressed KTX2 files are not supported.");
+
+		if (header.PixelHeight == 0 || header.PixelDepth != 0 || header.LayerCount > 1 || header.FaceCount != 1)
+			throw std::runtime_error("Only single layer 2D KTX2 textures are supported.");
+
+		texture.Format = static_cast<vk::Format>(header.VkFormat);
+		if (!GetTexelBlock(texture.Format, texture.Block))
+			throw std::runtime_error("Unsupported KTX2 texture format.");
+
+		texture.Width = header.PixelWidth;
+		texture.Height = header.PixelHeight;
+
+		// 0 asks the loader to generate mips, we just take the base level
+		const auto levelCount = std::max(1u, header.LevelCount);
+
+		if (size < sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex))
+			throw std::runtime_error("KTX2 file is truncated.");
+
+		texture.Levels.resize(levelCount);
+
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			Ktx2LevelIndex index;
+			std::memcpy(&index, data + sizeof(Ktx2Header) + level * sizeof(Ktx2LevelIndex), sizeof(index));
+
+			const auto levelWidth = std::max(1u, texture.Width >> level);
+			const auto levelHeight = std::max(1u, texture.Height >> level);
+			const uint64_t expected = static_cast<uint64_t>((levelWidth + texture.Block.Width - 1) / texture.Block.Width)
+				* ((levelHeight + texture.Block.Height - 1) / texture.Block.Height)
+				* texture.Block.Size;
+
+			if (index.ByteOffset + index.ByteLength > size || index.ByteLength < expected)
+				throw std::runtime_error("KTX2 level data is out of bounds.");
+
+			texture.Levels[level] = { data + index.ByteOffset, static_cast<size_t>(expected) };
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+#include <cstdint>
+
+#include "renderer/upload.h"
+
+namespace Engine
+{
+	struct Ktx2Level
+	{
+		const uint8_t* Data;
+		size_t Size;
+	};
+
+	// A KTX2 file whose level data is used in place, so it points into the caller's buffer
+	struct Ktx2Texture
+	{
+		vk::Format Format = vk::Format::eUndefined;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		TexelBlock Block{ 0 };
+
+		// Level 0 is the full size image
+		std::vector<Ktx2Level> Levels;
+	};
+
+	// Formats we can copy straight to the GPU: BC1/BC3/BC5/BC7 and plain RGBA8
+	bool GetTexelBlock(vk::Format format, TexelBlock& block);
+
+	// Only accepts what can be uploaded without touching the texels: 2D, one layer, one face,
+	// no supercompression and a format GetTexelBlock knows. Throws on anything else.
+	void ParseKtx2(const uint8_t* data, size_t size, Ktx2Texture& texture);
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "renderer/memstats.h"
+
+namespace Engine
+{
+	const char* MemoryCategoryName(MemoryCategory category)
+	{
+		switch (category)
+		{
+		case MemoryCategory::Vertex:
+			return "vertex";
+		case MemoryCategory::Index:
+			return "index";
+		case MemoryCategory::Uniform:
+			return "uniform";
+		case MemoryCategory::Texture:
+			return "texture";
+		case MemoryCategory::Staging:
+			return "staging";
+		case MemoryCategory::Swapchain:
+			return "swapchain";
+		case MemoryCategory::Attachment:
+			return "attachment";
+		case MemoryCategory::Storage:
+			return "storage";
+		default:
+			return "unknown";
+		}
+	}
+
+	static void WriteTypeStats(const MemTypeStats& stats, std::ostream& out)
+	{
+		out << "{ \"blocks\": " << stats.BlockCount
+			<< ", \"allocations\": " << stats.AllocationCount
+			<< ", \"block_bytes\": " << stats.BlockBytes
+			<< ", \"used_bytes\": " << stats.UsedBytes
+			<< ", \"free_ranges\": " << stats.FreeRangeCount
+			<< ", \"largest_free_range\": " << stats.LargestFreeRange << " }";
+	}
+
+	void WriteMemoryReportJson(const MemoryReport& report, std::ostream& out)
+	{
+		out << "{\n";
+		out << "  \"budget_supported\": " << (report.BudgetSupported ? "true" : "false") << ",\n";
+		out << "  \"device_allocations\": " << report.Allocator.DeviceAllocationCount << ",\n";
+
+		out << "  \"total\": ";
+		WriteTypeStats(report.Allocator.Total, out);
+		out << ",\n";
+
+		out << "  \"heaps\": [\n";
+		for (size_t i = 0; i < report.Heaps.size(); i++)
+		{
+			const auto& heap = report.Heaps[i];
+
+			out << "    { \"index\": " << i
+				<< ", \"size\": " << heap.Size
+				<< ", \"device_local\": " << (heap.DeviceLocal ? "true" : "false")
+				<< ", \"block_bytes\": " << heap.BlockBytes
+				<< ", \"used_bytes\": " << heap.UsedBytes
+				<< ", \"allocations\": " << heap.AllocationCount
+				<< ", \"budget\": " << heap.Budget
+				<< ", \"usage\": " << heap.Usage << " }"
+				<< (i + 1 < report.Heaps.size() ? ",\n" : "\n");
+		}
+		out << "  ],\n";
+
+		out << "  \"memory_types\": [\n";
+		for (uint32_t i = 0; i < report.MemoryTypeCount; i++)
+		{
+			out << "    { \"index\": " << i << ", \"heap\": " << report.MemoryTypeHeaps[i] << ", \"stats\": ";
+			WriteTypeStats(report.Allocator.MemoryTypes[i], out);
+			out << " }" << (i + 1 < report.MemoryTypeCount ? ",\n" : "\n");
+		}
+		out << "  ],\n";
+
+		out << "  \"categories\": {\n";
+		for (size_t i = 0; i < MemoryCategoryCount; i++)
+		{
+			const auto& counter = report.Categories[i];
+
+			out << "    \"" << MemoryCategoryName(static_cast<MemoryCategory>(i)) << "\": { \"live_bytes\": " << counter.LiveBytes
+				<< ", \"peak_bytes\": " << counter.PeakBytes
+				<< ", \"allocations\": " << counter.AllocationCount << " }"
+				<< (i + 1 < MemoryCategoryCount ? ",\n" : "\n");
+		}
+		out << "  },\n";
+
+		out << "  \"decodes\": { \"staged\": " << report.StagedDecodes
+			<< ", \"heap\": " << report.HeapDecodes << " }\n";
+
+		out << "}\n";
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+
+namespace Engine
+{
+	// Who asked for the memory. Every allocation is tagged with one of these.
+	enum class MemoryCategory : uint8_t
+	{
+		Vertex,
+		Index,
+		Uniform,
+		Texture,
+		Staging,
+		Swapchain,
+		Attachment,
+		Storage,
+
+		Count
+	};
+
+	constexpr size_t MemoryCategoryCount = static_cast<size_t>(MemoryCategory::Count);
+
+	const char* MemoryCategoryName(MemoryCategory category);
+
+	// Live bytes and allocations for one category, plus the high water mark
+	struct MemCounter
+	{
+		vk::DeviceSize LiveBytes = 0;
+		vk::DeviceSize PeakBytes = 0;
+		uint32_t AllocationCount = 0;
+
+		void Add(vk::DeviceSize size)
+		{
+			this->LiveBytes += size;
+			this->PeakBytes = std::max(this->PeakBytes, this->LiveBytes);
+			this->AllocationCount++;
+		}
+
+		void Remove(vk::DeviceSize size)
+		{
+			this->LiveBytes -= size;
+			this->AllocationCount--;
+		}
+	};
+
+	struct MemTypeStats
+	{
+		uint32_t BlockCount = 0;
+		uint32_t AllocationCount = 0;
+		uint32_t FreeRangeCount = 0;
+		vk::DeviceSize BlockBytes = 0;
+		vk::DeviceSize UsedBytes = 0;
+		vk::DeviceSize LargestFreeRange = 0;
+	};
+
+	struct AllocatorStats
+	{
+		MemTypeStats Total;
+		std::array<MemTypeStats, VK_MAX_MEMORY_TYPES> MemoryTypes;
+
+		// Live vkAllocateMemory calls, to compare against maxMemoryAllocationCount
+		uint32_t DeviceAllocationCount = 0;
+	};
+
+	struct MemHeapStats
+	{
+		vk::DeviceSize Size = 0;
+		bool DeviceLocal = false;
+
+		// Our own blocks on this heap and what's sub-allocated out of them
+		vk::DeviceSize BlockBytes = 0;
+		vk::DeviceSize UsedBytes = 0;
+		uint32_t AllocationCount = 0;
+
+		// From VK_EXT_memory_budget, zero when the extension isn't there. Usage is
+		// process-wide as the driver sees it, so it includes swapchain images etc.
+		vk::DeviceSize Budget = 0;
+		vk::DeviceSize Usage = 0;
+	};
+
+	// Snapshot of everything VulkanMemManager knows about device memory
+	struct MemoryReport
+	{
+		bool BudgetSupported = false;
+
+		uint32_t MemoryTypeCount = 0;
+		std::array<uint32_t, VK_MAX_MEMORY_TYPES> MemoryTypeHeaps{};
+
+		std::vector<MemHeapStats> Heaps;
+		AllocatorStats Allocator;
+		std::array<MemCounter, MemoryCategoryCount> Categories;
+
+		// Texture decodes written straight into decode staging, and ones that went through the heap.
+		// Not the allocator's to know, whoever owns the decode staging fills these in.
+		uint32_t StagedDecodes = 0;
+		uint32_t HeapDecodes = 0;
+	};
+
+	void WriteMemoryReportJson(const MemoryReport& report, std::ostream& out);
+}
\ No newline at end of file
@@ -13,6 +13,9 @@ namespace Engine
 		std::optional<uint32_t> GraphicsFamily;
 		std::optional<uint32_t> PresentationFamily;
 
+		// Falls back to the graphics family when the device has no separate transfer family
+		std::optional<uint32_t> TransferFamily;
+
 		bool IsComplete()
 		{
 			return GraphicsFamily.has_value()
@@ -23,20 +26,35 @@ namespace Engine
 		{
 			auto queueFamilies = device.getQueueFamilyProperties();
 
+			std::optional<uint32_t> asyncTransferFamily;
+
 			int i = 0;
 			for (const auto& family : queueFamilies)
 			{
-				if (family.queueFlags & vk::QueueFlagBits::eGraphics)
-					this->GraphicsFamily = i;
+				if (!this->IsComplete())
+				{
+					if (family.queueFlags & vk::QueueFlagBits::eGraphics)
+						this->GraphicsFamily = i;
 
-				if (device.getSurfaceSupportKHR(i, surface))
-					this->PresentationFamily = i;
+					if (device.getSurfaceSupportKHR(i, surface))
+						this->PresentationFamily = i;
+				}
 
-				if (this->IsComplete())
-					break;
+				// Prefer a transfer-only family (the DMA engine), then any non-graphics one
+				if ((family.queueFlags & vk::QueueFlagBits::eTransfer) &&
+					!(family.queueFlags & vk::QueueFlagBits::eGraphics))
+				{
+					if (!(family.queueFlags & vk::QueueFlagBits::eCompute))
+						this->TransferFamily = i;
+					else if (!asyncTransferFamily.has_value())
+						asyncTransferFamily = i;
+				}
 
 				++i;
 			}
+
+			if (!this->TransferFamily.has_value())
+				this->TransferFamily = asyncTransferFamily.has_value() ? asyncTransferFamily : this->GraphicsFamily;
 		}
 	};
 
@@ -44,16 +62,19 @@ namespace Engine
 	{
 		vk::Queue GraphicsQueue;
 		vk::Queue PresentationQueue;
+		vk::Queue TransferQueue;
 
 		void GetQueues(vk::Device& device, const QueueFamilyIndices& indices)
 		{
 			// Create the command queues
 			this->GraphicsQueue = device.getQueue(indices.GraphicsFamily.value(), 0);
 			this->PresentationQueue = device.getQueue(indices.PresentationFamily.value(), 0);
+			this->TransferQueue = device.getQueue(indices.TransferFamily.value(), 0);
 		}
 
 		constexpr VulkanQueues() :
 			GraphicsQueue(VK_NULL_HANDLE),
-			PresentationQueue(VK_NULL_HANDLE) {}
+			PresentationQueue(VK_NULL_HANDLE),
+			TransferQueue(VK_NULL_HANDLE) {}
 	};
 }
\ No newline at end of file
@@ -64,16 +64,23 @@ namespace Engine
 			dynamicStates.data());
 
 		// Vertex input
-		vk::VertexInputBindingDescription bindingDesc;
-		std::array<vk::VertexInputAttributeDescription, 3> attributeDescs;
+		// Binding 0 is per vertex, binding 1 per instance
+		std::array<vk::VertexInputBindingDescription, 2> bindingDescs;
+		std::array<vk::VertexInputAttributeDescription, 3> vertexAttributeDescs;
+		std::array<vk::VertexInputAttributeDescription, 5> instanceAttributeDescs;
 		
-		Vertex::GetBindingDescription(bindingDesc);
-		Vertex::GetAttributeDescriptions(attributeDescs);
+		Vertex::GetBindingDescription(bindingDescs[0]);
+		Vertex::GetAttributeDescriptions(vertexAttributeDescs);
+		InstanceData::GetBindingDescription(bindingDescs[1]);
+		InstanceData::GetAttributeDescriptions(instanceAttributeDescs);
+
+		std::vector<vk::VertexInputAttributeDescription> attributeDescs(vertexAttributeDescs.begin(), vertexAttributeDescs.end());
+		attributeDescs.insert(attributeDescs.end(), instanceAttributeDescs.begin(), instanceAttributeDescs.end());
 
 		const vk::PipelineVertexInputStateCreateInfo vertexInputInfo(
 			{},
-			1, &bindingDesc,
-			attributeDescs.size(), attributeDescs.data());
+			bindingDescs.size(), bindingDescs.data(),
+			static_cast<uint32_t>(attributeDescs.size()), attributeDescs.data());
 
 		// Input assembly
 		constexpr vk::PipelineInputAssemblyStateCreateInfo inputAssembly(
@@ -122,9 +129,16 @@ namespace Engine
 		colorBlending.blendConstants[3] = 0.0f; // Optional
 
 		// Pipeline layout
+		// Set 0 is per frame, set 1 the bindless textures
+		const std::array<vk::DescriptorSetLayout, 2> setLayouts = {
+			this->DescriptorPool->DescriptorSetLayout,
+			this->Bindless->DescriptorSetLayout
+		};
+
+		// The texture index comes in with each instance
 		vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &this->DescriptorPool->DescriptorSetLayout;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
 
 		this->PipelineLayout = this->DeviceContext->LogicalDevice.createPipelineLayout(pipelineLayoutInfo);
 
@@ -192,35 +206,163 @@ namespace Engine
 		this->RenderPass = this->DeviceContext->LogicalDevice.createRenderPass(renderPassInfo);
 	}
 
-	void Renderer::CreateCommandBuffer()
+	bool Renderer::RecordCommandBuffer(vk::CommandBuffer& commandBuffer, uint32_t imageIndex, uint32_t uniformOffset, FrameDrawState& state)
 	{
-		vk::CommandBufferAllocateInfo allocInfo(
-			this->DeviceContext->CommandPool,
-			vk::CommandBufferLevel::ePrimary,
-			this->MAX_FRAMES_IN_FLIGHT);
+		vk::CommandBufferBeginInfo beginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+		commandBuffer.begin(beginInfo);
+
+		// Take ownership of anything the transfer queue finished since last frame
+		auto& uploader = this->DeviceContext->Uploader;
+		uploader->RecordAcquires(commandBuffer);
+
+		// Compact device memory a little, this can swap the handles used below
+		this->Defrag->RecordMoves(commandBuffer, this->CurrentFrame);
+
+		state = GetDrawState(uniformOffset);
+
+		// Writes the draws the pass reads, so it runs every frame even when the pass is cached
+		if (this->GPU_CULLING)
+			this->Scene->RecordCulling(commandBuffer, this->CurrentFrame, this->ViewProjection);
+
+		// Static frames replay their pass from a second command buffer, see GetCachedFrame. One that
+		// changed would miss the cache anyway, so it's recorded here on the workers.
+		const bool recordPass = !this->CACHE_STATIC_FRAMES || UpdateSceneRevision(state);
+		if (recordPass)
+			RecordRenderPass(commandBuffer, imageIndex, uniformOffset, state, true);
 
-		this->CommandBuffers = this->DeviceContext->LogicalDevice.allocateCommandBuffers(allocInfo);
+		commandBuffer.end();
+
+		return recordPass;
 	}
 
-	void Renderer::RecordCommandBuffer(vk::CommandBuffer& commandBuffer, uint32_t imageIndex)
+	void Renderer::RecordRenderPass(vk::CommandBuffer commandBuffer, uint32_t imageIndex, uint32_t uniformOffset, const FrameDrawState& state, bool parallel)
 	{
-		vk::CommandBufferBeginInfo beginInfo{};
-		commandBuffer.begin(beginInfo);
+		this->Graph->Reset();
+
+		// Whatever was in it before doesn't matter, it's cleared
+		const auto backbuffer = this->Graph->ImportImage(
+			"Backbuffer",
+			this->Swapchain.SwapChainImages[imageIndex],
+			this->Swapchain.SwapChainImageViews[imageIndex],
+			{ this->Swapchain.SwapChainImageFormat, this->Swapchain.SwapChainExtent },
+			vk::ImageLayout::eUndefined,
+			vk::ImageLayout::ePresentSrcKHR);
+
+		this->Graph->AddPass("Main",
+			[backbuffer, parallel](RenderGraph::PassBuilder& pass)
+			{
+				constexpr std::array<float, 4> color = { 0.0f, 0.0f, 0.0f, 1.0f };
+				pass.WriteColor(backbuffer, vk::ClearColorValue(color));
+
+				if (parallel)
+					pass.UseSecondaryCommandBuffers();
+			},
+			[this, uniformOffset, &state, parallel](const RenderPassContext& context)
+			{
+				// The GPU scene is one more draw after the batches
+				const auto drawCount = static_cast<uint32_t>(state.Batches.size()) + (state.SceneMeshCount > 0 ? 1 : 0);
+
+				if (!parallel)
+				{
+					if (drawCount > 0)
+						RecordDraws(context.CommandBuffer, 0, drawCount, uniformOffset, state);
+
+					return;
+				}
+
+				// Draws are recorded into secondaries on the recorder's workers, the primary only executes them
+				const vk::CommandBufferInheritanceInfo inheritance(
+					context.RenderPass,
+					0,
+					context.Framebuffer);
+
+				this->Recorder->Record(context.CommandBuffer, *this->FrameCommands, this->CurrentFrame, inheritance, drawCount,
+					[this, uniformOffset, &state](vk::CommandBuffer secondary, uint32_t first, uint32_t count)
+					{
+						RecordDraws(secondary, first, count, uniformOffset, state);
+					});
+			});
+
+		this->Graph->Compile();
+		this->Graph->Execute(commandBuffer);
+	}
 
-		constexpr std::array<float, 4> color = { 0.0f, 0.0f, 0.0f, 1.0f };
+	Renderer::FrameDrawState Renderer::GetDrawState(uint32_t uniformOffset)
+	{
+		auto& uploader = this->DeviceContext->Uploader;
 
-		vk::ClearValue clearColor{};
-		clearColor.color = vk::ClearColorValue(color);
+		FrameDrawState state{};
+		state.UniformOffset = uniformOffset - this->Uniforms->GetSegmentStart();
 
-		vk::RenderPassBeginInfo renderPassInfo(
-			this->RenderPass,
-			this->Swapchain.SwapChainFramebuffers[imageIndex],
-			vk::Rect2D{ {0, 0}, this->Swapchain.SwapChainExtent },
-			1, &clearColor
-		);
+		// The scene, one quad for now
+		const auto textureIndex = GetTextureIndex();
+		if (this->GPU_CULLING)
+			this->Scene->UpdateObject(this->QuadObject, textureIndex, this->QuadTransform);
+		else
+			this->Instances->Submit(this->QuadMesh, textureIndex, this->QuadTransform);
 
-		commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+		this->Instances->Build(this->CurrentFrame, static_cast<uint32_t>(this->Meshes.size()), this->Batches);
 
+		// Textures fall back to the placeholder, so nothing can be drawn before it's landed
+		if (!uploader->IsResident(this->Placeholder->Ticket))
+			return state;
+
+		if (this->GPU_CULLING && uploader->IsResident(this->Scene->Vertices->Ticket) && uploader->IsResident(this->Scene->Indices->Ticket))
+		{
+			state.SceneVertexBuffer = this->Scene->Vertices->Buffer;
+			state.SceneIndexBuffer = this->Scene->Indices->Buffer;
+			state.SceneMeshCount = this->Scene->GetMeshCount();
+		}
+
+		for (const auto& batch : this->Batches)
+		{
+			const auto& mesh = this->Meshes[batch.Mesh];
+
+			// Assets stream in on the transfer queue, skip the mesh until it's landed
+			if (!uploader->IsResident(mesh.Vertices->Ticket) || !uploader->IsResident(mesh.Indices->Ticket))
+				continue;
+
+			DrawBatch draw{};
+			draw.VertexBuffer = mesh.Vertices->Buffer;
+			draw.IndexBuffer = mesh.Indices->Buffer;
+			draw.IndexCount = static_cast<uint32_t>(mesh.Indices->Objects.size());
+			draw.FirstInstance = batch.FirstInstance;
+			draw.InstanceCount = batch.InstanceCount;
+
+			state.Batches.push_back(draw);
+		}
+
+		return state;
+	}
+
+	bool Renderer::UpdateSceneRevision(const FrameDrawState& state)
+	{
+		if (state == this->RecordedDrawState && this->Graph->GetRevision() == this->RecordedGraphRevision)
+			return false;
+
+		// Anything the recorded frames baked in changed, so every one of them is stale
+		this->RecordedDrawState = state;
+		this->RecordedGraphRevision = this->Graph->GetRevision();
+		this->SceneRevision++;
+
+		return true;
+	}
+
+	vk::CommandBuffer Renderer::GetCachedFrame(uint32_t imageIndex, uint32_t uniformOffset, const FrameDrawState& state)
+	{
+		this->FrameCache->Reserve(static_cast<uint32_t>(this->Swapchain.SwapChainImages.size()));
+
+		// Recorded inline, the secondaries from the frame pools wouldn't outlive the frame. A static
+		// frame only pays for it once per image and frame slot.
+		return this->FrameCache->Get(imageIndex, this->CurrentFrame, this->SceneRevision,
+			[this, imageIndex, uniformOffset, &state](vk::CommandBuffer commandBuffer)
+			{
+				RecordRenderPass(commandBuffer, imageIndex, uniformOffset, state, false);
+			});
+	}
+
+	void Renderer::RecordDraws(vk::CommandBuffer commandBuffer, uint32_t first, uint32_t count, uint32_t uniformOffset, const FrameDrawState& state)
+	{
 		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, this->GraphicsPipeline);
 
 		// Viewport
@@ -239,76 +381,156 @@ namespace Engine
 			this->Swapchain.SwapChainExtent);
 		commandBuffer.setScissor(0, 1, &scissor);
 
-		const std::array<vk::Buffer, 1> vertexBuffers = { this->vertexBuffer->Buffer };
-		constexpr std::array<vk::DeviceSize, 1> offsets = { 0 };
+		// Instances are bound once at this frame's segment, the batches index into it with firstInstance
+		const auto instanceOffset = this->Instances->GetSegmentOffset(this->CurrentFrame);
+		commandBuffer.bindVertexBuffers(1, 1, &this->Instances->InstanceBuffer, &instanceOffset);
 
-		commandBuffer.bindVertexBuffers(0, 1, vertexBuffers.data(), offsets.data());
-		commandBuffer.bindIndexBuffer(this->indexBuffer->Buffer, 0, Index::IndexType);
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, this->PipelineLayout, 0, 1, &this->DescriptorPool->DescriptorSets[this->CurrentFrame], 1, &uniformOffset);
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, this->PipelineLayout, 1, 1, &this->Bindless->DescriptorSet, 0, nullptr);
 
-		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, this->PipelineLayout, 0, 1, &this->DescriptorPool->DescriptorSets[this->CurrentFrame], 0, nullptr);
-		commandBuffer.drawIndexed(this->indexBuffer->Objects.size(), 1, 0, 0, 0);
+		constexpr vk::DeviceSize vertexOffset = 0;
 
-		commandBuffer.endRenderPass();
-		commandBuffer.end();
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			if (i == state.Batches.size())
+			{
+				this->Scene->RecordDraws(commandBuffer, this->CurrentFrame);
+				continue;
+			}
+
+			const auto& batch = state.Batches[i];
+
+			commandBuffer.bindVertexBuffers(0, 1, &batch.VertexBuffer, &vertexOffset);
+			commandBuffer.bindIndexBuffer(batch.IndexBuffer, 0, Index::IndexType);
+
+			commandBuffer.drawIndexed(batch.IndexCount, batch.InstanceCount, 0, 0, batch.FirstInstance);
+		}
+	}
+
+	uint32_t Renderer::AddMesh(const std::vector<Vertex>& vertices, const std::vector<Index>& indices)
+	{
+		Mesh mesh{};
+		mesh.Vertices = std::make_unique<VertexInputBuffer<Vertex>>(this->DeviceContext, vertices);
+		mesh.Indices = std::make_unique<VertexInputBuffer<Index>>(this->DeviceContext, indices);
+
+		this->Defrag->Register(*mesh.Vertices);
+		this->Defrag->Register(*mesh.Indices);
+
+		this->Meshes.push_back(std::move(mesh));
+
+		return static_cast<uint32_t>(this->Meshes.size() - 1);
 	}
 
 	void Renderer::CreateSyncObjects()
 	{
-		this->ImageAvailableSemaphores.reserve(this->MAX_FRAMES_IN_FLIGHT);
-		this->RenderFinishedSemaphores.reserve(this->MAX_FRAMES_IN_FLIGHT);
-		this->InFlightFences.reserve(this->MAX_FRAMES_IN_FLIGHT);
+		this->ImageAvailableSemaphores.reserve(this->Pacing.FramesInFlight);
+		this->RenderFinishedSemaphores.reserve(this->Pacing.FramesInFlight);
+
+		// Nothing submitted yet, the frame timeline starts at 0
+		this->SlotFrameValues.assign(this->Pacing.FramesInFlight, 0);
 		
 		vk::SemaphoreCreateInfo semaphoreInfo{};
-		vk::FenceCreateInfo fenceInfo(vk::FenceCreateFlagBits::eSignaled);
 
-		for (size_t i = 0; i < this->MAX_FRAMES_IN_FLIGHT; i++)
+		for (size_t i = 0; i < this->Pacing.FramesInFlight; i++)
 		{
 			this->ImageAvailableSemaphores.push_back(this->DeviceContext->LogicalDevice.createSemaphore(semaphoreInfo));
 			this->RenderFinishedSemaphores.push_back(this->DeviceContext->LogicalDevice.createSemaphore(semaphoreInfo));
-			this->InFlightFences.push_back(this->DeviceContext->LogicalDevice.createFence(fenceInfo));
 		}
 	}
 
 	void Renderer::InitializeVulkan()
 	{
+		if (this->Pacing.FramesInFlight < 1 || this->Pacing.FramesInFlight > MaxFramesInFlight)
+			throw std::invalid_argument("Frames in flight has to be between 1 and " + std::to_string(MaxFramesInFlight) + ".");
+
 		this->DeviceContext = std::make_shared<VulkanDeviceContext>(this->Window, this->ValidationLayersEnabled);
 
-		this->Swapchain = SwapChain(this->DeviceContext, this->Window);
+		this->Swapchain = SwapChain(this->DeviceContext, this->Window, this->Pacing.PresentMode);
+		this->Latency = std::make_unique<LatencyTracker>(this->Pacing.LatencyReportPath);
 
 		this->Swapchain.CreateSwapChain();
 		this->Swapchain.CreateImageViews();
 
 		CreateRenderPass();
 
-		for (size_t i = 0; i < this->MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			Uniform<UniformBufferObject> uniform(*this->DeviceContext->MemManager);
-			this->Uniforms.push_back(uniform);
-		}
+		this->Uniforms = std::make_unique<UniformRing<UniformBufferObject>>(this->DeviceContext, this->Pacing.FramesInFlight, this->MAX_OBJECTS_PER_FRAME);
+
+		// Decodes in the background, uploads are picked up in DrawFrame
+		this->DeviceContext->Textures->SetBudget(this->TEXTURE_CACHE_BUDGET);
+
+		// Starts at its coarse mips, finer ones stream in as it gets bigger on screen
+		this->Streamer = std::make_unique<TextureStreamer>(this->DeviceContext, this->TEXTURE_STREAMING_BUDGET);
+		this->Texture = this->Streamer->Load("textures/queen.jpg");
+
+		// 2x2 grey checker
+		constexpr std::array<uint8_t, 16> placeholderPixels = {
+			0x80, 0x80, 0x80, 0xFF,  0x40, 0x40, 0x40, 0xFF,
+			0x40, 0x40, 0x40, 0xFF,  0x80, 0x80, 0x80, 0xFF
+		};
+		this->Placeholder = std::make_shared<Image>(this->DeviceContext, placeholderPixels.data(), 2, 2);
 
-		this->Texture = std::make_unique<Image>(this->DeviceContext, "textures/queen.jpg");
+		// Every texture uses the same sampler, so it goes in the layout and never gets written
+		const auto sampler = this->DeviceContext->Samplers->Get(Image::GetSamplerInfo(*this->DeviceContext));
+		this->Bindless = std::make_unique<BindlessTextureTable>(this->DeviceContext, sampler);
+		this->PlaceholderSlot = this->Bindless->Add(*this->Placeholder);
 
-		this->DescriptorPool = std::make_unique<VulkanDescriptorPool>(this->DeviceContext, this->MAX_FRAMES_IN_FLIGHT);
-		this->DescriptorPool->CreateDescriptorSets(this->Uniforms, *this->Texture);
+		this->DescriptorPool = std::make_unique<VulkanDescriptorPool>(this->DeviceContext, this->Pacing.FramesInFlight);
+		this->DescriptorPool->CreateDescriptorSets(*this->Uniforms);
 
 		CreateGraphicsPipeline();
-		
-		this->Swapchain.CreateFramebuffers(this->RenderPass);
 
-		const std::vector<Vertex> vertices = {
+		this->Graph = std::make_unique<RenderGraph>(this->DeviceContext);
+
+		// Meshes register themselves with it
+		this->Defrag = std::make_unique<Defragmenter>(this->DeviceContext, this->Pacing.FramesInFlight);
+		this->Instances = std::make_unique<InstanceBatcher>(this->DeviceContext, this->Pacing.FramesInFlight, this->MAX_INSTANCES_PER_FRAME);
+
+		if (this->GPU_CULLING)
+		{
+			this->Scene = std::make_unique<GpuScene>(
+				this->DeviceContext,
+				this->Pacing.FramesInFlight,
+				this->MAX_GPU_OBJECTS,
+				this->MAX_GPU_MESHES,
+				this->MAX_GPU_OBJECT_UPDATES_PER_FRAME);
+		}
+
+		this->QuadVertices = {
 			{{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
 			{{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
 			{{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}},
 			{{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f}}
 		};
-		this->vertexBuffer = std::make_unique<VertexInputBuffer<Vertex>>(this->DeviceContext, vertices);
 
 		const std::vector<Index> indices = {
 			0, 1, 2, 2, 3, 0
 		};
-		this->indexBuffer = std::make_unique<VertexInputBuffer<Index>>(this->DeviceContext, indices);
+		if (this->GPU_CULLING)
+		{
+			const auto quad = this->Scene->AddMesh(this->QuadVertices, indices);
+			this->Scene->Commit();
+
+			this->Defrag->Register(*this->Scene->Vertices);
+			this->Defrag->Register(*this->Scene->Indices);
+
+			this->QuadObject = this->Scene->AddObject(quad, this->PlaceholderSlot, this->QuadTransform);
+		}
+		else
+		{
+			this->QuadMesh = AddMesh(this->QuadVertices, indices);
+		}
 
-		CreateCommandBuffer();
+		// Everything loaded above goes to the transfer queue as one submit
+		this->DeviceContext->Uploader->Flush();
+
+		// Nothing to patch, GetTextureIndex moves them to a new bindless slot when their view changes
+		this->Defrag->Register(this->Texture, nullptr);
+		this->Defrag->Register(this->Placeholder, nullptr);
+
+		// Pools for whatever gets recorded each frame, a slot per recording thread
+		this->Recorder = std::make_unique<ParallelCommandRecorder>();
+		this->FrameCommands = std::make_unique<FrameCommandPools>(this->DeviceContext, this->Pacing.FramesInFlight, this->Recorder->GetSlotCount());
+		this->FrameCache = std::make_unique<CommandBufferCache>(this->DeviceContext, this->Pacing.FramesInFlight, static_cast<uint32_t>(this->Swapchain.SwapChainImages.size()));
 
 		CreateSyncObjects();
 	}
@@ -316,26 +538,57 @@ namespace Engine
 	void Renderer::Cleanup()
 	{
 		// Sync shit
-		for (size_t i = 0; i < this->MAX_FRAMES_IN_FLIGHT; i++)
+		for (size_t i = 0; i < this->Pacing.FramesInFlight; i++)
 		{
 			this->DeviceContext->LogicalDevice.destroySemaphore(this->ImageAvailableSemaphores[i]);
 			this->DeviceContext->LogicalDevice.destroySemaphore(this->RenderFinishedSemaphores[i]);
-			this->DeviceContext->LogicalDevice.destroyFence(this->InFlightFences[i]);
 		}
 
+		this->FrameCommands->Destroy();
+		this->FrameCache->Destroy();
+
 		this->Swapchain.Destroy();
+		this->Graph->Destroy();
 
-		this->vertexBuffer->Destroy();
-		this->indexBuffer->Destroy();
+		for (auto& mesh : this->Meshes)
+		{
+			this->Defrag->Unregister(*mesh.Vertices);
+			this->Defrag->Unregister(*mesh.Indices);
 
-		for (auto& uniform : this->Uniforms)
+			mesh.Vertices->Destroy();
+			mesh.Indices->Destroy();
+		}
+
+		this->Instances->Destroy();
+
+		if (this->Scene)
 		{
-			uniform.Destroy(*this->DeviceContext->MemManager);
+			if (this->Scene->Vertices)
+			{
+				this->Defrag->Unregister(*this->Scene->Vertices);
+				this->Defrag->Unregister(*this->Scene->Indices);
+			}
+
+			this->Scene->Destroy();
 		}
+
+		this->Uniforms->Destroy();
 		
 		this->DescriptorPool->Destroy();
+		this->Bindless->Destroy();
 
-		this->Texture->Destroy();
+		// The streamer owns the texture, and the cache holds the device context until it's emptied
+		this->Defrag->Unregister(*this->Texture);
+		this->Defrag->Unregister(*this->Placeholder);
+		this->Texture.reset();
+		this->Streamer->Destroy();
+		this->DeviceContext->Textures->Destroy();
+		this->Placeholder->Destroy();
+
+		this->Defrag->Destroy();
+
+		// The device is idle, everything queued above can go now
+		this->DeviceContext->Deletion->Flush();
 
 		// Pipeline shit
 		this->DeviceContext->LogicalDevice.destroyPipeline(this->GraphicsPipeline);
@@ -354,14 +607,87 @@ namespace Engine
 	{
 		while (!glfwWindowShouldClose(this->Window))
 		{
+			// Input sampled after this is as fresh as it can be by the time the frame is shown
+			if (this->Pacing.LowLatency)
+				WaitForPreviousFrame();
+
 			glfwPollEvents();
+			this->Latency->InputSampled();
+
 			DrawFrame();
+			CollectPresented();
+
+			const auto now = std::chrono::steady_clock::now();
+			if (now - this->LastMemoryReport >= this->MEMORY_REPORT_INTERVAL)
+			{
+				DumpMemoryReport();
+				this->LastMemoryReport = now;
+			}
 		}
 
 		this->DeviceContext->LogicalDevice.waitIdle();
 	}
 	
-	void Renderer::UpdateUniformWithNewData(Uniform<UniformBufferObject> Uniform)
+	void Renderer::WaitForPreviousFrame()
+	{
+		if (this->DeviceContext->PresentWaitSupported && this->PresentId != 0 && this->Swapchain.Generation == this->PresentGeneration)
+		{
+			// Bounded, a minimized window might never present it
+			const auto result = this->DeviceContext->WaitForPresent(
+				this->DeviceContext->LogicalDevice,
+				this->Swapchain.Swapchain,
+				this->PresentId,
+				this->PRESENT_WAIT_TIMEOUT_NS);
+
+			if (result == VK_SUCCESS)
+				this->Latency->Presented(this->PresentId);
+
+			return;
+		}
+
+		// No present wait, the GPU being done with it is as close as we get
+		this->DeviceContext->Frames->Wait(this->DeviceContext->Frames->GetSubmittedValue());
+	}
+
+	void Renderer::CollectPresented()
+	{
+		if (!this->DeviceContext->PresentWaitSupported)
+			return;
+
+		// The ids went to a swap chain that's gone now
+		if (this->Swapchain.Generation != this->PresentGeneration)
+		{
+			this->Latency->Drop();
+			return;
+		}
+
+		// Frames reach the screen in order, so stop at the first one that hasn't
+		for (auto id = this->Latency->GetOldestPending(); id != 0; id = this->Latency->GetOldestPending())
+		{
+			if (this->DeviceContext->WaitForPresent(this->DeviceContext->LogicalDevice, this->Swapchain.Swapchain, id, 0) != VK_SUCCESS)
+				break;
+
+			this->Latency->Presented(id);
+		}
+	}
+
+	void Renderer::DumpMemoryReport()
+	{
+		MemoryReport report;
+		this->DeviceContext->MemManager->GetReport(report);
+
+		const auto& decodeStaging = this->DeviceContext->Uploader->GetDecodeStaging();
+		report.StagedDecodes = decodeStaging.GetStagedDecodes();
+		report.HeapDecodes = decodeStaging.GetHeapDecodes();
+
+		std::ofstream file(this->MEMORY_REPORT_PATH, std::ios::trunc);
+		if (!file.is_open())
+			return;
+
+		WriteMemoryReportJson(report, file);
+	}
+	
+	void Renderer::UpdateUniformWithNewData(uint32_t& uniformOffset)
 	{
 		static auto startTime = std::chrono::high_resolution_clock::now();
 
@@ -369,7 +695,7 @@ namespace Engine
 		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
 		UniformBufferObject ubo{};
-		ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		this->QuadTransform = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
 		ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
@@ -380,13 +706,61 @@ namespace Engine
 
 		ubo.proj[1][1] *= -1;
 
-		Uniform.UpdateUniformBuffer(*this->DeviceContext->MemManager, ubo);
+		this->ViewProjection = ubo.proj * ubo.view;
+
+		uniformOffset = this->Uniforms->Push(ubo);
+
+		// The quad's UVs cover the texture once, so pixels on screen is texels wanted
+		this->Streamer->SetDemand(*this->Texture, GetScreenSize(ubo, this->QuadTransform));
+	}
+
+	float Renderer::GetScreenSize(const UniformBufferObject& ubo, const glm::mat4& model) const
+	{
+		const auto mvp = ubo.proj * ubo.view * model;
+
+		glm::vec2 min(std::numeric_limits<float>::max());
+		glm::vec2 max(std::numeric_limits<float>::lowest());
+
+		for (const auto& vertex : this->QuadVertices)
+		{
+			const auto clip = mvp * glm::vec4(vertex.pos, 1.0f);
+
+			// Crosses the near plane, treat it as filling the screen
+			if (clip.w <= 0.0f)
+				return static_cast<float>(std::max(this->Swapchain.SwapChainExtent.width, this->Swapchain.SwapChainExtent.height));
+
+			const auto ndc = glm::vec2(clip) / clip.w;
+			min = glm::min(min, ndc);
+			max = glm::max(max, ndc);
+		}
+
+		const auto size = (max - min) * 0.5f * glm::vec2(this->Swapchain.SwapChainExtent.width, this->Swapchain.SwapChainExtent.height);
+
+		return std::max(size.x, size.y);
+	}
+
+	uint32_t Renderer::GetTextureIndex()
+	{
+		this->PlaceholderSlot = this->Bindless->Refresh(this->PlaceholderSlot, *this->Placeholder);
+
+		// Only resident textures get a slot, so nothing can sample one that's still uploading
+		if (!this->DeviceContext->Uploader->IsResident(this->Texture->Ticket))
+			return this->PlaceholderSlot;
+
+		this->TextureSlot = this->TextureSlot == InvalidBindlessSlot
+			? this->Bindless->Add(*this->Texture)
+			: this->Bindless->Refresh(this->TextureSlot, *this->Texture);
+
+		return this->TextureSlot;
 	}
 
 	void Renderer::DrawFrame()
 	{
-		// Wait for previous frame to finish processing
-		vk::resultCheck(this->DeviceContext->LogicalDevice.waitForFences(1, &this->InFlightFences[this->CurrentFrame], VK_TRUE, UINT64_MAX), "Fence dumb shit");
+		// Wait for the last frame submitted from this slot to finish processing
+		this->DeviceContext->Frames->Wait(this->SlotFrameValues[this->CurrentFrame]);
+
+		// Free whatever was waiting on frames that have finished
+		this->DeviceContext->Deletion->Collect();
 
 		
 		uint32_t imageIndex = 0;
@@ -402,32 +776,67 @@ namespace Engine
 		// If the swap chain is out of date (resized, etc.), we need to recreate it
 		catch (vk::OutOfDateKHRError&)
 		{
-			this->Swapchain.RecreateSwapChain(this->RenderPass);
+			this->Swapchain.RecreateSwapChain();
+			this->Graph->Invalidate();
 			return;
 		}
-		
-		// Reset fence when we know we are operating on a frame.
-		vk::resultCheck(this->DeviceContext->LogicalDevice.resetFences(1, &this->InFlightFences[this->CurrentFrame]), "Fence dumb shit");
 
-		this->CommandBuffers[this->CurrentFrame].reset();
-
-		RecordCommandBuffer(this->CommandBuffers[this->CurrentFrame], imageIndex);
+		// Update shader uniforms. The timeline wait above guarantees the GPU is done with this frame's segment.
+		uint32_t uniformOffset = 0;
+		this->Uniforms->BeginFrame(this->CurrentFrame);
+		UpdateUniformWithNewData(uniformOffset);
+
+		// Queue uploads for textures that finished decoding and for streamed mips, then kick off
+		// everything queued since last frame
+		this->DeviceContext->Textures->Pump();
+		this->Streamer->Update();
+		this->DeviceContext->Uploader->Flush();
+
+		// Everything recorded for this slot last time has finished, its pools go back in one reset
+		this->FrameCommands->BeginFrame(this->CurrentFrame);
+
+		auto commandBuffer = this->FrameCommands->Allocate(this->CurrentFrame, 0);
+		FrameDrawState state;
+		const bool recordedPass = RecordCommandBuffer(commandBuffer, imageIndex, uniformOffset, state);
+
+		// Per frame work first, then the pass, which is usually replayed as is
+		std::vector<vk::CommandBuffer> commandBuffers = { commandBuffer };
+		if (!recordedPass)
+			commandBuffers.push_back(GetCachedFrame(imageIndex, uniformOffset, state));
+
+		// The upload timeline wait orders this frame after the transfers it acquired.
+		// Those are already finished, so it never actually stalls.
+		const std::array<vk::Semaphore, 2> waitSemaphores = { 
+			this->ImageAvailableSemaphores[this->CurrentFrame],
+			this->DeviceContext->Uploader->GetTimeline() };
+		// The frame timeline is what CPU side waits go through, the binary one is for present
+		const auto frameValue = this->DeviceContext->Frames->GetNextValue();
+		const std::array<vk::Semaphore, 2> signalSemaphores = {
+			this->RenderFinishedSemaphores[this->CurrentFrame],
+			this->DeviceContext->Frames->Semaphore };
+		constexpr std::array<vk::PipelineStageFlags, 2> waitStages = { 
+			vk::PipelineStageFlagBits::eColorAttachmentOutput,
+			vk::PipelineStageFlagBits::eAllCommands };
 
-		const std::array<vk::Semaphore, 1> waitSemaphores = { this->ImageAvailableSemaphores[this->CurrentFrame] };
-		const std::array<vk::Semaphore, 1> signalSemaphores = { this->RenderFinishedSemaphores[this->CurrentFrame] };
-		constexpr std::array<vk::PipelineStageFlags, 1> waitStages = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
+		// Binary semaphores ignore their value
+		const std::array<uint64_t, 2> waitValues = { 0, this->DeviceContext->Uploader->GetAcquiredValue() };
+		const std::array<uint64_t, 2> signalValues = { 0, frameValue };
 
-		// Update shader uniforms
-		UpdateUniformWithNewData(this->Uniforms[this->CurrentFrame]);
+		vk::TimelineSemaphoreSubmitInfo timelineInfo(
+			waitValues.size(), waitValues.data(),
+			signalValues.size(), signalValues.data());
 
 		vk::SubmitInfo submitInfo(
-			1, waitSemaphores.data(), waitStages.data(),
-			1, &this->CommandBuffers[this->CurrentFrame],
-			1, signalSemaphores.data());
+			waitSemaphores.size(), waitSemaphores.data(), waitStages.data(),
+			static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data(),
+			signalSemaphores.size(), signalSemaphores.data());
+		submitInfo.pNext = &timelineInfo;
 
-		vk::resultCheck(this->DeviceContext->Queues.GraphicsQueue.submit(1, &submitInfo, this->InFlightFences[this->CurrentFrame]),
+		vk::resultCheck(this->DeviceContext->Queues.GraphicsQueue.submit(1, &submitInfo, VK_NULL_HANDLE),
 			"Failed to submit command buffer.");
 
+		this->SlotFrameValues[this->CurrentFrame] = this->DeviceContext->Frames->FrameSubmitted();
+
 		const std::array<vk::SwapchainKHR, 1> swapChains = { this->Swapchain.Swapchain };
 
 		vk::PresentInfoKHR presentInfo(
@@ -435,21 +844,32 @@ namespace Engine
 			1, swapChains.data(),
 			&imageIndex);
 
+		// Lets the frame pacing wait for this frame to actually be on screen
+		const auto presentId = ++this->PresentId;
+		const vk::PresentIdKHR presentIdInfo(1, &presentId);
+		if (this->DeviceContext->PresentWaitSupported)
+			presentInfo.pNext = &presentIdInfo;
+
+		this->PresentGeneration = this->Swapchain.Generation;
+
 		// Present swap chain
 		try
 		{
 			auto presentResult = this->DeviceContext->Queues.PresentationQueue.presentKHR(presentInfo);
 
+			this->Latency->Queued(presentId, this->DeviceContext->PresentWaitSupported);
+
 			// vulkan-hpp specifies eSuboptimalKHR as success, but whatever
 			if (presentResult == vk::Result::eSuboptimalKHR)
 				throw vk::OutOfDateKHRError("");
 		}
 		catch (vk::OutOfDateKHRError&)
 		{
-			this->Swapchain.RecreateSwapChain(this->RenderPass);
+			this->Swapchain.RecreateSwapChain();
+			this->Graph->Invalidate();
 		};
 
 		// Increment current frame so we can work on the next frame
-		this->CurrentFrame = (this->CurrentFrame + 1) % this->MAX_FRAMES_IN_FLIGHT;
+		this->CurrentFrame = (this->CurrentFrame + 1) % this->Pacing.FramesInFlight;
 	}
 }
\ No newline at end of file
@@ -25,6 +25,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <chrono>
+#include <fstream>
 
 #include "files.h"
 
@@ -35,12 +36,21 @@
 #include "renderer/vulkanmem.h"
 #include "renderer/uniform.h"
 #include "renderer/image.h"
+#include "renderer/defrag.h"
+#include "renderer/texturecache.h"
+#include "renderer/bindless.h"
+#include "renderer/streaming.h"
+#include "renderer/commandrecorder.h"
+#include "renderer/framepacing.h"
+#include "renderer/rendergraph.h"
+#include "renderer/instancing.h"
+#include "renderer/gpuscene.h"
 
 namespace Engine
 {
+	// Per frame, the model matrix comes in with each instance
 	struct UniformBufferObject
 	{
-		glm::mat4 model;
 		glm::mat4 view;
 		glm::mat4 proj;
 	};
@@ -48,9 +58,71 @@ namespace Engine
 	class Renderer
 	{
 	private:
+		struct Mesh
+		{
+			std::unique_ptr<VertexInputBuffer<Vertex>> Vertices;
+			std::unique_ptr<VertexInputBuffer<Index>> Indices;
+		};
+
+		// One instanced draw, an InstanceBatch with its mesh's buffers looked up
+		struct DrawBatch
+		{
+			vk::Buffer VertexBuffer;
+			vk::Buffer IndexBuffer;
+			uint32_t IndexCount = 0;
+			uint32_t FirstInstance = 0;
+			uint32_t InstanceCount = 0;
+
+			bool operator==(const DrawBatch&) const = default;
+		};
+
+		// What a frame's draws are recorded from, a cached frame is stale once this changes.
+		// Instance data isn't part of it, it's rewritten every frame in the same place.
+		struct FrameDrawState
+		{
+			std::vector<DrawBatch> Batches;
+
+			// GPU culled scene, drawn indirectly after the batches if it has meshes
+			vk::Buffer SceneVertexBuffer;
+			vk::Buffer SceneIndexBuffer;
+			uint32_t SceneMeshCount = 0;
+
+			// Relative to the frame's uniform segment, so it's the same in every frame slot
+			vk::DeviceSize UniformOffset = 0;
+
+			bool operator==(const FrameDrawState&) const = default;
+		};
+
 		GLFWwindow* Window;
 
-		const int MAX_FRAMES_IN_FLIGHT = 2;
+		// Frames in flight, present mode and latency mode
+		FramePacing Pacing;
+
+		// Low latency mode gives up on a present after this long, e.g. while minimized
+		const uint64_t PRESENT_WAIT_TIMEOUT_NS = 100'000'000;
+
+		// Uniform ring budget, in objects per frame in flight
+		const int MAX_OBJECTS_PER_FRAME = 4096;
+
+		// Instance buffer budget, per frame in flight
+		const uint32_t MAX_INSTANCES_PER_FRAME = 131072;
+
+		// Scene objects are culled and drawn from the GPU instead of batched on the CPU
+		const bool GPU_CULLING = true;
+		const uint32_t MAX_GPU_OBJECTS = 262144;
+		const uint32_t MAX_GPU_MESHES = 256;
+		const uint32_t MAX_GPU_OBJECT_UPDATES_PER_FRAME = 16384;
+
+		// Memory report is rewritten this often while the render loop runs
+		const std::chrono::seconds MEMORY_REPORT_INTERVAL = std::chrono::seconds(5);
+		const char* MEMORY_REPORT_PATH = "memory_report.json";
+
+		// Unreferenced cached textures are evicted past this
+		const vk::DeviceSize TEXTURE_CACHE_BUDGET = 256ull * 1024 * 1024;
+
+		// Streamed textures drop their finest mips past this
+		const vk::DeviceSize TEXTURE_STREAMING_BUDGET = 256ull * 1024 * 1024;
+		std::chrono::steady_clock::time_point LastMemoryReport;
 
 		bool ValidationLayersEnabled;
 
@@ -60,29 +132,83 @@ namespace Engine
 		// Pipeline shit
 		vk::Pipeline GraphicsPipeline;
 		vk::PipelineLayout PipelineLayout;
+
+		// Only for creating pipelines, the graph's render passes are compatible with it
 		vk::RenderPass RenderPass;
 
+		// Rebuilt every time a frame is recorded, works out the barriers and framebuffers
+		std::unique_ptr<RenderGraph> Graph;
+
 		// Swap chain shit
 		SwapChain Swapchain;
 
 		// Command shit
-		std::vector<vk::CommandBuffer> CommandBuffers;
+		// Per frame in flight and per recording thread, reset in bulk once the frame has finished
+		std::unique_ptr<FrameCommandPools> FrameCommands;
+
+		// Draws are recorded in parallel into secondaries
+		std::unique_ptr<ParallelCommandRecorder> Recorder;
+
+		// Static frames replay a pass recorded once per swapchain image and frame slot. It's
+		// re-recorded when the scene revision moves, which happens whenever the draw state or the
+		// graph's cached objects change. A frame that moved the revision is recorded in parallel
+		// with the per frame work instead, the cache only picks the pass up (recorded inline) once
+		// it has held still for a frame. Turned off, every frame is recorded in parallel.
+		const bool CACHE_STATIC_FRAMES = true;
+		std::unique_ptr<CommandBufferCache> FrameCache;
+		FrameDrawState RecordedDrawState;
+		uint64_t RecordedGraphRevision = 0;
+		uint64_t SceneRevision = 0;
 		
 
 		// Synch shit
 		std::vector<vk::Semaphore> ImageAvailableSemaphores;
 		std::vector<vk::Semaphore> RenderFinishedSemaphores;
-		std::vector<vk::Fence> InFlightFences;
+
+		// Frame timeline value each slot last submitted, waiting on it frees the slot
+		std::vector<uint64_t> SlotFrameValues;
 		uint32_t CurrentFrame = 0;
 
+		// Input to present latency, ids are only handed to the driver with present wait
+		std::unique_ptr<LatencyTracker> Latency;
+		uint64_t PresentId = 0;
+		uint64_t PresentGeneration = 0;
+
+		// Indexed by mesh id
+		std::vector<Mesh> Meshes;
+
+		// Instances are grouped per mesh, every mesh is drawn with one instanced draw
+		std::unique_ptr<InstanceBatcher> Instances;
+		std::vector<InstanceBatch> Batches;
+
+		// Objects that only cost CPU time when they change, culled on the GPU
+		std::unique_ptr<GpuScene> Scene;
+
+		// This frame's camera, for culling
+		glm::mat4 ViewProjection = glm::mat4(1.0f);
+
 		// TEMP
-		std::unique_ptr<VertexInputBuffer<Vertex>> vertexBuffer;
-		std::unique_ptr<VertexInputBuffer<Index>> indexBuffer;
-		std::unique_ptr<Image> Texture;
+		std::vector<Vertex> QuadVertices;
+		uint32_t QuadMesh = 0;
+		uint32_t QuadObject = 0;
+		glm::mat4 QuadTransform = glm::mat4(1.0f);
+		std::shared_ptr<Image> Texture;
+
+		// Textures decode on worker threads, the placeholder is drawn until they're resident
+		std::shared_ptr<Image> Placeholder;
+		std::unique_ptr<TextureStreamer> Streamer;
+
+		// Every texture is bound through this, instances pick theirs by slot
+		std::unique_ptr<BindlessTextureTable> Bindless;
+		uint32_t TextureSlot = InvalidBindlessSlot;
+		uint32_t PlaceholderSlot = InvalidBindlessSlot;
 
 		// Uniform shit
 		std::unique_ptr<VulkanDescriptorPool> DescriptorPool;
-		std::vector<Uniform<UniformBufferObject>> Uniforms;
+		std::unique_ptr<UniformRing<UniformBufferObject>> Uniforms;
+
+		// Memory compaction
+		std::unique_ptr<Defragmenter> Defrag;
 
 		void InitializeWindow();
 		void InitializeVulkan();
@@ -102,23 +228,56 @@ namespace Engine
 		void CreateShaderModule(const std::span<char, N> code, vk::ShaderModule& module);
 
 		// Command shit
-		void CreateCommandBuffer();
-		void CreateCommandPool();
-		void RecordCommandBuffer(vk::CommandBuffer& commandBuffer, uint32_t imageIndex);
+		// Per frame work, and the pass too unless it's a static frame. state is what the pass is drawn
+		// from. Returns false if the pass was left for GetCachedFrame.
+		bool RecordCommandBuffer(vk::CommandBuffer& commandBuffer, uint32_t imageIndex, uint32_t uniformOffset, FrameDrawState& state);
+
+		// Builds the frame's render graph and records it, draws go on the recorder's workers if parallel
+		void RecordRenderPass(vk::CommandBuffer commandBuffer, uint32_t imageIndex, uint32_t uniformOffset, const FrameDrawState& state, bool parallel);
+
+		// Call once per frame, after the defragmenter has moved things
+		FrameDrawState GetDrawState(uint32_t uniformOffset);
+
+		// Moves the scene revision if anything the recorded frames baked in changed, returns whether it did
+		bool UpdateSceneRevision(const FrameDrawState& state);
+
+		// This frame's pass, re-recorded only if the scene changed since it was last recorded
+		vk::CommandBuffer GetCachedFrame(uint32_t imageIndex, uint32_t uniformOffset, const FrameDrawState& state);
+
+		// Records batches [first, first + count). Runs on the recorder's workers, only reads renderer state
+		void RecordDraws(vk::CommandBuffer commandBuffer, uint32_t first, uint32_t count, uint32_t uniformOffset, const FrameDrawState& state);
+
+		// Uploaded on the transfer queue and registered with the defragmenter, returns the mesh id
+		uint32_t AddMesh(const std::vector<Vertex>& vertices, const std::vector<Index>& indices);
 
 		// Synch shit
 		void CreateSyncObjects();
 
-		void UpdateUniformWithNewData(Uniform<UniformBufferObject> Uniform);
+		void UpdateUniformWithNewData(uint32_t& uniformOffset);
+
+		// Pixels covered by the largest side of the quad's screen bounds, drives texture streaming
+		float GetScreenSize(const UniformBufferObject& ubo, const glm::mat4& model) const;
+
+		// Bindless slot of the texture, or of the placeholder while it streams in
+		uint32_t GetTextureIndex();
+
+		void DumpMemoryReport();
+
+		// Low latency mode, blocks until the last frame is on screen or at least done on the GPU
+		void WaitForPreviousFrame();
+
+		// Reports latency for frames present wait says are on screen, never blocks
+		void CollectPresented();
 
 	public:
 		uint16_t WindowWidth;
 		uint16_t WindowHeight;
 
-		constexpr Renderer(bool EnableValidationLayers = false, uint16_t Width = 800, uint16_t Height = 600) :
+		constexpr Renderer(bool EnableValidationLayers = false, uint16_t Width = 800, uint16_t Height = 600, FramePacing pacing = {}) :
 			WindowWidth(Width),
 			WindowHeight(Height),
 			Window(nullptr),
+			Pacing(pacing),
 			ValidationLayersEnabled(EnableValidationLayers) 
 		{}
 
@@ -0,0 +1,797 @@
+#include "renderer/rendergraph.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace Engine
+{
+	struct AccessInfo
+	{
+		vk::ImageLayout Layout;
+		vk::PipelineStageFlags Stages;
+		vk::AccessFlags Access;
+		vk::ImageUsageFlags Usage;
+		bool Write;
+		bool Attachment;
+	};
+
+	static AccessInfo GetAccessInfo(ImageAccess access, vk::PipelineStageFlags stages)
+	{
+		const auto depthStages = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+
+		switch (access)
+		{
+		case ImageAccess::ColorAttachment:
+			return {
+				vk::ImageLayout::eColorAttachmentOptimal,
+				vk::PipelineStageFlagBits::eColorAttachmentOutput,
+				vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
+				vk::ImageUsageFlagBits::eColorAttachment,
+				true, true };
+		case ImageAccess::DepthAttachment:
+			return {
+				vk::ImageLayout::eDepthStencilAttachmentOptimal,
+				depthStages,
+				vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+				vk::ImageUsageFlagBits::eDepthStencilAttachment,
+				true, true };
+		case ImageAccess::DepthRead:
+			return {
+				vk::ImageLayout::eDepthStencilReadOnlyOptimal,
+				depthStages,
+				vk::AccessFlagBits::eDepthStencilAttachmentRead,
+				vk::ImageUsageFlagBits::eDepthStencilAttachment,
+				false, true };
+		case ImageAccess::Sampled:
+			return {
+				vk::ImageLayout::eShaderReadOnlyOptimal,
+				stages,
+				vk::AccessFlagBits::eShaderRead,
+				vk::ImageUsageFlagBits::eSampled,
+				false, false };
+		case ImageAccess::TransferSrc:
+			return {
+				vk::ImageLayout::eTransferSrcOptimal,
+				vk::PipelineStageFlagBits::eTransfer,
+				vk::AccessFlagBits::eTransferRead,
+				vk::ImageUsageFlagBits::eTransferSrc,
+				false, false };
+		case ImageAccess::TransferDst:
+		default:
+			return {
+				vk::ImageLayout::eTransferDstOptimal,
+				vk::PipelineStageFlagBits::eTransfer,
+				vk::AccessFlagBits::eTransferWrite,
+				vk::ImageUsageFlagBits::eTransferDst,
+				true, false };
+		}
+	}
+
+	static bool HasStencil(vk::Format format)
+	{
+		return format == vk::Format::eS8Uint
+			|| format == vk::Format::eD16UnormS8Uint
+			|| format == vk::Format::eD24UnormS8Uint
+			|| format == vk::Format::eD32SfloatS8Uint;
+	}
+
+	static vk::ImageAspectFlags GetAspect(vk::Format format)
+	{
+		switch (format)
+		{
+		case vk::Format::eD16Unorm:
+		case vk::Format::eX8D24UnormPack32:
+		case vk::Format::eD32Sfloat:
+			return vk::ImageAspectFlagBits::eDepth;
+		case vk::Format::eS8Uint:
+			return vk::ImageAspectFlagBits::eStencil;
+		case vk::Format::eD16UnormS8Uint:
+		case vk::Format::eD24UnormS8Uint:
+		case vk::Format::eD32SfloatS8Uint:
+			return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+		default:
+			return vk::ImageAspectFlagBits::eColor;
+		}
+	}
+
+	template<typename T>
+	static uint64_t HandleKey(T handle)
+	{
+		return reinterpret_cast<uint64_t>(static_cast<typename T::CType>(handle));
+	}
+
+	RenderGraph::ImageResource& RenderGraph::GetResource(RenderResource resource)
+	{
+		if (resource >= this->Images.size())
+			throw std::invalid_argument("Render graph resource doesn't exist.");
+
+		return this->Images[resource];
+	}
+
+	void RenderGraph::PassBuilder::Use(RenderResource image, ImageAccess access, vk::PipelineStageFlags stages, std::optional<vk::ClearValue> clear)
+	{
+		auto& resource = this->Graph.GetResource(image);
+
+		for (const auto& existing : this->Target.Accesses)
+		{
+			if (existing.Resource == image)
+				throw std::invalid_argument("Render graph pass " + this->Target.Name + " uses " + resource.Name + " twice.");
+		}
+
+		resource.Usage |= GetAccessInfo(access, stages).Usage;
+
+		this->Target.Accesses.push_back({ image, access, stages, clear });
+	}
+
+	void RenderGraph::PassBuilder::WriteColor(RenderResource image, std::optional<vk::ClearColorValue> clear)
+	{
+		std::optional<vk::ClearValue> clearValue;
+		if (clear)
+			clearValue = vk::ClearValue(*clear);
+
+		Use(image, ImageAccess::ColorAttachment, {}, clearValue);
+	}
+
+	void RenderGraph::PassBuilder::WriteDepth(RenderResource image, std::optional<vk::ClearDepthStencilValue> clear)
+	{
+		std::optional<vk::ClearValue> clearValue;
+		if (clear)
+			clearValue = vk::ClearValue(*clear);
+
+		Use(image, ImageAccess::DepthAttachment, {}, clearValue);
+	}
+
+	void RenderGraph::PassBuilder::ReadDepth(RenderResource image)
+	{
+		Use(image, ImageAccess::DepthRead, {});
+	}
+
+	void RenderGraph::PassBuilder::ReadSampled(RenderResource image, vk::PipelineStageFlags stages)
+	{
+		Use(image, ImageAccess::Sampled, stages);
+	}
+
+	void RenderGraph::PassBuilder::ReadTransfer(RenderResource image)
+	{
+		Use(image, ImageAccess::TransferSrc, {});
+	}
+
+	void RenderGraph::PassBuilder::WriteTransfer(RenderResource image)
+	{
+		Use(image, ImageAccess::TransferDst, {});
+	}
+
+	void RenderGraph::PassBuilder::UseSecondaryCommandBuffers()
+	{
+		this->Target.Secondary = true;
+	}
+
+	void RenderGraph::PassBuilder::KeepAlive()
+	{
+		this->Target.KeepAlive = true;
+	}
+
+	RenderResource RenderGraph::ImportImage(
+		const char* name,
+		vk::Image image,
+		vk::ImageView view,
+		const RenderImageDesc& desc,
+		vk::ImageLayout initialLayout,
+		vk::ImageLayout finalLayout)
+	{
+		ImageResource resource{};
+		resource.Name = name;
+		resource.Desc = desc;
+		resource.Imported = true;
+		resource.Image = image;
+		resource.View = view;
+		resource.InitialLayout = initialLayout;
+		resource.FinalLayout = finalLayout;
+
+		this->Images.push_back(resource);
+		this->Compiled = false;
+
+		return static_cast<RenderResource>(this->Images.size() - 1);
+	}
+
+	RenderResource RenderGraph::CreateImage(const char* name, const RenderImageDesc& desc)
+	{
+		ImageResource resource{};
+		resource.Name = name;
+		resource.Desc = desc;
+
+		this->Images.push_back(resource);
+		this->Compiled = false;
+
+		return static_cast<RenderResource>(this->Images.size() - 1);
+	}
+
+	void RenderGraph::AddPass(const char* name, const std::function<void(PassBuilder&)>& setup, ExecuteFn execute)
+	{
+		Pass pass{};
+		pass.Name = name;
+		pass.Execute = std::move(execute);
+
+		PassBuilder builder(*this, pass);
+		setup(builder);
+
+		this->Passes.push_back(std::move(pass));
+		this->Compiled = false;
+	}
+
+	void RenderGraph::Cull()
+	{
+		// Outputs are what everything has to lead up to
+		std::vector<bool> needed(this->Images.size(), false);
+		for (size_t i = 0; i < this->Images.size(); i++)
+			needed[i] = this->Images[i].Imported && this->Images[i].FinalLayout != vk::ImageLayout::eUndefined;
+
+		// Walking backwards, a pass is alive if it writes something a later alive pass needs.
+		// Whatever it reads is needed from the passes before it, unless it overwrites it anyway.
+		for (auto pass = this->Passes.rbegin(); pass != this->Passes.rend(); ++pass)
+		{
+			pass->Alive = pass->KeepAlive;
+			for (const auto& access : pass->Accesses)
+			{
+				if (GetAccessInfo(access.Access, access.Stages).Write && needed[access.Resource])
+					pass->Alive = true;
+			}
+
+			if (!pass->Alive)
+			{
+				this->Stats.CulledPasses++;
+				continue;
+			}
+
+			for (const auto& access : pass->Accesses)
+			{
+				if (GetAccessInfo(access.Access, access.Stages).Write && access.Clear)
+					needed[access.Resource] = false;
+			}
+
+			// Loaded attachments and partial transfer writes keep what was there
+			for (const auto& access : pass->Accesses)
+			{
+				if (!access.Clear)
+					needed[access.Resource] = true;
+			}
+		}
+
+		// Lifetimes over the alive passes, transients only need memory in between
+		uint32_t order = 0;
+		for (const auto& pass : this->Passes)
+		{
+			if (!pass.Alive)
+				continue;
+
+			for (const auto& access : pass.Accesses)
+			{
+				auto& image = this->Images[access.Resource];
+				image.FirstUse = std::min(image.FirstUse, order);
+				image.LastUse = std::max(image.LastUse, order);
+			}
+
+			order++;
+		}
+	}
+
+	void RenderGraph::AllocateTransients()
+	{
+		std::vector<uint32_t> used;
+		std::vector<uint64_t> signature;
+
+		for (uint32_t i = 0; i < this->Images.size(); i++)
+		{
+			const auto& image = this->Images[i];
+			if (image.Imported || image.FirstUse > image.LastUse)
+				continue;
+
+			used.push_back(i);
+			signature.insert(signature.end(), {
+				static_cast<uint64_t>(image.Desc.Format),
+				image.Desc.Extent.width,
+				image.Desc.Extent.height,
+				static_cast<uint64_t>(static_cast<VkImageUsageFlags>(image.Usage)),
+				image.FirstUse,
+				image.LastUse });
+		}
+
+		if (signature != this->TransientSignature)
+		{
+			// Cached framebuffers point at the old views, and a recycled view handle could match a stale key
+			Invalidate();
+			DestroyTransients();
+
+			auto& device = this->DeviceContext->LogicalDevice;
+
+			std::vector<vk::MemoryRequirements> requirements;
+			for (const auto index : used)
+			{
+				const auto& image = this->Images[index];
+
+				vk::ImageCreateInfo imageInfo{};
+				imageInfo.imageType = vk::ImageType::e2D;
+				imageInfo.extent = vk::Extent3D(image.Desc.Extent, 1);
+				imageInfo.mipLevels = 1;
+				imageInfo.arrayLayers = 1;
+				imageInfo.format = image.Desc.Format;
+				imageInfo.tiling = vk::ImageTiling::eOptimal;
+				imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+				imageInfo.usage = image.Usage;
+				imageInfo.samples = vk::SampleCountFlagBits::e1;
+				imageInfo.sharingMode = vk::SharingMode::eExclusive;
+
+				TransientImage transient{};
+				transient.Image = device.createImage(imageInfo);
+
+				requirements.push_back(device.getImageMemoryRequirements(transient.Image));
+				transient.Size = requirements.back().size;
+
+				this->Transients.push_back(transient);
+			}
+
+			// Biggest first, each goes into the first slot that's free for its whole lifetime
+			struct Slot
+			{
+				vk::MemoryRequirements Requirements;
+				std::vector<uint32_t> Members;
+			};
+
+			std::vector<uint32_t> bySize(used.size());
+			std::iota(bySize.begin(), bySize.end(), 0);
+			std::stable_sort(bySize.begin(), bySize.end(),
+				[&requirements](uint32_t a, uint32_t b) { return requirements[a].size > requirements[b].size; });
+
+			std::vector<Slot> slots;
+			for (const auto k : bySize)
+			{
+				const auto& image = this->Images[used[k]];
+
+				auto fits = [&](const Slot& slot)
+				{
+					if ((slot.Requirements.memoryTypeBits & requirements[k].memoryTypeBits) == 0)
+						return false;
+
+					for (const auto member : slot.Members)
+					{
+						const auto& other = this->Images[used[member]];
+						if (image.FirstUse <= other.LastUse && other.FirstUse <= image.LastUse)
+							return false;
+					}
+
+					return true;
+				};
+
+				auto slot = std::find_if(slots.begin(), slots.end(), fits);
+				if (slot == slots.end())
+				{
+					slots.push_back({ requirements[k], { k } });
+					continue;
+				}
+
+				slot->Requirements.size = std::max(slot->Requirements.size, requirements[k].size);
+				slot->Requirements.alignment = std::max(slot->Requirements.alignment, requirements[k].alignment);
+				slot->Requirements.memoryTypeBits &= requirements[k].memoryTypeBits;
+				slot->Members.push_back(k);
+			}
+
+			for (const auto& slot : slots)
+			{
+				MemAllocation allocation{};
+				this->DeviceContext->MemManager->AllocateMemory(
+					slot.Requirements,
+					vk::MemoryPropertyFlagBits::eDeviceLocal,
+					MemoryCategory::Attachment,
+					allocation);
+
+				// Contents are undefined on first use every frame, so sharing is fine
+				for (const auto member : slot.Members)
+					device.bindImageMemory(this->Transients[member].Image, allocation.Memory, allocation.Offset);
+
+				this->TransientMemory.push_back(allocation);
+			}
+
+			for (size_t k = 0; k < used.size(); k++)
+			{
+				const auto& image = this->Images[used[k]];
+
+				vk::ImageViewCreateInfo viewInfo(
+					{},
+					this->Transients[k].Image,
+					vk::ImageViewType::e2D,
+					image.Desc.Format,
+					{},
+					vk::ImageSubresourceRange(GetAspect(image.Desc.Format), 0, 1, 0, 1));
+
+				this->Transients[k].View = device.createImageView(viewInfo);
+			}
+
+			this->TransientSignature = signature;
+			this->Revision++;
+		}
+
+		for (size_t k = 0; k < used.size(); k++)
+		{
+			auto& image = this->Images[used[k]];
+			image.Image = this->Transients[k].Image;
+			image.View = this->Transients[k].View;
+
+			this->Stats.TransientBytes += this->Transients[k].Size;
+		}
+
+		vk::DeviceSize allocated = 0;
+		for (const auto& allocation : this->TransientMemory)
+			allocated += allocation.Size;
+
+		this->Stats.AliasedBytes = this->Stats.TransientBytes > allocated ? this->Stats.TransientBytes - allocated : 0;
+	}
+
+	void RenderGraph::ComputeBarriers()
+	{
+		struct State
+		{
+			vk::ImageLayout Layout;
+
+			// Since the last barrier, and the writes it hasn't made visible yet
+			vk::PipelineStageFlags Stages;
+			vk::AccessFlags WriteAccess;
+			bool Used = false;
+		};
+
+		std::vector<State> states(this->Images.size());
+		for (size_t i = 0; i < this->Images.size(); i++)
+			states[i].Layout = this->Images[i].InitialLayout;
+
+		uint32_t order = 0;
+		for (auto& pass : this->Passes)
+		{
+			pass.Barriers.clear();
+			pass.SrcStages = {};
+			pass.DstStages = {};
+			pass.RenderPass = VK_NULL_HANDLE;
+			pass.Framebuffer = VK_NULL_HANDLE;
+			pass.ClearValues.clear();
+
+			if (!pass.Alive)
+				continue;
+
+			std::vector<bool> undefined;
+			undefined.reserve(pass.Accesses.size());
+
+			for (const auto& access : pass.Accesses)
+			{
+				const auto info = GetAccessInfo(access.Access, access.Stages);
+				const auto& image = this->Images[access.Resource];
+				auto& state = states[access.Resource];
+
+				undefined.push_back(state.Layout == vk::ImageLayout::eUndefined);
+
+				// Read after read in the same layout is the only thing that needs nothing
+				const bool layoutChange = state.Layout != info.Layout;
+				const bool needed = state.Used
+					? layoutChange || state.WriteAccess || info.Write
+					: !image.Imported || layoutChange || info.Write;
+
+				if (needed)
+				{
+					// The first use waits on whatever came before on the queue, that covers the
+					// acquire semaphore, last frame and other transients in the same memory
+					const auto srcStages = state.Used ? state.Stages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eAllCommands);
+					const auto srcAccess = state.Used || image.Imported ? state.WriteAccess : vk::AccessFlags(vk::AccessFlagBits::eMemoryWrite);
+
+					pass.Barriers.push_back(vk::ImageMemoryBarrier(
+						srcAccess,
+						info.Access,
+						state.Layout,
+						info.Layout,
+						VK_QUEUE_FAMILY_IGNORED,
+						VK_QUEUE_FAMILY_IGNORED,
+						image.Image,
+						vk::ImageSubresourceRange(GetAspect(image.Desc.Format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS)));
+
+					pass.SrcStages |= srcStages;
+					pass.DstStages |= info.Stages;
+
+					state.Stages = info.Stages;
+				}
+				else
+				{
+					state.Stages |= info.Stages;
+				}
+
+				state.Layout = info.Layout;
+				state.WriteAccess = info.Write ? info.Access : vk::AccessFlags{};
+				state.Used = true;
+			}
+
+			this->Stats.Barriers += pass.Barriers.empty() ? 0 : 1;
+
+			CreateAttachments(pass, order, undefined);
+			order++;
+		}
+
+		this->FinalBarriers.clear();
+		this->FinalSrcStages = {};
+
+		for (size_t i = 0; i < this->Images.size(); i++)
+		{
+			const auto& image = this->Images[i];
+			const auto& state = states[i];
+
+			if (!image.Imported || image.FinalLayout == vk::ImageLayout::eUndefined || state.Layout == image.FinalLayout)
+				continue;
+
+			this->FinalBarriers.push_back(vk::ImageMemoryBarrier(
+				state.WriteAccess,
+				{},
+				state.Layout,
+				image.FinalLayout,
+				VK_QUEUE_FAMILY_IGNORED,
+				VK_QUEUE_FAMILY_IGNORED,
+				image.Image,
+				vk::ImageSubresourceRange(GetAspect(image.Desc.Format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS)));
+
+			this->FinalSrcStages |= state.Used ? state.Stages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTopOfPipe);
+		}
+
+		this->Stats.Barriers += this->FinalBarriers.empty() ? 0 : 1;
+	}
+
+	void RenderGraph::CreateAttachments(Pass& pass, uint32_t order, const std::vector<bool>& undefined)
+	{
+		std::vector<vk::AttachmentDescription> attachments;
+		std::vector<vk::ImageView> views;
+		std::vector<uint32_t> key;
+
+		for (size_t i = 0; i < pass.Accesses.size(); i++)
+		{
+			const auto& access = pass.Accesses[i];
+			const auto info = GetAccessInfo(access.Access, access.Stages);
+			if (!info.Attachment)
+				continue;
+
+			const auto& image = this->Images[access.Resource];
+
+			if (attachments.empty())
+				pass.Extent = image.Desc.Extent;
+			else if (pass.Extent != image.Desc.Extent)
+				throw std::invalid_argument("Render graph pass " + pass.Name + " has attachments of different sizes.");
+
+			// Nothing worth loading in an undefined image, nothing worth keeping after a transient's last use
+			const auto loadOp = access.Clear
+				? vk::AttachmentLoadOp::eClear
+				: (undefined[i] ? vk::AttachmentLoadOp::eDontCare : vk::AttachmentLoadOp::eLoad);
+			const auto storeOp = !image.Imported && image.LastUse == order
+				? vk::AttachmentStoreOp::eDontCare
+				: vk::AttachmentStoreOp::eStore;
+
+			const bool stencil = HasStencil(image.Desc.Format);
+
+			// The barrier in front of the pass already put it in this layout
+			attachments.push_back(vk::AttachmentDescription(
+				{},
+				image.Desc.Format,
+				vk::SampleCountFlagBits::e1,
+				loadOp,
+				storeOp,
+				stencil ? loadOp : vk::AttachmentLoadOp::eDontCare,
+				stencil ? storeOp : vk::AttachmentStoreOp::eDontCare,
+				info.Layout,
+				info.Layout));
+
+			views.push_back(image.View);
+			pass.ClearValues.push_back(access.Clear.value_or(vk::ClearValue{}));
+
+			key.insert(key.end(), {
+				static_cast<uint32_t>(image.Desc.Format),
+				static_cast<uint32_t>(loadOp),
+				static_cast<uint32_t>(storeOp),
+				static_cast<uint32_t>(info.Layout),
+				stencil ? 1u : 0u });
+		}
+
+		if (attachments.empty())
+			return;
+
+		pass.RenderPass = GetRenderPass(key, attachments);
+		pass.Framebuffer = GetFramebuffer(pass.RenderPass, pass.Extent, views);
+	}
+
+	vk::RenderPass RenderGraph::GetRenderPass(const std::vector<uint32_t>& key, const std::vector<vk::AttachmentDescription>& attachments)
+	{
+		if (const auto it = this->RenderPassCache.find(key); it != this->RenderPassCache.end())
+			return it->second;
+
+		std::vector<vk::AttachmentReference> colorRefs;
+		std::optional<vk::AttachmentReference> depthRef;
+
+		for (uint32_t i = 0; i < attachments.size(); i++)
+		{
+			const auto layout = attachments[i].initialLayout;
+			if (layout == vk::ImageLayout::eColorAttachmentOptimal)
+			{
+				colorRefs.push_back(vk::AttachmentReference(i, layout));
+				continue;
+			}
+
+			if (depthRef)
+				throw std::invalid_argument("Render graph pass has more than one depth attachment.");
+
+			depthRef = vk::AttachmentReference(i, layout);
+		}
+
+		vk::SubpassDescription subpass(
+			{},
+			vk::PipelineBindPoint::eGraphics,
+			0, nullptr,
+			static_cast<uint32_t>(colorRefs.size()), colorRefs.data(),
+			nullptr,
+			depthRef ? &*depthRef : nullptr);
+
+		// No dependencies, the graph's barriers around the pass take care of that
+		vk::RenderPassCreateInfo renderPassInfo(
+			{},
+			static_cast<uint32_t>(attachments.size()), attachments.data(),
+			1, &subpass);
+
+		const auto renderPass = this->DeviceContext->LogicalDevice.createRenderPass(renderPassInfo);
+		this->RenderPassCache.emplace(key, renderPass);
+
+		return renderPass;
+	}
+
+	vk::Framebuffer RenderGraph::GetFramebuffer(vk::RenderPass renderPass, vk::Extent2D extent, const std::vector<vk::ImageView>& views)
+	{
+		std::vector<uint64_t> key = { HandleKey(renderPass), extent.width, extent.height };
+		for (const auto view : views)
+			key.push_back(HandleKey(view));
+
+		if (const auto it = this->FramebufferCache.find(key); it != this->FramebufferCache.end())
+			return it->second;
+
+		vk::FramebufferCreateInfo framebufferInfo(
+			{},
+			renderPass,
+			static_cast<uint32_t>(views.size()), views.data(),
+			extent.width,
+			extent.height,
+			1);
+
+		const auto framebuffer = this->DeviceContext->LogicalDevice.createFramebuffer(framebufferInfo);
+		this->FramebufferCache.emplace(std::move(key), framebuffer);
+
+		return framebuffer;
+	}
+
+	void RenderGraph::Compile()
+	{
+		this->Stats = RenderGraphStats{};
+		this->Stats.Passes = static_cast<uint32_t>(this->Passes.size());
+
+		for (auto& image : this->Images)
+		{
+			image.FirstUse = std::numeric_limits<uint32_t>::max();
+			image.LastUse = 0;
+		}
+
+		Cull();
+		AllocateTransients();
+		ComputeBarriers();
+
+		this->Compiled = true;
+	}
+
+	void RenderGraph::Execute(vk::CommandBuffer commandBuffer)
+	{
+		if (!this->Compiled)
+			throw std::runtime_error("Render graph has to be compiled before it's executed.");
+
+		for (const auto& pass : this->Passes)
+		{
+			if (!pass.Alive)
+				continue;
+
+			if (!pass.Barriers.empty())
+				commandBuffer.pipelineBarrier(pass.SrcStages, pass.DstStages, {}, nullptr, nullptr, pass.Barriers);
+
+			RenderPassContext context{};
+			context.CommandBuffer = commandBuffer;
+			context.Graph = this;
+
+			if (pass.RenderPass)
+			{
+				vk::RenderPassBeginInfo renderPassInfo(
+					pass.RenderPass,
+					pass.Framebuffer,
+					vk::Rect2D{ {0, 0}, pass.Extent },
+					static_cast<uint32_t>(pass.ClearValues.size()), pass.ClearValues.data());
+
+				commandBuffer.beginRenderPass(renderPassInfo, pass.Secondary ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline);
+
+				context.RenderPass = pass.RenderPass;
+				context.Framebuffer = pass.Framebuffer;
+				context.Extent = pass.Extent;
+			}
+
+			if (pass.Execute)
+				pass.Execute(context);
+
+			if (pass.RenderPass)
+				commandBuffer.endRenderPass();
+		}
+
+		if (!this->FinalBarriers.empty())
+			commandBuffer.pipelineBarrier(this->FinalSrcStages, vk::PipelineStageFlagBits::eBottomOfPipe, {}, nullptr, nullptr, this->FinalBarriers);
+	}
+
+	void RenderGraph::Reset()
+	{
+		this->Passes.clear();
+		this->Images.clear();
+		this->FinalBarriers.clear();
+		this->Compiled = false;
+	}
+
+	vk::Image RenderGraph::GetImage(RenderResource image) const
+	{
+		if (image >= this->Images.size())
+			throw std::invalid_argument("Render graph resource doesn't exist.");
+
+		return this->Images[image].Image;
+	}
+
+	vk::ImageView RenderGraph::GetImageView(RenderResource image) const
+	{
+		if (image >= this->Images.size())
+			throw std::invalid_argument("Render graph resource doesn't exist.");
+
+		return this->Images[image].View;
+	}
+
+	void RenderGraph::DestroyTransients()
+	{
+		auto& deletion = this->DeviceContext->Deletion;
+		auto& device = this->DeviceContext->LogicalDevice;
+		auto& memManager = *this->DeviceContext->MemManager;
+
+		// Frames in flight can still be using them
+		for (const auto& transient : this->Transients)
+		{
+			deletion->DeferImageView(transient.View);
+			deletion->Defer([&device, image = transient.Image]() { device.destroyImage(image); });
+		}
+
+		for (const auto& allocation : this->TransientMemory)
+			deletion->Defer([&memManager, allocation]() mutable { memManager.FreeMemory(allocation); });
+
+		this->Transients.clear();
+		this->TransientMemory.clear();
+		this->TransientSignature.clear();
+	}
+
+	void RenderGraph::Invalidate()
+	{
+		auto& device = this->DeviceContext->LogicalDevice;
+
+		for (const auto& [key, framebuffer] : this->FramebufferCache)
+			this->DeviceContext->Deletion->Defer([&device, framebuffer]() { device.destroyFramebuffer(framebuffer); });
+
+		this->FramebufferCache.clear();
+		this->Revision++;
+	}
+
+	void RenderGraph::Destroy()
+	{
+		// Framebuffers and transients go through the deletion queue, flushed right after this
+		Invalidate();
+		DestroyTransients();
+
+		for (const auto& [key, renderPass] : this->RenderPassCache)
+			this->DeviceContext->LogicalDevice.destroyRenderPass(renderPass);
+
+		this->RenderPassCache.clear();
+
+		Reset();
+	}
+}
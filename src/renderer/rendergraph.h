@@ -0,0 +1,254 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <optional>
+#include <functional>
+#include <limits>
+#include <cstdint>
+
+#include "renderer/vulkandevicecontext.h"
+#include "renderer/vulkanmem.h"
+
+namespace Engine
+{
+	using RenderResource = uint32_t;
+	constexpr RenderResource InvalidRenderResource = std::numeric_limits<uint32_t>::max();
+
+	// How a pass touches an image. Decides the layout it's in during the pass and what the
+	// barrier in front of the pass has to wait for.
+	enum class ImageAccess : uint8_t
+	{
+		ColorAttachment,
+		DepthAttachment,
+		DepthRead,
+		Sampled,
+		TransferSrc,
+		TransferDst
+	};
+
+	struct RenderImageDesc
+	{
+		vk::Format Format = vk::Format::eUndefined;
+		vk::Extent2D Extent;
+	};
+
+	class RenderGraph;
+
+	struct RenderPassContext
+	{
+		vk::CommandBuffer CommandBuffer;
+
+		// Only set for passes with attachments, they're already inside their render pass
+		vk::RenderPass RenderPass;
+		vk::Framebuffer Framebuffer;
+		vk::Extent2D Extent;
+
+		const RenderGraph* Graph = nullptr;
+	};
+
+	struct RenderGraphStats
+	{
+		uint32_t Passes = 0;
+		uint32_t CulledPasses = 0;
+		uint32_t Barriers = 0;
+
+		// Transient attachments, summed up as if each had its own memory, and what aliasing saved
+		vk::DeviceSize TransientBytes = 0;
+		vk::DeviceSize AliasedBytes = 0;
+	};
+
+	// Passes declare the images they read and write, and are run in the order they were added.
+	// Compile culls passes nothing depends on, works out the layout transitions between passes
+	// and batches them into one barrier per pass, and sets up render passes and framebuffers for
+	// the attachments. Transient images only live for the frame and share memory with other
+	// transients that are never alive at the same time.
+	// Render passes, framebuffers and transient images are cached, so rebuilding the same graph
+	// every frame only costs the bookkeeping.
+	class RenderGraph
+	{
+	public:
+		using ExecuteFn = std::function<void(const RenderPassContext&)>;
+
+	private:
+		struct PassAccess
+		{
+			RenderResource Resource;
+			ImageAccess Access;
+			vk::PipelineStageFlags Stages;
+
+			// Attachments only, cleared on load if set
+			std::optional<vk::ClearValue> Clear;
+		};
+
+		struct Pass
+		{
+			std::string Name;
+			std::vector<PassAccess> Accesses;
+			ExecuteFn Execute;
+
+			bool Secondary = false;
+			bool KeepAlive = false;
+
+			// Filled in by Compile
+			bool Alive = false;
+			std::vector<vk::ImageMemoryBarrier> Barriers;
+			vk::PipelineStageFlags SrcStages;
+			vk::PipelineStageFlags DstStages;
+
+			vk::RenderPass RenderPass;
+			vk::Framebuffer Framebuffer;
+			vk::Extent2D Extent;
+			std::vector<vk::ClearValue> ClearValues;
+		};
+
+		struct ImageResource
+		{
+			std::string Name;
+			RenderImageDesc Desc;
+
+			bool Imported = false;
+			vk::Image Image;
+			vk::ImageView View;
+			vk::ImageLayout InitialLayout = vk::ImageLayout::eUndefined;
+			vk::ImageLayout FinalLayout = vk::ImageLayout::eUndefined;
+
+			// Transients are created with every usage a pass declared
+			vk::ImageUsageFlags Usage;
+
+			// Alive passes, in execution order. First > Last when nothing alive uses it.
+			uint32_t FirstUse = std::numeric_limits<uint32_t>::max();
+			uint32_t LastUse = 0;
+		};
+
+		// Transients of the last graph that needed new ones, reused while the graph looks the same
+		struct TransientImage
+		{
+			vk::Image Image;
+			vk::ImageView View;
+			vk::DeviceSize Size = 0;
+		};
+
+		std::shared_ptr<VulkanDeviceContext> DeviceContext;
+
+		std::vector<Pass> Passes;
+		std::vector<ImageResource> Images;
+
+		// Barriers to leave imported images in their final layout
+		std::vector<vk::ImageMemoryBarrier> FinalBarriers;
+		vk::PipelineStageFlags FinalSrcStages;
+
+		// Keyed by attachment formats, load/store ops and layouts
+		std::map<std::vector<uint32_t>, vk::RenderPass> RenderPassCache;
+
+		// Keyed by render pass, extent and views
+		std::map<std::vector<uint64_t>, vk::Framebuffer> FramebufferCache;
+
+		std::vector<uint64_t> TransientSignature;
+		std::vector<TransientImage> Transients;
+		std::vector<MemAllocation> TransientMemory;
+
+		uint64_t Revision = 0;
+		bool Compiled = false;
+
+		RenderGraphStats Stats;
+
+		void Cull();
+		void AllocateTransients();
+		void ComputeBarriers();
+		void CreateAttachments(Pass& pass, uint32_t order, const std::vector<bool>& undefined);
+
+		vk::RenderPass GetRenderPass(const std::vector<uint32_t>& key, const std::vector<vk::AttachmentDescription>& attachments);
+		vk::Framebuffer GetFramebuffer(vk::RenderPass renderPass, vk::Extent2D extent, const std::vector<vk::ImageView>& views);
+
+		void DestroyTransients();
+
+		ImageResource& GetResource(RenderResource resource);
+
+	public:
+		class PassBuilder
+		{
+		private:
+			RenderGraph& Graph;
+			Pass& Target;
+
+			void Use(RenderResource image, ImageAccess access, vk::PipelineStageFlags stages, std::optional<vk::ClearValue> clear = std::nullopt);
+
+		public:
+			// Loaded unless clear is set. The first use of a transient starts out undefined instead.
+			void WriteColor(RenderResource image, std::optional<vk::ClearColorValue> clear = std::nullopt);
+			void WriteDepth(RenderResource image, std::optional<vk::ClearDepthStencilValue> clear = std::nullopt);
+
+			// Read only depth attachment, for depth testing against an earlier pass
+			void ReadDepth(RenderResource image);
+
+			void ReadSampled(RenderResource image, vk::PipelineStageFlags stages = vk::PipelineStageFlagBits::eFragmentShader);
+			void ReadTransfer(RenderResource image);
+			void WriteTransfer(RenderResource image);
+
+			// The render pass is begun with eSecondaryCommandBuffers, draws have to go through executeCommands
+			void UseSecondaryCommandBuffers();
+
+			// Never culled, even when nothing reads what it writes
+			void KeepAlive();
+
+			PassBuilder(RenderGraph& graph, Pass& pass) :
+				Graph(graph),
+				Target(pass)
+			{}
+		};
+
+		// An image that lives outside the graph, e.g. a swapchain image. It's in initialLayout when
+		// the graph runs and is left in finalLayout. Images with a final layout are the graph's
+		// outputs, passes writing to them are never culled.
+		RenderResource ImportImage(
+			const char* name,
+			vk::Image image,
+			vk::ImageView view,
+			const RenderImageDesc& desc,
+			vk::ImageLayout initialLayout,
+			vk::ImageLayout finalLayout = vk::ImageLayout::eUndefined);
+
+		// Only lives for the frame, its contents start out undefined
+		RenderResource CreateImage(const char* name, const RenderImageDesc& desc);
+
+		void AddPass(const char* name, const std::function<void(PassBuilder&)>& setup, ExecuteFn execute);
+
+		void Compile();
+
+		// Records the alive passes with their barriers, Compile has to have run
+		void Execute(vk::CommandBuffer commandBuffer);
+
+		// Forgets the declared passes and images, the caches stay
+		void Reset();
+
+		// Valid after Compile, for passes that bind what an earlier one wrote
+		vk::Image GetImage(RenderResource image) const;
+		vk::ImageView GetImageView(RenderResource image) const;
+
+		const RenderGraphStats& GetStats() const
+		{
+			return this->Stats;
+		}
+
+		// Bumped whenever cached objects are replaced, anything recorded against the old ones is stale
+		uint64_t GetRevision() const
+		{
+			return this->Revision;
+		}
+
+		// Drops the cached framebuffers, e.g. after the views they point at were re-created
+		void Invalidate();
+
+		// Call once the device is idle
+		void Destroy();
+
+		RenderGraph(std::shared_ptr<VulkanDeviceContext> devCtx) :
+			DeviceContext(devCtx)
+		{}
+	};
+}
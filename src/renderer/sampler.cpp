@@ -0,0 +1,105 @@
+#include "renderer/sampler.h"
+
+#include <tuple>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+
+namespace Engine
+{
+	// Everything in vk::SamplerCreateInfo except sType and pNext
+	static auto SamplerState(const vk::SamplerCreateInfo& info)
+	{
+		return std::tie(
+			info.flags,
+			info.magFilter,
+			info.minFilter,
+			info.mipmapMode,
+			info.addressModeU,
+			info.addressModeV,
+			info.addressModeW,
+			info.mipLodBias,
+			info.anisotropyEnable,
+			info.maxAnisotropy,
+			info.compareEnable,
+			info.compareOp,
+			info.minLod,
+			info.maxLod,
+			info.borderColor,
+			info.unnormalizedCoordinates);
+	}
+
+	static inline void HashCombine(size_t& seed, size_t value)
+	{
+		seed ^= value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2);
+	}
+
+	static inline size_t HashValue(float value)
+	{
+		// 0.0f and -0.0f compare equal, so they have to hash the same
+		if (value == 0.0f)
+			return 0;
+
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	static inline size_t HashValue(uint32_t value)
+	{
+		return value;
+	}
+
+	template<typename T>
+	static inline size_t HashValue(const T& value)
+	{
+		if constexpr (std::is_enum_v<T>)
+			return static_cast<size_t>(value);
+		else
+			return static_cast<size_t>(static_cast<typename T::MaskType>(value));
+	}
+
+	size_t SamplerCache::KeyHash::operator()(const vk::SamplerCreateInfo& info) const
+	{
+		size_t seed = 0;
+
+		std::apply([&seed](const auto&... members)
+			{
+				(HashCombine(seed, HashValue(members)), ...);
+			}, SamplerState(info));
+
+		return seed;
+	}
+
+	bool SamplerCache::KeyEqual::operator()(const vk::SamplerCreateInfo& a, const vk::SamplerCreateInfo& b) const
+	{
+		return SamplerState(a) == SamplerState(b);
+	}
+
+	vk::Sampler SamplerCache::Get(const vk::SamplerCreateInfo& info)
+	{
+		if (info.pNext)
+			throw std::invalid_argument("Cached samplers can't have extension structs.");
+
+		auto it = this->Samplers.find(info);
+		if (it != this->Samplers.end())
+			return it->second;
+
+		if (this->Samplers.size() >= this->MaxSamplers)
+			throw std::runtime_error("Out of samplers, the device's maxSamplerAllocationCount has been reached.");
+
+		auto sampler = this->LogicalDevice.createSampler(info);
+		this->Samplers.emplace(info, sampler);
+
+		return sampler;
+	}
+
+	void SamplerCache::Destroy()
+	{
+		for (auto& [info, sampler] : this->Samplers)
+			this->LogicalDevice.destroySampler(sampler);
+
+		this->Samplers.clear();
+	}
+}
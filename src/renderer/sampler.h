@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+namespace Engine
+{
+	// One vk::Sampler per distinct sampler state. Samplers are shared and never change, they
+	// live until the cache is destroyed, so they can be baked into descriptor set layouts as
+	// immutable samplers. Devices only allow maxSamplerAllocationCount of them (4000 on some).
+	class SamplerCache
+	{
+	private:
+		struct KeyHash
+		{
+			size_t operator()(const vk::SamplerCreateInfo& info) const;
+		};
+
+		struct KeyEqual
+		{
+			bool operator()(const vk::SamplerCreateInfo& a, const vk::SamplerCreateInfo& b) const;
+		};
+
+		vk::Device& LogicalDevice;
+		uint32_t MaxSamplers;
+
+		std::unordered_map<vk::SamplerCreateInfo, vk::Sampler, KeyHash, KeyEqual> Samplers;
+
+	public:
+		// The cache owns the result, don't destroy it. Extension structs in pNext aren't
+		// part of the key, so they're rejected.
+		vk::Sampler Get(const vk::SamplerCreateInfo& info);
+
+		size_t GetSamplerCount() const
+		{
+			return this->Samplers.size();
+		}
+
+		// The device must be done with every sampler handed out
+		void Destroy();
+
+		SamplerCache(vk::Device& device, const vk::PhysicalDeviceLimits& limits) :
+			LogicalDevice(device),
+			MaxSamplers(limits.maxSamplerAllocationCount)
+		{}
+	};
+}
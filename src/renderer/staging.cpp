@@ -0,0 +1,205 @@
+#include "renderer/staging.h"
+
+#include <algorithm>
+
+namespace Engine
+{
+	StagingRing::StagingRing(vk::Device& device, VulkanMemManager& memManager, vk::Semaphore& timeline, vk::DeviceSize capacity) :
+		LogicalDevice(device),
+		MemManager(memManager),
+		Timeline(timeline),
+		Capacity(capacity)
+	{
+		this->MemManager.CreateBuffer(
+			this->Buffer,
+			this->Allocation,
+			capacity,
+			vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			MemoryCategory::Staging);
+
+		this->Data = static_cast<uint8_t*>(this->MemManager.MapMemory(this->Allocation));
+	}
+
+	bool StagingRing::TryAllocate(vk::DeviceSize size, vk::DeviceSize alignment, StagingRegion& out)
+	{
+		if (size > this->Capacity)
+			throw std::invalid_argument("Staging allocation is larger than the ring, split it up.");
+
+		Reclaim();
+
+		while (true)
+		{
+			auto offset = (this->Head + alignment - 1) & ~(alignment - 1);
+
+			// Wrap around, the tail end of the buffer is wasted until it's reclaimed
+			if (offset + size > this->Capacity)
+				offset = 0;
+
+			const auto consumed = (offset >= this->Head ? offset - this->Head : this->Capacity - this->Head) + size;
+
+			if (consumed <= this->Capacity - this->Used)
+			{
+				this->Head = offset + size;
+				this->Used += consumed;
+				this->PendingBytes += consumed;
+
+				out.Buffer = this->Buffer;
+				out.Offset = offset;
+				out.Size = size;
+				out.Data = this->Data + offset;
+
+				return true;
+			}
+
+			if (this->InFlight.empty())
+				return false;
+
+			// Out of space, wait for the oldest copy to drain
+			const auto& oldest = this->InFlight.front();
+
+			vk::SemaphoreWaitInfo waitInfo({}, 1, &this->Timeline, &oldest.Value);
+			vk::resultCheck(this->LogicalDevice.waitSemaphores(waitInfo, UINT64_MAX),
+				"Failed to wait for the upload timeline.");
+
+			this->Used -= oldest.Bytes;
+			this->InFlight.pop_front();
+		}
+	}
+
+	void StagingRing::Retire(uint64_t value)
+	{
+		if (this->PendingBytes == 0)
+			return;
+
+		this->InFlight.push_back({ value, this->PendingBytes });
+		this->PendingBytes = 0;
+	}
+
+	void StagingRing::Reclaim()
+	{
+		if (this->InFlight.empty())
+			return;
+
+		const auto completed = this->LogicalDevice.getSemaphoreCounterValue(this->Timeline);
+
+		while (!this->InFlight.empty() && this->InFlight.front().Value <= completed)
+		{
+			this->Used -= this->InFlight.front().Bytes;
+			this->InFlight.pop_front();
+		}
+	}
+
+	void StagingRing::Destroy()
+	{
+		this->InFlight.clear();
+
+		this->MemManager.DestroyBuffer(this->Buffer, this->Allocation);
+	}
+
+	void DecodeStagingAllocation::Retire(uint64_t value)
+	{
+		if (!this->Ring)
+			return;
+
+		this->Ring->Retire(this->Id, value);
+		this->Ring = nullptr;
+	}
+
+	DecodeStagingRing::DecodeStagingRing(VulkanMemManager& memManager, vk::DeviceSize capacity) :
+		MemManager(memManager),
+		Capacity(capacity)
+	{
+		auto properties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+
+		// Write combined memory is fine to write but terribly slow to read back
+		const auto cached = properties | vk::MemoryPropertyFlagBits::eHostCached;
+		const auto& memoryProperties = this->MemManager.GetMemoryProperties();
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			if ((memoryProperties.memoryTypes[i].propertyFlags & cached) == cached)
+			{
+				properties = cached;
+				break;
+			}
+		}
+
+		this->MemManager.CreateBuffer(
+			this->Buffer,
+			this->Allocation,
+			capacity,
+			vk::BufferUsageFlagBits::eTransferSrc,
+			properties,
+			MemoryCategory::Staging);
+
+		this->Data = static_cast<uint8_t*>(this->MemManager.MapMemory(this->Allocation));
+	}
+
+	bool DecodeStagingRing::TryAllocate(vk::DeviceSize size, DecodeStagingAllocation& out)
+	{
+		std::lock_guard lock(this->Mutex);
+
+		if (size > this->Capacity)
+			return false;
+
+		auto offset = (this->Head + StagingAlignment - 1) & ~(StagingAlignment - 1);
+		if (offset + size > this->Capacity)
+			offset = 0;
+
+		const auto consumed = (offset >= this->Head ? offset - this->Head : this->Capacity - this->Head) + size;
+		if (consumed > this->Capacity - this->Used)
+			return false;
+
+		this->Head = offset + size;
+		this->Used += consumed;
+
+		const auto id = this->NextId++;
+		this->Entries.push_back({ id, consumed, UINT64_MAX });
+
+		out = DecodeStagingAllocation{};
+		out.Ring = this;
+		out.Id = id;
+		out.Region.Buffer = this->Buffer;
+		out.Region.Offset = offset;
+		out.Region.Size = size;
+		out.Region.Data = this->Data + offset;
+
+		return true;
+	}
+
+	void DecodeStagingRing::Retire(uint64_t id, uint64_t value)
+	{
+		std::lock_guard lock(this->Mutex);
+
+		auto it = std::find_if(this->Entries.begin(), this->Entries.end(),
+			[id](const Entry& entry) { return entry.Id == id; });
+
+		if (it != this->Entries.end())
+			it->Value = value;
+	}
+
+	void DecodeStagingRing::Reclaim(uint64_t completed)
+	{
+		std::lock_guard lock(this->Mutex);
+
+		while (!this->Entries.empty() && this->Entries.front().Value <= completed)
+		{
+			this->Used -= this->Entries.front().Bytes;
+			this->Entries.pop_front();
+		}
+
+		// Nothing left, start over at the front rather than wrapping later
+		if (this->Entries.empty())
+		{
+			this->Head = 0;
+			this->Used = 0;
+		}
+	}
+
+	void DecodeStagingRing::Destroy()
+	{
+		this->Entries.clear();
+
+		this->MemManager.DestroyBuffer(this->Buffer, this->Allocation);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+#include "renderer/vulkanmem.h"
+
+namespace Engine
+{
+	constexpr vk::DeviceSize DefaultStagingRingSize = 32ull * 1024 * 1024;
+
+	// Anything decoding into staging has to fit in this, bigger textures decode to the heap
+	constexpr vk::DeviceSize DefaultDecodeStagingSize = 64ull * 1024 * 1024;
+
+	// Every staging copy is placed at a multiple of this, which covers any texel or block size
+	constexpr vk::DeviceSize StagingAlignment = 16;
+
+	struct StagingRegion
+	{
+		vk::Buffer Buffer;
+		vk::DeviceSize Offset = 0;
+		vk::DeviceSize Size = 0;
+		void* Data = nullptr;
+	};
+
+	// Persistent, persistently mapped host visible buffer that uploads are staged through.
+	// Allocations are handed out front to back and wrap around. Everything allocated between two
+	// Retire calls is tied to the timeline value passed to Retire, and the space comes back once
+	// the upload timeline reaches it.
+	class StagingRing
+	{
+	private:
+		struct InFlightRange
+		{
+			uint64_t Value;
+			vk::DeviceSize Bytes;
+		};
+
+		vk::Device& LogicalDevice;
+		VulkanMemManager& MemManager;
+		vk::Semaphore& Timeline;
+
+		uint8_t* Data = nullptr;
+		vk::DeviceSize Capacity;
+		vk::DeviceSize Head = 0;
+
+		// Bytes between the oldest in-flight range and Head, wrap padding included
+		vk::DeviceSize Used = 0;
+
+		// Bytes allocated since the last Retire
+		vk::DeviceSize PendingBytes = 0;
+
+		std::deque<InFlightRange> InFlight;
+
+	public:
+		vk::Buffer Buffer;
+		MemAllocation Allocation;
+
+		// Uploads larger than this are split so a few chunks can be in flight at once
+		vk::DeviceSize MaxChunkSize() const
+		{
+			return this->Capacity / 4;
+		}
+
+		// Fails only when the space is held by allocations that haven't been retired yet,
+		// in which case the caller has to submit its pending copies first. Blocks on
+		// in-flight copies otherwise.
+		bool TryAllocate(vk::DeviceSize size, vk::DeviceSize alignment, StagingRegion& out);
+
+		// value is what the submit consuming the pending allocations signals on the timeline
+		void Retire(uint64_t value);
+
+		// Non-blocking, frees every range the timeline has passed
+		void Reclaim();
+
+		void Destroy();
+
+		StagingRing(vk::Device& device, VulkanMemManager& memManager, vk::Semaphore& timeline, vk::DeviceSize capacity = DefaultStagingRingSize);
+	};
+
+	class DecodeStagingRing;
+
+	// Space in a DecodeStagingRing, given back when this goes away unless it was retired first
+	class DecodeStagingAllocation
+	{
+	private:
+		friend class DecodeStagingRing;
+
+		DecodeStagingRing* Ring = nullptr;
+		uint64_t Id = 0;
+
+	public:
+		StagingRegion Region;
+
+		bool IsValid() const
+		{
+			return this->Ring != nullptr;
+		}
+
+		// The space comes back once the upload timeline reaches value, i.e. once the copies
+		// reading from it have run. 0 gives it back right away.
+		void Retire(uint64_t value);
+
+		DecodeStagingAllocation() = default;
+		~DecodeStagingAllocation()
+		{
+			Retire(0);
+		}
+
+		DecodeStagingAllocation(DecodeStagingAllocation&& other) noexcept :
+			Ring(other.Ring),
+			Id(other.Id),
+			Region(other.Region)
+		{
+			other.Ring = nullptr;
+		}
+
+		DecodeStagingAllocation& operator=(DecodeStagingAllocation&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Retire(0);
+
+				this->Ring = other.Ring;
+				this->Id = other.Id;
+				this->Region = other.Region;
+				other.Ring = nullptr;
+			}
+
+			return *this;
+		}
+
+		DecodeStagingAllocation(const DecodeStagingAllocation&) = delete;
+		DecodeStagingAllocation& operator=(const DecodeStagingAllocation&) = delete;
+	};
+
+	// Persistently mapped staging that decoders on worker threads write their output straight
+	// into, so texels never sit in a heap buffer on the way to the GPU. Handed out front to back
+	// like StagingRing, but decodes finish and upload in any order, so each allocation is retired
+	// on its own and space only comes back once everything older has been retired too.
+	// Prefers host cached memory, decoders read back what they wrote (mips, PNG filters).
+	class DecodeStagingRing
+	{
+	private:
+		struct Entry
+		{
+			uint64_t Id;
+
+			// Wrap padding included
+			vk::DeviceSize Bytes;
+
+			// UINT64_MAX until retired
+			uint64_t Value;
+		};
+
+		VulkanMemManager& MemManager;
+
+		std::mutex Mutex;
+
+		uint8_t* Data = nullptr;
+		vk::DeviceSize Capacity;
+		vk::DeviceSize Head = 0;
+		vk::DeviceSize Used = 0;
+
+		uint64_t NextId = 1;
+
+		std::atomic<uint32_t> StagedDecodes = 0;
+		std::atomic<uint32_t> HeapDecodes = 0;
+
+		// In allocation order
+		std::deque<Entry> Entries;
+
+		friend class DecodeStagingAllocation;
+		void Retire(uint64_t id, uint64_t value);
+
+	public:
+		vk::Buffer Buffer;
+		MemAllocation Allocation;
+
+		// Any thread. Never blocks, false when there's no room right now.
+		bool TryAllocate(vk::DeviceSize size, DecodeStagingAllocation& out);
+
+		// Main thread, frees retired space at the front up to the completed timeline value
+		void Reclaim(uint64_t completed);
+
+		// Any thread. Decoders report whether their output landed here or had to go through the heap.
+		void CountDecode(bool staged)
+		{
+			(staged ? this->StagedDecodes : this->HeapDecodes)++;
+		}
+
+		uint32_t GetStagedDecodes() const
+		{
+			return this->StagedDecodes;
+		}
+
+		uint32_t GetHeapDecodes() const
+		{
+			return this->HeapDecodes;
+		}
+
+		// Every allocation has to be gone by now
+		void Destroy();
+
+		DecodeStagingRing(VulkanMemManager& memManager, vk::DeviceSize capacity = DefaultDecodeStagingSize);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "renderer/streaming.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "renderer/texturecache.h"
+
+namespace Engine
+{
+	vk::DeviceSize TextureStreamer::BytesFrom(const DecodedTexture& source, uint32_t level)
+	{
+		const auto& block = source.Block;
+
+		vk::DeviceSize bytes = 0;
+		for (; level < source.MipLevels; level++)
+		{
+			const auto width = std::max(1u, source.Width >> level);
+			const auto height = std::max(1u, source.Height >> level);
+
+			bytes += static_cast<vk::DeviceSize>((width + block.Width - 1) / block.Width)
+				* ((height + block.Height - 1) / block.Height)
+				* block.Size;
+		}
+
+		return bytes;
+	}
+
+	std::shared_ptr<Image> TextureStreamer::Load(const std::string& texturePath)
+	{
+		auto entry = std::make_unique<Entry>();
+		entry->Texture = std::make_shared<Image>(this->DeviceContext);
+
+		auto texture = entry->Texture;
+		auto* target = entry.get();
+
+		this->ByImage.emplace(texture.get(), target);
+		this->Entries.push_back(std::move(entry));
+
+		this->DeviceContext->Textures->GetLoader().Decode(texturePath, true, [this, target](DecodedTexture& decoded)
+			{
+				auto source = std::make_shared<DecodedTexture>(std::move(decoded));
+
+				// Coarsest level that's still at least StreamingInitialSize on its largest side
+				const auto largest = std::max(source->Width, source->Height);
+				uint32_t level = 0;
+				while (level + 1 < source->MipLevels && (largest >> (level + 1)) >= StreamingInitialSize)
+					level++;
+
+				target->Source = source;
+				target->ResidentLevel = level;
+				target->CoarsestLevel = level;
+				target->WantedLevel = level;
+
+				auto& image = *target->Texture;
+				image.CreateTextureImage(*source, level);
+				image.CreateImageView(image.Format);
+				image.CreateTextureSampler();
+			});
+
+		return texture;
+	}
+
+	void TextureStreamer::SetDemand(const Image& texture, float screenPixels)
+	{
+		auto it = this->ByImage.find(&texture);
+		if (it != this->ByImage.end())
+			it->second->Demand = screenPixels;
+	}
+
+	vk::DeviceSize TextureStreamer::GetResidentBytes() const
+	{
+		vk::DeviceSize bytes = 0;
+		for (const auto& entry : this->Entries)
+		{
+			if (entry->Source)
+				bytes += BytesFrom(*entry->Source, entry->ResidentLevel);
+		}
+
+		return bytes;
+	}
+
+	void TextureStreamer::FitBudget()
+	{
+		vk::DeviceSize total = 0;
+		for (const auto& entry : this->Entries)
+		{
+			if (entry->Source)
+				total += BytesFrom(*entry->Source, entry->WantedLevel);
+		}
+
+		if (total <= this->Budget)
+			return;
+
+		// Least demanded first, each gives up its finest level until we fit
+		std::vector<Entry*> byDemand;
+		for (const auto& entry : this->Entries)
+		{
+			if (entry->Source)
+				byDemand.push_back(entry.get());
+		}
+
+		std::sort(byDemand.begin(), byDemand.end(), [](const Entry* a, const Entry* b)
+			{
+				return a->Demand < b->Demand;
+			});
+
+		for (auto* entry : byDemand)
+		{
+			while (total > this->Budget && entry->WantedLevel < entry->CoarsestLevel)
+			{
+				const auto before = BytesFrom(*entry->Source, entry->WantedLevel);
+				entry->WantedLevel++;
+				total -= before - BytesFrom(*entry->Source, entry->WantedLevel);
+			}
+
+			if (total <= this->Budget)
+				break;
+		}
+	}
+
+	void TextureStreamer::StartUpload(Entry& entry)
+	{
+		entry.Pending = std::make_unique<Image>(this->DeviceContext);
+		entry.PendingLevel = entry.WantedLevel;
+
+		auto& image = *entry.Pending;
+		image.CreateTextureImage(*entry.Source, entry.WantedLevel);
+		image.CreateImageView(image.Format);
+		image.CreateTextureSampler();
+	}
+
+	void TextureStreamer::Update()
+	{
+		auto& uploader = this->DeviceContext->Uploader;
+
+		for (auto& entry : this->Entries)
+		{
+			if (!entry->Source)
+				continue;
+
+			if (entry->Pending && uploader->IsResident(entry->Pending->Ticket))
+			{
+				entry->Texture->Replace(*entry->Pending);
+				entry->ResidentLevel = entry->PendingLevel;
+				entry->Pending.reset();
+			}
+
+			// Level whose size matches what's on screen. Texels past one per pixel only alias.
+			const auto largest = static_cast<float>(std::max(entry->Source->Width, entry->Source->Height));
+			const auto wanted = entry->Demand > 0.0f
+				? static_cast<uint32_t>(std::max(0.0f, std::floor(std::log2(largest / entry->Demand))))
+				: entry->CoarsestLevel;
+
+			entry->WantedLevel = std::min(wanted, entry->CoarsestLevel);
+		}
+
+		FitBudget();
+
+		// Drops free memory, so they go first, then the most demanded textures
+		std::vector<Entry*> changes;
+		for (const auto& entry : this->Entries)
+		{
+			if (entry->Source && !entry->Pending && entry->WantedLevel != entry->ResidentLevel)
+				changes.push_back(entry.get());
+		}
+
+		std::sort(changes.begin(), changes.end(), [](const Entry* a, const Entry* b)
+			{
+				const auto aDrops = a->WantedLevel > a->ResidentLevel;
+				const auto bDrops = b->WantedLevel > b->ResidentLevel;
+
+				if (aDrops != bDrops)
+					return aDrops;
+
+				return a->Demand > b->Demand;
+			});
+
+		vk::DeviceSize uploaded = 0;
+		for (auto* entry : changes)
+		{
+			const auto bytes = BytesFrom(*entry->Source, entry->WantedLevel);
+
+			// Always let one through, or a texture bigger than the budget would never stream in
+			if (uploaded > 0 && uploaded + bytes > this->BytesPerFrame)
+				break;
+
+			StartUpload(*entry);
+			uploaded += bytes;
+		}
+	}
+
+	void TextureStreamer::Destroy()
+	{
+		for (auto& entry : this->Entries)
+		{
+			if (entry->Pending)
+				entry->Pending->Destroy();
+
+			entry->Texture->Destroy();
+		}
+
+		this->Entries.clear();
+		this->ByImage.clear();
+	}
+}
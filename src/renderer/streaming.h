@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+#include "renderer/vulkandevicecontext.h"
+#include "renderer/image.h"
+
+namespace Engine
+{
+	constexpr vk::DeviceSize DefaultStreamingBudget = 256ull * 1024 * 1024;
+	constexpr vk::DeviceSize DefaultStreamingBytesPerFrame = 16ull * 1024 * 1024;
+
+	// Textures start out at their coarsest levels
+	constexpr uint32_t StreamingInitialSize = 64;
+
+	// Keeps only the mips a texture needs on screen resident. The whole decoded chain stays on
+	// the CPU, and each texture's GPU image only holds the levels from its resident level down.
+	// Changing that re-creates the image with the new range, uploads it from the CPU copy and
+	// swaps it into the Image once it's resident, so the handle never changes but the view
+	// does. Over budget, the least demanded textures lose their finest levels first.
+	class TextureStreamer
+	{
+	private:
+		struct Entry
+		{
+			std::shared_ptr<Image> Texture;
+			std::shared_ptr<const DecodedTexture> Source;
+
+			// Level 0 of the GPU image is this level of Source
+			uint32_t ResidentLevel = 0;
+
+			// Never streamed out past this, it's what the texture starts with
+			uint32_t CoarsestLevel = 0;
+
+			uint32_t WantedLevel = 0;
+
+			// Replacement image being uploaded, and the level it starts at
+			std::unique_ptr<Image> Pending;
+			uint32_t PendingLevel = 0;
+
+			// On screen size in pixels of the texture's largest side, 0 when not visible
+			float Demand = 0.0f;
+		};
+
+		std::shared_ptr<VulkanDeviceContext> DeviceContext;
+
+		vk::DeviceSize Budget;
+		vk::DeviceSize BytesPerFrame;
+
+		std::vector<std::unique_ptr<Entry>> Entries;
+		std::unordered_map<const Image*, Entry*> ByImage;
+
+		static vk::DeviceSize BytesFrom(const DecodedTexture& source, uint32_t level);
+
+		void FitBudget();
+		void StartUpload(Entry& entry);
+
+	public:
+		// Non-resident until the coarse levels have been decoded and uploaded
+		std::shared_ptr<Image> Load(const std::string& texturePath);
+
+		// How many pixels the texture's largest side covers on screen this frame
+		void SetDemand(const Image& texture, float screenPixels);
+
+		// Main thread, once per frame before the uploader is flushed. Swaps in finished
+		// uploads and starts new ones, up to BytesPerFrame.
+		void Update();
+
+		void SetBudget(vk::DeviceSize budget)
+		{
+			this->Budget = budget;
+		}
+
+		// What the resident levels of every streamed texture take up
+		vk::DeviceSize GetResidentBytes() const;
+
+		void Destroy();
+
+		TextureStreamer(std::shared_ptr<VulkanDeviceContext> devCtx, vk::DeviceSize budget = DefaultStreamingBudget, vk::DeviceSize bytesPerFrame = DefaultStreamingBytesPerFrame) :
+			DeviceContext(devCtx),
+			Budget(budget),
+			BytesPerFrame(bytesPerFrame)
+		{}
+	};
+}
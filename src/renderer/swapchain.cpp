@@ -1,5 +1,7 @@
 #include "swapchain.h"
 
+#include <algorithm>
+
 namespace Engine
 {
 	void SwapChain::ChooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& availableFormats, vk::SurfaceFormatKHR& format)
@@ -20,16 +22,29 @@ namespace Engine
 
 	void SwapChain::ChooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes, vk::PresentModeKHR& presentMode)
 	{
-		for (const auto& availablePresentMode : availablePresentModes)
+		std::vector<vk::PresentModeKHR> preferred;
+		switch (this->PresentPreference)
 		{
-			if (availablePresentMode == vk::PresentModeKHR::eMailbox)
+		case PresentModePreference::Throughput:
+			preferred = { vk::PresentModeKHR::eMailbox };
+			break;
+		case PresentModePreference::Latency:
+			preferred = { vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eMailbox };
+			break;
+		case PresentModePreference::VSync:
+			break;
+		}
+
+		for (const auto mode : preferred)
+		{
+			if (std::find(availablePresentModes.begin(), availablePresentModes.end(), mode) != availablePresentModes.end())
 			{
-				presentMode = availablePresentMode;
+				presentMode = mode;
 				return;
 			}
 		}
 
-		// Fall back to FIFO
+		// Fall back to FIFO, it's always there
 		presentMode = vk::PresentModeKHR::eFifo;
 	}
 
@@ -61,7 +76,29 @@ namespace Engine
 		extent = actualExtent;
 	}
 
-	void SwapChain::CreateSwapChain()
+	vk::DeviceSize SwapChain::EstimateImageSize(const vk::SwapchainCreateInfoKHR& createInfo)
+	{
+		// Ask for the requirements of an equivalent image, then throw it away
+		vk::ImageCreateInfo imageInfo{};
+		imageInfo.imageType = vk::ImageType::e2D;
+		imageInfo.extent = vk::Extent3D{ createInfo.imageExtent.width, createInfo.imageExtent.height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = createInfo.imageArrayLayers;
+		imageInfo.format = createInfo.imageFormat;
+		imageInfo.tiling = vk::ImageTiling::eOptimal;
+		imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+		imageInfo.usage = createInfo.imageUsage;
+		imageInfo.samples = vk::SampleCountFlagBits::e1;
+		imageInfo.sharingMode = vk::SharingMode::eExclusive;
+
+		auto image = this->DeviceContext->LogicalDevice.createImage(imageInfo);
+		auto memRequirements = this->DeviceContext->LogicalDevice.getImageMemoryRequirements(image);
+		this->DeviceContext->LogicalDevice.destroyImage(image);
+
+		return memRequirements.size;
+	}
+
+	void SwapChain::CreateSwapChain(vk::SwapchainKHR oldSwapchain)
 	{
 		SwapChainSupportDetails details;
 		VulkanDeviceContext::QuerySwapChainSupport(this->DeviceContext->PhysicalDevice, this->DeviceContext->Surface, details);
@@ -118,13 +155,16 @@ namespace Engine
 		createInfo.presentMode = presentMode;
 		createInfo.clipped = VK_TRUE;
 
-		// TODO: Come back to me later
-		createInfo.oldSwapchain = VK_NULL_HANDLE;
+		// Lets the driver hand resources over and keeps already queued presents valid
+		createInfo.oldSwapchain = oldSwapchain;
 
 		this->Swapchain = this->DeviceContext->LogicalDevice.createSwapchainKHR(createInfo);
 		this->SwapChainImages = this->DeviceContext->LogicalDevice.getSwapchainImagesKHR(this->Swapchain);
 		this->SwapChainImageFormat = surfaceFormat.format;
 		this->SwapChainExtent = extent;
+
+		this->TrackedBytes = EstimateImageSize(createInfo) * this->SwapChainImages.size();
+		this->DeviceContext->MemManager->TrackExternal(MemoryCategory::Swapchain, this->TrackedBytes);
 	}
 
 	void SwapChain::CreateImageViews()
@@ -153,32 +193,11 @@ namespace Engine
 
 			this->SwapChainImageViews.push_back(this->DeviceContext->LogicalDevice.createImageView(createInfo));
 		}
-	}
 
-	void SwapChain::CreateFramebuffers(vk::RenderPass& renderPass)
-	{
-		this->SwapChainFramebuffers.reserve(this->SwapChainImageViews.size());
-
-		vk::FramebufferCreateInfo framebufferInfo{};
-		framebufferInfo.renderPass = renderPass;
-		framebufferInfo.attachmentCount = 1;
-		framebufferInfo.width = this->SwapChainExtent.width;
-		framebufferInfo.height = this->SwapChainExtent.height;
-		framebufferInfo.layers = 1;
-
-		for (const auto& imageView : this->SwapChainImageViews)
-		{
-			std::array<vk::ImageView, 1> attachments = {
-				imageView
-			};
-
-			framebufferInfo.pAttachments = attachments.data();
-
-			this->SwapChainFramebuffers.push_back(this->DeviceContext->LogicalDevice.createFramebuffer(framebufferInfo));
-		}
+		this->Generation++;
 	}
 
-	void SwapChain::RecreateSwapChain(vk::RenderPass& renderPass)
+	void SwapChain::RecreateSwapChain()
 	{
 		// If window is minimized, block application until its visible again
 		int width = 0, height = 0;
@@ -189,32 +208,34 @@ namespace Engine
 			glfwWaitEvents();
 		}
 
-		this->DeviceContext->LogicalDevice.waitIdle();
+		// No waitIdle, frames still in flight keep the old swapchain's objects alive
+		// through the deletion queue
+		const auto oldSwapchain = this->Swapchain;
 
 		Destroy();
 
-		CreateSwapChain();
+		CreateSwapChain(oldSwapchain);
 		CreateImageViews();
-		CreateFramebuffers(renderPass);
 	}
 
 	void SwapChain::Destroy()
 	{
-		// Framebuffers
-		for (auto& framebuffer : this->SwapChainFramebuffers)
-		{
-			this->DeviceContext->LogicalDevice.destroyFramebuffer(framebuffer);
-		}
-		this->SwapChainFramebuffers.clear();
+		auto& deletion = this->DeviceContext->Deletion;
+		auto& device = this->DeviceContext->LogicalDevice;
 
 		// Image views
 		for (auto& imageView : this->SwapChainImageViews)
 		{
-			this->DeviceContext->LogicalDevice.destroyImageView(imageView);
+			deletion->DeferImageView(imageView);
 		}
 		this->SwapChainImageViews.clear();
 
 		// Swap chain
-		this->DeviceContext->LogicalDevice.destroySwapchainKHR(this->Swapchain);
+		deletion->Defer([&device, swapchain = this->Swapchain]() { device.destroySwapchainKHR(swapchain); });
+		this->Swapchain = VK_NULL_HANDLE;
+		this->SwapChainImages.clear();
+
+		this->DeviceContext->MemManager->UntrackExternal(MemoryCategory::Swapchain, this->TrackedBytes);
+		this->TrackedBytes = 0;
 	}
 }
\ No newline at end of file
@@ -11,6 +11,7 @@
 
 #include "renderer/vulkandevicecontext.h"
 #include "renderer/queue.h"
+#include "renderer/framepacing.h"
 
 namespace Engine
 {
@@ -19,30 +20,38 @@ namespace Engine
 	private:
 		std::shared_ptr<VulkanDeviceContext> DeviceContext;
 		GLFWwindow* Window;
+		PresentModePreference PresentPreference;
 
 		// Swap chain shit
 		void ChooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& availableFormats, vk::SurfaceFormatKHR& format);
 		void ChooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes, vk::PresentModeKHR& presentMode);
 		void ChooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities, vk::Extent2D& extent);
 
+		// The driver owns the swapchain images, so their size is estimated for the memory report
+		vk::DeviceSize TrackedBytes = 0;
+		vk::DeviceSize EstimateImageSize(const vk::SwapchainCreateInfoKHR& createInfo);
+
 	public:
 		vk::SwapchainKHR Swapchain;
 		std::vector<vk::Image> SwapChainImages;
 		vk::Format SwapChainImageFormat = vk::Format::eUndefined;
 		vk::Extent2D SwapChainExtent;
 		std::vector<vk::ImageView> SwapChainImageViews;
-		std::vector<vk::Framebuffer> SwapChainFramebuffers;
 
-		void CreateSwapChain();
+		// Bumped whenever the image views are re-created, anything recorded against the old ones is stale
+		uint64_t Generation = 0;
+
+		// oldSwapchain is retired by the new one, it stays valid until it's destroyed
+		void CreateSwapChain(vk::SwapchainKHR oldSwapchain = VK_NULL_HANDLE);
 		void CreateImageViews();
-		void CreateFramebuffers(vk::RenderPass& renderPass);
+		// Deferred until the frames in flight are done with it
 		void Destroy();
-		void RecreateSwapChain(vk::RenderPass& renderPass);
+		void RecreateSwapChain();
 
-		SwapChain(std::shared_ptr<VulkanDeviceContext> devCtx, GLFWwindow* window)
-			: DeviceContext(devCtx), Window(window) {}
+		SwapChain(std::shared_ptr<VulkanDeviceContext> devCtx, GLFWwindow* window, PresentModePreference presentPreference = PresentModePreference::Throughput)
+			: DeviceContext(devCtx), Window(window), PresentPreference(presentPreference) {}
 
 		constexpr SwapChain()
-			: DeviceContext(nullptr), Window(nullptr) {};
+			: DeviceContext(nullptr), Window(nullptr), PresentPreference(PresentModePreference::Throughput) {};
 	};
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "renderer/texturecache.h"
+
+#include <filesystem>
+#include <cstring>
+
+#include "files.h"
+#include "renderer/vulkandevicecontext.h"
+
+namespace Engine
+{
+	static inline uint64_t RotateLeft(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	// 8 bytes per step so hashing runs close to memory speed, finished with the murmur3 mix.
+	// Not cryptographic, a match is also checked against the file size.
+	static uint64_t HashContents(const uint8_t* data, size_t size)
+	{
+		constexpr uint64_t k1 = 0x87C37B91114253D5ull;
+		constexpr uint64_t k2 = 0x4CF5AD432745937Full;
+
+		uint64_t hash = 0x9E3779B97F4A7C15ull ^ size;
+
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t word;
+			std::memcpy(&word, data + i, sizeof(word));
+
+			hash ^= RotateLeft(word * k1, 31) * k2;
+			hash = RotateLeft(hash, 27) * 5 + 0x52DCE729;
+		}
+
+		uint64_t tail = 0;
+		std::memcpy(&tail, data + i, size - i);
+		hash ^= RotateLeft(tail * k1, 31) * k2;
+
+		hash ^= hash >> 33;
+		hash *= 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 33;
+		hash *= 0xC4CEB93E53CA63ull;
+		hash ^= hash >> 33;
+
+		return hash;
+	}
+
+	void TextureCache::Touch(std::list<Entry>::iterator entry)
+	{
+		this->Entries.splice(this->Entries.begin(), this->Entries, entry);
+	}
+
+	std::shared_ptr<Image> TextureCache::Get(const std::string& texturePath)
+	{
+		const auto canonical = std::filesystem::weakly_canonical(texturePath).string();
+
+		auto byPath = this->ByPath.find(canonical);
+		if (byPath != this->ByPath.end())
+		{
+			Touch(byPath->second);
+			return byPath->second->Texture;
+		}
+
+		// New name, it might still be a file we already have
+		MappedFile file;
+		file.Open(canonical);
+
+		const auto size = file.GetSize();
+		const auto hash = HashContents(file.GetData(), size);
+
+		auto [first, last] = this->ByHash.equal_range(hash);
+		for (auto it = first; it != last; ++it)
+		{
+			auto entry = it->second;
+			if (entry->ContentSize != size)
+				continue;
+
+			entry->Paths.push_back(canonical);
+			this->ByPath.emplace(canonical, entry);
+
+			Touch(entry);
+			return entry->Texture;
+		}
+
+		Entry entry;
+		entry.Texture = this->Loader.Load(canonical);
+		entry.ContentHash = hash;
+		entry.ContentSize = size;
+		entry.Paths.push_back(canonical);
+
+		this->Entries.push_front(std::move(entry));
+
+		auto inserted = this->Entries.begin();
+		this->ByPath.emplace(canonical, inserted);
+		this->ByHash.emplace(hash, inserted);
+
+		return inserted->Texture;
+	}
+
+	void TextureCache::Evict(std::list<Entry>::iterator entry)
+	{
+		for (const auto& path : entry->Paths)
+			this->ByPath.erase(path);
+
+		auto [first, last] = this->ByHash.equal_range(entry->ContentHash);
+		for (auto it = first; it != last; ++it)
+		{
+			if (it->second == entry)
+			{
+				this->ByHash.erase(it);
+				break;
+			}
+		}
+
+		entry->Texture->Destroy();
+		this->Entries.erase(entry);
+	}
+
+	vk::DeviceSize TextureCache::GetResidentBytes() const
+	{
+		vk::DeviceSize bytes = 0;
+		for (const auto& entry : this->Entries)
+			bytes += entry.Texture->ImageAllocation.Size;
+
+		return bytes;
+	}
+
+	void TextureCache::Pump()
+	{
+		this->Loader.Pump();
+		Trim();
+	}
+
+	void TextureCache::Trim()
+	{
+		auto bytes = GetResidentBytes();
+
+		auto it = this->Entries.end();
+		while (bytes > this->Budget && it != this->Entries.begin())
+		{
+			--it;
+
+			// Someone still holds a handle, or the loader does because it's still decoding
+			if (it->Texture.use_count() > 1)
+				continue;
+
+			bytes -= it->Texture->ImageAllocation.Size;
+
+			auto victim = it++;
+			Evict(victim);
+		}
+	}
+
+	void TextureCache::Destroy()
+	{
+		this->Loader.Destroy();
+
+		for (auto& entry : this->Entries)
+			entry.Texture->Destroy();
+
+		this->Entries.clear();
+		this->ByPath.clear();
+		this->ByHash.clear();
+	}
+}
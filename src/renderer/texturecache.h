@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <memory>
+#include <list>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "renderer/image.h"
+#include "renderer/textureloader.h"
+
+namespace Engine
+{
+	class VulkanDeviceContext;
+
+	constexpr vk::DeviceSize DefaultTextureCacheBudget = 512ull * 1024 * 1024;
+
+	// One GPU image per distinct texture file. Lookups go by canonical path first, then by a
+	// hash of the file contents, so the same texture under two names or copied to two places
+	// is only loaded once. Handles are shared_ptrs to the cached Image, and entries nobody
+	// holds a handle to are kept until the textures go over budget, least recently used first.
+	// Anything that points at the image (descriptor sets, the defragmenter) has to hold a handle.
+	class TextureCache
+	{
+	private:
+		struct Entry
+		{
+			std::shared_ptr<Image> Texture;
+			uint64_t ContentHash = 0;
+			size_t ContentSize = 0;
+
+			// Canonical paths that resolved to this entry
+			std::vector<std::string> Paths;
+		};
+
+		VulkanDeviceContext& DeviceContext;
+		TextureLoader Loader;
+
+		vk::DeviceSize Budget;
+
+		// Most recently used first
+		std::list<Entry> Entries;
+		std::unordered_map<std::string, std::list<Entry>::iterator> ByPath;
+		std::unordered_multimap<uint64_t, std::list<Entry>::iterator> ByHash;
+
+		void Touch(std::list<Entry>::iterator entry);
+		void Evict(std::list<Entry>::iterator entry);
+
+	public:
+		// Starts loading on a miss, the image isn't resident until its upload has been acquired
+		std::shared_ptr<Image> Get(const std::string& texturePath);
+
+		// Main thread, once per frame before the uploader is flushed. Starts uploads for
+		// finished decodes, then evicts unreferenced textures while over budget.
+		void Pump();
+
+		void Trim();
+
+		void SetBudget(vk::DeviceSize budget)
+		{
+			this->Budget = budget;
+		}
+
+		// Device memory held by every cached texture, referenced or not
+		vk::DeviceSize GetResidentBytes() const;
+
+		// For decodes that don't go through the cache, e.g. streamed textures
+		TextureLoader& GetLoader()
+		{
+			return this->Loader;
+		}
+
+		size_t GetEntryCount() const
+		{
+			return this->Entries.size();
+		}
+
+		// Frees every cached texture, handles still out there are left pointing at nothing
+		void Destroy();
+
+		TextureCache(VulkanDeviceContext& devCtx, vk::DeviceSize budget = DefaultTextureCacheBudget) :
+			DeviceContext(devCtx),
+			Loader(devCtx),
+			Budget(budget)
+		{}
+	};
+}
@@ -0,0 +1,102 @@
+#include "renderer/textureloader.h"
+
+namespace Engine
+{
+	std::shared_ptr<Image> TextureLoader::Load(const std::string& texturePath)
+	{
+		auto image = std::make_shared<Image>(this->DeviceContext.shared_from_this());
+
+		auto job = std::make_unique<Job>();
+		job->Path = texturePath;
+		job->Staging = &this->DeviceContext.Uploader->GetDecodeStaging();
+
+		// Holding the image here is what keeps the cache from evicting it mid-load
+		job->OnDecoded = [image](DecodedTexture& decoded)
+			{
+				image->CreateTextureImage(std::move(decoded));
+				image->CreateImageView(image->Format);
+				image->CreateTextureSampler();
+			};
+
+		Submit(std::move(job));
+
+		return image;
+	}
+
+	void TextureLoader::Decode(const std::string& texturePath, bool cpuMips, std::function<void(DecodedTexture&)> onDecoded)
+	{
+		auto job = std::make_unique<Job>();
+		job->Path = texturePath;
+		job->CpuMips = cpuMips;
+		job->OnDecoded = std::move(onDecoded);
+
+		Submit(std::move(job));
+	}
+
+	void TextureLoader::Submit(std::unique_ptr<Job> job)
+	{
+		// The physical device is only queried, which Vulkan allows from any thread
+		this->Workers.Submit([this, job = job.release()]()
+			{
+				std::unique_ptr<Job> owned(job);
+
+				try
+				{
+					Image::Decode(this->DeviceContext.PhysicalDevice, owned->Path, owned->Decoded, owned->CpuMips, owned->Staging);
+				}
+				catch (...)
+				{
+					owned->Error = std::current_exception();
+				}
+
+				std::lock_guard lock(this->FinishedMutex);
+				this->Finished.push_back(std::move(owned));
+			});
+
+		this->Pending++;
+	}
+
+	void TextureLoader::Pump()
+	{
+		std::vector<std::unique_ptr<Job>> finished;
+
+		{
+			std::lock_guard lock(this->FinishedMutex);
+			finished.swap(this->Finished);
+		}
+
+		// Everything that decoded fine gets delivered before a failure is rethrown, or it'd never be
+		std::exception_ptr error;
+		for (auto& job : finished)
+		{
+			this->Pending--;
+
+			if (job->Error)
+			{
+				if (!error)
+					error = job->Error;
+				continue;
+			}
+
+			job->OnDecoded(job->Decoded);
+		}
+
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	void TextureLoader::WaitIdle()
+	{
+		this->Workers.WaitIdle();
+		Pump();
+	}
+
+	void TextureLoader::Destroy()
+	{
+		this->Workers.WaitIdle();
+
+		std::lock_guard lock(this->FinishedMutex);
+		this->Finished.clear();
+		this->Pending = 0;
+	}
+}
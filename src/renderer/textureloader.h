@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <exception>
+#include <functional>
+#include <cstdint>
+
+#include "threadpool.h"
+#include "renderer/vulkandevicecontext.h"
+#include "renderer/image.h"
+
+namespace Engine
+{
+	// Decodes textures on a worker pool and uploads them from the main thread as they finish.
+	// Load hands back an Image right away that stays non-resident until its upload has been
+	// acquired, so callers draw with a placeholder until then.
+	class TextureLoader
+	{
+	private:
+		struct Job
+		{
+			std::string Path;
+			bool CpuMips = false;
+
+			// Decode straight into this if set
+			DecodeStagingRing* Staging = nullptr;
+			std::function<void(DecodedTexture&)> OnDecoded;
+
+			DecodedTexture Decoded;
+			std::exception_ptr Error;
+		};
+
+		// Not a shared_ptr, the device context owns the loader through its texture cache
+		VulkanDeviceContext& DeviceContext;
+
+		// Decoded but not uploaded yet, filled by the workers
+		std::mutex FinishedMutex;
+		std::vector<std::unique_ptr<Job>> Finished;
+
+		// Submitted and not pumped yet, main thread only
+		uint32_t Pending = 0;
+
+		// Last so the workers are joined before anything they touch goes away
+		ThreadPool Workers;
+
+		void Submit(std::unique_ptr<Job> job);
+
+	public:
+		std::shared_ptr<Image> Load(const std::string& texturePath);
+
+		// Decodes on a worker and calls onDecoded from Pump with the result, which it may move
+		// from. cpuMips makes the whole mip chain come back in Levels. The texels always end up
+		// on the heap, for callers that hold on to them; Load decodes into staging instead.
+		void Decode(const std::string& texturePath, bool cpuMips, std::function<void(DecodedTexture&)> onDecoded);
+
+		// Main thread, once per frame before the uploader is flushed. Creates and queues the
+		// upload for everything that finished decoding. Rethrows the first decode error once the
+		// rest have been delivered.
+		void Pump();
+
+		// Blocks until every texture asked for so far has been queued for upload
+		void WaitIdle();
+
+		bool IsIdle() const
+		{
+			return this->Pending == 0;
+		}
+
+		// Drops anything still decoding, the images it was loading stay non-resident
+		void Destroy();
+
+		TextureLoader(VulkanDeviceContext& devCtx, uint32_t threadCount = 0) :
+			DeviceContext(devCtx),
+			Workers(threadCount)
+		{}
+	};
+}
@@ -4,12 +4,10 @@ namespace Engine
 {
 	void VulkanDescriptorPool::CreateDescriptorPool(uint32_t PoolSize)
 	{
-		std::array<vk::DescriptorPoolSize, 2> poolSizes{};
+		std::array<vk::DescriptorPoolSize, 1> poolSizes{};
 
-		poolSizes[0].type = vk::DescriptorType::eUniformBuffer;
+		poolSizes[0].type = vk::DescriptorType::eUniformBufferDynamic;
 		poolSizes[0].descriptorCount = PoolSize;
-		poolSizes[1].type = vk::DescriptorType::eCombinedImageSampler;
-		poolSizes[1].descriptorCount = PoolSize;
 
 		vk::DescriptorPoolCreateInfo poolInfo(
 			{},
@@ -24,15 +22,10 @@ namespace Engine
 	{
 		vk::DescriptorSetLayoutBinding uboLayoutBinding(
 			0,
-			vk::DescriptorType::eUniformBuffer, 1,
+			vk::DescriptorType::eUniformBufferDynamic, 1,
 			vk::ShaderStageFlagBits::eVertex);
 
-		vk::DescriptorSetLayoutBinding samplerLayoutBinding(
-			1,
-			vk::DescriptorType::eCombinedImageSampler, 1,
-			vk::ShaderStageFlagBits::eFragment);
-
-		std::array<vk::DescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
+		std::array<vk::DescriptorSetLayoutBinding, 1> bindings = { uboLayoutBinding };
 		vk::DescriptorSetLayoutCreateInfo layoutInfo(
 			{}, 
 			static_cast<uint32_t>(bindings.size()), 
@@ -40,4 +33,4 @@ namespace Engine
 
 		this->DescriptorSetLayout = this->DeviceContext->LogicalDevice.createDescriptorSetLayout(layoutInfo);
 	}
-}
\ No newline at end of file
+}
@@ -5,45 +5,85 @@
 
 #include "renderer/vulkandevicecontext.h"
 #include "renderer/vulkanmem.h"
-#include "renderer/image.h"
 
 namespace Engine
 {
+	// One persistently mapped uniform buffer split into a segment per frame in flight.
+	// Per-object data is bump allocated out of the current frame's segment and bound
+	// with a dynamic offset, so there is no map/unmap and no allocation per frame.
 	template <typename T>
-	struct Uniform
+	class UniformRing
 	{
+	private:
+		std::shared_ptr<VulkanDeviceContext> DeviceContext;
+
+		uint8_t* Data = nullptr;
+
+		vk::DeviceSize SegmentSize = 0;
+		vk::DeviceSize SegmentStart = 0;
+		vk::DeviceSize Head = 0;
+
+	public:
 		vk::Buffer UniformBuffer;
-		vk::DeviceMemory UniformBufferMemory;
+		MemAllocation UniformBufferAllocation;
 		const size_t UniformSize = sizeof(T);
 
-		template <typename T>
-		void UpdateUniformBuffer(VulkanMemManager& MemManager, T& object)
+		// sizeof(T) rounded up to minUniformBufferOffsetAlignment
+		vk::DeviceSize Stride = 0;
+
+		// Call once the GPU is done with frameIndex's previous submission
+		void BeginFrame(uint32_t frameIndex)
 		{
-			auto data = MemManager.MapMemory(this->UniformBufferMemory, 0, this->UniformSize);
-			std::memcpy(data, &object, this->UniformSize);
-			MemManager.UnmapMemory(this->UniformBufferMemory);
+			this->SegmentStart = this->SegmentSize * frameIndex;
+			this->Head = this->SegmentStart;
 		}
 
-		void CreateUniformBuffer(VulkanMemManager& MemManager)
+		// Offsets relative to this repeat every time a frame slot comes around, if it pushes the same objects
+		vk::DeviceSize GetSegmentStart() const
 		{
-			vk::DeviceSize bufferSize = this->UniformSize;
+			return this->SegmentStart;
+		}
 
-			MemManager.CreateBuffer(
-				this->UniformBuffer,
-				this->UniformBufferMemory,
-				bufferSize,
-				vk::BufferUsageFlagBits::eUniformBuffer,
-				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		// Returns the dynamic offset to bind the object with
+		uint32_t Push(const T& object)
+		{
+			if (this->Head + this->Stride > this->SegmentStart + this->SegmentSize)
+				throw std::runtime_error("Uniform ring segment exhausted, raise the per-frame budget.");
+
+			const auto offset = this->Head;
+			std::memcpy(this->Data + offset, &object, this->UniformSize);
+			this->Head += this->Stride;
+
+			return static_cast<uint32_t>(offset);
 		}
 
-		void Destroy(VulkanMemManager& MemManager)
+		// Freed once the frames in flight are done with it
+		void Destroy()
 		{
-			MemManager.DestroyBuffer(this->UniformBuffer, this->UniformBufferMemory);
+			this->DeviceContext->Deletion->DeferBuffer(this->UniformBuffer, this->UniformBufferAllocation);
+
+			this->UniformBuffer = VK_NULL_HANDLE;
+			this->UniformBufferAllocation = MemAllocation{};
+			this->Data = nullptr;
 		}
 
-		Uniform<T>(VulkanMemManager& MemManager)
+		UniformRing(std::shared_ptr<VulkanDeviceContext> devCtx, uint32_t segmentCount, uint32_t objectsPerSegment) :
+			DeviceContext(devCtx)
 		{
-			CreateUniformBuffer(MemManager);
+			const auto alignment = this->DeviceContext->PhysicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
+
+			this->Stride = (this->UniformSize + alignment - 1) & ~(alignment - 1);
+			this->SegmentSize = this->Stride * objectsPerSegment;
+
+			this->DeviceContext->MemManager->CreateBuffer(
+				this->UniformBuffer,
+				this->UniformBufferAllocation,
+				this->SegmentSize * segmentCount,
+				vk::BufferUsageFlagBits::eUniformBuffer,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+				MemoryCategory::Uniform);
+
+			this->Data = static_cast<uint8_t*>(this->DeviceContext->MemManager->MapMemory(this->UniformBufferAllocation));
 		}
 	};
 
@@ -62,8 +102,9 @@ namespace Engine
 		vk::DescriptorSetLayout DescriptorSetLayout;
 		std::vector<vk::DescriptorSet> DescriptorSets;
 
+		// Textures live in the bindless table, these only carry the uniform ring
 		template <typename T>
-		void CreateDescriptorSets(std::vector<Uniform<T>>& uniforms, Image texture)
+		void CreateDescriptorSets(UniformRing<T>& uniforms)
 		{
 			std::vector<vk::DescriptorSetLayout> layouts(this->PoolSize, this->DescriptorSetLayout);
 
@@ -74,34 +115,21 @@ namespace Engine
 
 			for (size_t i = 0; i < this->PoolSize; i++)
 			{
+				// One object's worth, the dynamic offset at bind time picks the slot in the ring
 				vk::DescriptorBufferInfo bufferInfo(
-					uniforms[i].UniformBuffer,
+					uniforms.UniformBuffer,
 					0,
-					uniforms[i].UniformSize);
-
-				// TODO: Make this better
-				vk::DescriptorImageInfo imageInfo(
-					texture.Sampler, 
-					texture.ImageView, 
-					vk::ImageLayout::eShaderReadOnlyOptimal);
-
-				std::array<vk::WriteDescriptorSet, 2> descWrites{};
-
-				descWrites[0].dstSet = this->DescriptorSets[i];
-				descWrites[0].dstBinding = 0;
-				descWrites[0].dstArrayElement = 0;
-				descWrites[0].descriptorType = vk::DescriptorType::eUniformBuffer;
-				descWrites[0].descriptorCount = 1;
-				descWrites[0].pBufferInfo = &bufferInfo;
-
-				descWrites[1].dstSet = this->DescriptorSets[i];
-				descWrites[1].dstBinding = 1;
-				descWrites[1].dstArrayElement = 0;
-				descWrites[1].descriptorType = vk::DescriptorType::eCombinedImageSampler;
-				descWrites[1].descriptorCount = 1;
-				descWrites[1].pImageInfo = &imageInfo;
-
-				this->DeviceContext->LogicalDevice.updateDescriptorSets(descWrites, nullptr);
+					uniforms.UniformSize);
+
+				vk::WriteDescriptorSet descWrite{};
+				descWrite.dstSet = this->DescriptorSets[i];
+				descWrite.dstBinding = 0;
+				descWrite.dstArrayElement = 0;
+				descWrite.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+				descWrite.descriptorCount = 1;
+				descWrite.pBufferInfo = &bufferInfo;
+
+				this->DeviceContext->LogicalDevice.updateDescriptorSets(descWrite, nullptr);
 			}
 		}
 
@@ -0,0 +1,674 @@
+#include "renderer/upload.h"
+
+#include <array>
+#include <algorithm>
+#include <cstring>
+
+namespace Engine
+{
+	void RecordMipChain(vk::CommandBuffer& commandBuffer, vk::Image image, uint32_t width, uint32_t height, uint32_t mipLevels)
+	{
+		vk::ImageMemoryBarrier barrier{};
+		barrier.image = image;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		auto mipWidth = static_cast<int32_t>(width);
+		auto mipHeight = static_cast<int32_t>(height);
+
+		for (uint32_t level = 1; level < mipLevels; level++)
+		{
+			// Previous level is done being written, read from it
+			barrier.subresourceRange.baseMipLevel = level - 1;
+			barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+			barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+			barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+
+			commandBuffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eTransfer,
+				vk::PipelineStageFlagBits::eTransfer,
+				{},
+				0, nullptr,
+				0, nullptr,
+				1, &barrier);
+
+			const auto nextWidth = std::max(1, mipWidth / 2);
+			const auto nextHeight = std::max(1, mipHeight / 2);
+
+			vk::ImageBlit blit{};
+			blit.srcOffsets[1] = vk::Offset3D{ mipWidth, mipHeight, 1 };
+			blit.srcSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level - 1, 0, 1);
+			blit.dstOffsets[1] = vk::Offset3D{ nextWidth, nextHeight, 1 };
+			blit.dstSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1);
+
+			commandBuffer.blitImage(
+				image, vk::ImageLayout::eTransferSrcOptimal,
+				image, vk::ImageLayout::eTransferDstOptimal,
+				1, &blit,
+				vk::Filter::eLinear);
+
+			mipWidth = nextWidth;
+			mipHeight = nextHeight;
+		}
+
+		// Everything but the last level ended up in eTransferSrcOptimal
+		std::array<vk::ImageMemoryBarrier, 2> finalBarriers = { barrier, barrier };
+
+		finalBarriers[0].subresourceRange.baseMipLevel = 0;
+		finalBarriers[0].subresourceRange.levelCount = mipLevels - 1;
+		finalBarriers[0].oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+		finalBarriers[0].newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		finalBarriers[0].srcAccessMask = vk::AccessFlagBits::eTransferRead;
+		finalBarriers[0].dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+		finalBarriers[1].subresourceRange.baseMipLevel = mipLevels - 1;
+		finalBarriers[1].subresourceRange.levelCount = 1;
+		finalBarriers[1].oldLayout = vk::ImageLayout::eTransferDstOptimal;
+		finalBarriers[1].newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		finalBarriers[1].srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		finalBarriers[1].dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eFragmentShader,
+			{},
+			0, nullptr,
+			0, nullptr,
+			static_cast<uint32_t>(finalBarriers.size()), finalBarriers.data());
+	}
+
+	void UploadBarrierBatch::Record(vk::CommandBuffer& commandBuffer)
+	{
+		if (Empty())
+			return;
+
+		commandBuffer.pipelineBarrier(
+			this->SrcStages,
+			this->DstStages,
+			{},
+			0, nullptr,
+			static_cast<uint32_t>(this->BufferBarriers.size()), this->BufferBarriers.data(),
+			static_cast<uint32_t>(this->ImageBarriers.size()), this->ImageBarriers.data());
+	}
+
+	void UploadBarrierBatch::Clear()
+	{
+		this->SrcStages = {};
+		this->DstStages = {};
+		this->BufferBarriers.clear();
+		this->ImageBarriers.clear();
+	}
+
+	UploadContext::UploadContext(
+		vk::Device& device,
+		vk::PhysicalDevice& physicalDevice,
+		VulkanMemManager& memManager,
+		VulkanQueues& queues,
+		const QueueFamilyIndices& indices) :
+		LogicalDevice(device),
+		MemManager(memManager),
+		Queues(queues),
+		TransferFamily(indices.TransferFamily.value()),
+		GraphicsFamily(indices.GraphicsFamily.value())
+	{
+		this->ImageGranularity = physicalDevice.getQueueFamilyProperties()[this->TransferFamily].minImageTransferGranularity;
+
+		vk::CommandPoolCreateInfo poolInfo(
+			vk::CommandPoolCreateFlagBits::eTransient,
+			this->TransferFamily);
+
+		this->CommandPool = this->LogicalDevice.createCommandPool(poolInfo);
+
+		vk::SemaphoreTypeCreateInfo timelineInfo(vk::SemaphoreType::eTimeline, 0);
+
+		vk::SemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.pNext = &timelineInfo;
+
+		this->Timeline = this->LogicalDevice.createSemaphore(semaphoreInfo);
+
+		this->Staging = std::make_unique<StagingRing>(device, memManager, this->Timeline);
+		this->DecodeStaging = std::make_unique<DecodeStagingRing>(memManager);
+	}
+
+	void UploadContext::Flush()
+	{
+		if (!HasQueuedWork())
+			return;
+
+		vk::CommandBufferAllocateInfo allocInfo(
+			this->CommandPool,
+			vk::CommandBufferLevel::ePrimary,
+			1);
+
+		auto commandBuffer = this->LogicalDevice.allocateCommandBuffers(allocInfo).front();
+
+		vk::CommandBufferBeginInfo beginInfo(
+			vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+		commandBuffer.begin(beginInfo);
+
+		this->PreCopyBarriers.Record(commandBuffer);
+
+		// Consecutive copies into the same resource go out as one call
+		std::vector<vk::BufferCopy> bufferRegions;
+		for (size_t i = 0; i < this->BufferCopies.size(); i++)
+		{
+			const auto& copy = this->BufferCopies[i];
+			bufferRegions.push_back(copy.Region);
+
+			if (i + 1 == this->BufferCopies.size() || this->BufferCopies[i + 1].Dst != copy.Dst)
+			{
+				commandBuffer.copyBuffer(this->Staging->Buffer, copy.Dst, static_cast<uint32_t>(bufferRegions.size()), bufferRegions.data());
+				bufferRegions.clear();
+			}
+		}
+
+		std::vector<vk::BufferImageCopy> imageRegions;
+		for (size_t i = 0; i < this->ImageCopies.size(); i++)
+		{
+			const auto& copy = this->ImageCopies[i];
+			imageRegions.push_back(copy.Region);
+
+			if (i + 1 == this->ImageCopies.size() || this->ImageCopies[i + 1].Dst != copy.Dst || this->ImageCopies[i + 1].Src != copy.Src)
+			{
+				commandBuffer.copyBufferToImage(copy.Src, copy.Dst, vk::ImageLayout::eTransferDstOptimal, static_cast<uint32_t>(imageRegions.size()), imageRegions.data());
+				imageRegions.clear();
+			}
+		}
+
+		// Only queued when the transfer queue can blit
+		for (const auto& chain : this->MipChains)
+			RecordMipChain(commandBuffer, chain.Image, chain.Width, chain.Height, chain.MipLevels);
+
+		this->PostCopyBarriers.Record(commandBuffer);
+
+		commandBuffer.end();
+
+		const auto value = this->NextValue++;
+
+		vk::TimelineSemaphoreSubmitInfo timelineInfo(
+			0, nullptr,
+			1, &value);
+
+		vk::SubmitInfo submitInfo(
+			0, nullptr, nullptr,
+			1, &commandBuffer,
+			1, &this->Timeline);
+		submitInfo.pNext = &timelineInfo;
+
+		vk::resultCheck(this->Queues.TransferQueue.submit(1, &submitInfo, VK_NULL_HANDLE),
+			"Failed to submit upload commands.");
+
+		// Staging space used by this batch comes back once the timeline passes value
+		this->Staging->Retire(value);
+
+		this->InFlight.push_back({ value, commandBuffer });
+
+		this->PreCopyBarriers.Clear();
+		this->BufferCopies.clear();
+		this->ImageCopies.clear();
+		this->MipChains.clear();
+		this->PostCopyBarriers.Clear();
+
+		RecycleCommandBuffers();
+	}
+
+	void UploadContext::RecycleCommandBuffers()
+	{
+		const auto completed = CompletedValue();
+
+		while (!this->InFlight.empty() && this->InFlight.front().Value <= completed)
+		{
+			this->LogicalDevice.freeCommandBuffers(this->CommandPool, 1, &this->InFlight.front().CommandBuffer);
+			this->InFlight.pop_front();
+		}
+
+		FreeDedicatedStaging(completed);
+	}
+
+	void UploadContext::AllocateStaging(vk::DeviceSize size, StagingRegion& out)
+	{
+		if (this->Staging->TryAllocate(size, StagingAlignment, out))
+			return;
+
+		// The ring is full of this batch, get it going. Resources that are halfway through
+		// stay in eTransferDstOptimal and pick up where they left off in the next batch.
+		Flush();
+
+		if (!this->Staging->TryAllocate(size, StagingAlignment, out))
+			throw std::runtime_error("Failed to allocate staging memory.");
+	}
+
+	void UploadContext::AllocateDedicatedStaging(vk::DeviceSize size, StagingRegion& out)
+	{
+		DedicatedStaging staging{ this->NextValue };
+
+		this->MemManager.CreateBuffer(
+			staging.Buffer,
+			staging.Allocation,
+			size,
+			vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			MemoryCategory::Staging);
+
+		out.Buffer = staging.Buffer;
+		out.Offset = 0;
+		out.Size = size;
+		out.Data = this->MemManager.MapMemory(staging.Allocation);
+
+		this->DedicatedStagingBuffers.push_back(staging);
+	}
+
+	void UploadContext::FreeDedicatedStaging(uint64_t completed)
+	{
+		while (!this->DedicatedStagingBuffers.empty() && this->DedicatedStagingBuffers.front().Value <= completed)
+		{
+			auto& staging = this->DedicatedStagingBuffers.front();
+			this->MemManager.DestroyBuffer(staging.Buffer, staging.Allocation);
+			this->DedicatedStagingBuffers.pop_front();
+		}
+	}
+
+	void UploadContext::EnqueueBufferCopy(
+		vk::Buffer& dst,
+		vk::DeviceSize dstOffset,
+		const void* src,
+		vk::DeviceSize size)
+	{
+		const auto bytes = static_cast<const uint8_t*>(src);
+		vk::DeviceSize offset = 0;
+
+		while (offset < size)
+		{
+			const auto chunkSize = std::min(size - offset, this->Staging->MaxChunkSize());
+
+			StagingRegion region;
+			AllocateStaging(chunkSize, region);
+
+			std::memcpy(region.Data, bytes + offset, static_cast<size_t>(chunkSize));
+
+			this->BufferCopies.push_back({ dst, vk::BufferCopy(region.Offset, dstOffset + offset, chunkSize) });
+
+			offset += chunkSize;
+		}
+	}
+
+	void UploadContext::EnqueueImageCopy(
+		vk::Image& dst,
+		const void* src,
+		uint32_t width,
+		uint32_t height,
+		const TexelBlock& block,
+		uint32_t mipLevel)
+	{
+		const auto bytes = static_cast<const uint8_t*>(src);
+
+		// Everything below counts in blocks, which are single texels for uncompressed formats
+		const auto blocksWide = (width + block.Width - 1) / block.Width;
+		const auto blocksHigh = (height + block.Height - 1) / block.Height;
+		const vk::DeviceSize rowPitch = static_cast<vk::DeviceSize>(blocksWide) * block.Size;
+
+		auto rowsPerChunk = static_cast<uint32_t>(std::max<vk::DeviceSize>(1, this->Staging->MaxChunkSize() / rowPitch));
+
+		// Bands of rows have to respect the transfer queue's image granularity (given in blocks for
+		// compressed formats). A granularity of 0 means the queue can only copy whole mip levels.
+		if (this->ImageGranularity.height == 0)
+			rowsPerChunk = blocksHigh;
+		else if (rowsPerChunk < blocksHigh)
+			rowsPerChunk = std::max(this->ImageGranularity.height, rowsPerChunk - rowsPerChunk % this->ImageGranularity.height);
+
+		uint32_t row = 0;
+		while (row < blocksHigh)
+		{
+			const auto rows = std::min(rowsPerChunk, blocksHigh - row);
+			const auto chunkSize = rowPitch * rows;
+
+			// Whole levels on queues that can't copy bands may not fit the ring
+			StagingRegion region;
+			if (chunkSize > this->Staging->MaxChunkSize())
+				AllocateDedicatedStaging(chunkSize, region);
+			else
+				AllocateStaging(chunkSize, region);
+
+			std::memcpy(region.Data, bytes + rowPitch * row, static_cast<size_t>(chunkSize));
+
+			vk::BufferImageCopy copyRegion{};
+			copyRegion.bufferOffset = region.Offset;
+			copyRegion.bufferRowLength = 0;
+			copyRegion.bufferImageHeight = 0;
+
+			copyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+			copyRegion.imageSubresource.mipLevel = mipLevel;
+			copyRegion.imageSubresource.baseArrayLayer = 0;
+			copyRegion.imageSubresource.layerCount = 1;
+
+			// Back to texels, the last band of a compressed level may end in a partial block
+			const auto texelRow = row * block.Height;
+			copyRegion.imageOffset = vk::Offset3D{ 0, static_cast<int32_t>(texelRow), 0 };
+			copyRegion.imageExtent = vk::Extent3D{ width, std::min(rows * block.Height, height - texelRow), 1 };
+
+			this->ImageCopies.push_back({ region.Buffer, dst, copyRegion });
+
+			row += rows;
+		}
+	}
+
+	void UploadContext::EnqueueStagedImageCopy(
+		vk::Image& dst,
+		vk::Buffer src,
+		vk::DeviceSize srcOffset,
+		uint32_t width,
+		uint32_t height,
+		uint32_t mipLevel)
+	{
+		// Nothing to band up, the whole level is already in place
+		vk::BufferImageCopy copyRegion{};
+		copyRegion.bufferOffset = srcOffset;
+		copyRegion.bufferRowLength = 0;
+		copyRegion.bufferImageHeight = 0;
+
+		copyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+		copyRegion.imageSubresource.mipLevel = mipLevel;
+		copyRegion.imageSubresource.baseArrayLayer = 0;
+		copyRegion.imageSubresource.layerCount = 1;
+
+		copyRegion.imageOffset = vk::Offset3D{ 0, 0, 0 };
+		copyRegion.imageExtent = vk::Extent3D{ width, height, 1 };
+
+		this->ImageCopies.push_back({ src, dst, copyRegion });
+	}
+
+	void UploadContext::EnqueueImageTransition(
+		vk::Image& image,
+		vk::ImageLayout oldLayout,
+		vk::ImageLayout newLayout,
+		uint32_t mipLevels)
+	{
+		vk::ImageMemoryBarrier barrier{};
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		// Uploads only ever go undefined -> transfer dst -> shader read, anything else is a bug
+		if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eTransferDstOptimal)
+		{
+			barrier.srcAccessMask = vk::AccessFlagBits::eNone;
+			barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+
+			this->PreCopyBarriers.SrcStages |= vk::PipelineStageFlagBits::eTopOfPipe;
+			this->PreCopyBarriers.DstStages |= vk::PipelineStageFlagBits::eTransfer;
+			this->PreCopyBarriers.ImageBarriers.push_back(barrier);
+		}
+		else if (oldLayout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
+		{
+			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+			this->PostCopyBarriers.SrcStages |= vk::PipelineStageFlagBits::eTransfer;
+
+			if (NeedsOwnershipTransfer())
+			{
+				// Release half of the ownership transfer, the layout change happens as part of it
+				barrier.srcQueueFamilyIndex = this->TransferFamily;
+				barrier.dstQueueFamilyIndex = this->GraphicsFamily;
+				barrier.dstAccessMask = vk::AccessFlagBits::eNone;
+
+				this->PostCopyBarriers.DstStages |= vk::PipelineStageFlagBits::eBottomOfPipe;
+
+				auto acquire = barrier;
+				acquire.srcAccessMask = vk::AccessFlagBits::eNone;
+				acquire.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+				this->PendingAcquires.push_back({ this->NextValue, vk::PipelineStageFlagBits::eFragmentShader, std::nullopt, acquire });
+			}
+			else
+			{
+				barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+				this->PostCopyBarriers.DstStages |= vk::PipelineStageFlagBits::eFragmentShader;
+			}
+
+			this->PostCopyBarriers.ImageBarriers.push_back(barrier);
+		}
+		else
+			throw std::invalid_argument("Unsupported layout transition");
+	}
+
+	void UploadContext::EnqueueMipChain(
+		vk::Image& image,
+		uint32_t width,
+		uint32_t height,
+		uint32_t mipLevels)
+	{
+		if (!NeedsOwnershipTransfer())
+		{
+			this->MipChains.push_back({ image, width, height, mipLevels });
+			return;
+		}
+
+		// Hand the whole image over still in eTransferDstOptimal, the graphics side blits
+		vk::ImageMemoryBarrier release{};
+		release.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+		release.newLayout = vk::ImageLayout::eTransferDstOptimal;
+		release.srcQueueFamilyIndex = this->TransferFamily;
+		release.dstQueueFamilyIndex = this->GraphicsFamily;
+		release.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		release.dstAccessMask = vk::AccessFlagBits::eNone;
+
+		release.image = image;
+		release.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+		release.subresourceRange.baseMipLevel = 0;
+		release.subresourceRange.levelCount = mipLevels;
+		release.subresourceRange.baseArrayLayer = 0;
+		release.subresourceRange.layerCount = 1;
+
+		this->PostCopyBarriers.SrcStages |= vk::PipelineStageFlagBits::eTransfer;
+		this->PostCopyBarriers.DstStages |= vk::PipelineStageFlagBits::eBottomOfPipe;
+		this->PostCopyBarriers.ImageBarriers.push_back(release);
+
+		auto acquire = release;
+		acquire.srcAccessMask = vk::AccessFlagBits::eNone;
+		acquire.dstAccessMask = vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite;
+
+		this->PendingAcquires.push_back({ this->NextValue, vk::PipelineStageFlagBits::eTransfer, std::nullopt, acquire, QueuedMipChain{ image, width, height, mipLevels } });
+	}
+
+	void UploadContext::EnqueueBufferRelease(
+		vk::Buffer& buffer,
+		vk::PipelineStageFlags dstStage,
+		vk::AccessFlags dstAccess)
+	{
+		// Same family: the graphics submit waiting on the timeline makes the copy visible
+		if (!NeedsOwnershipTransfer())
+			return;
+
+		vk::BufferMemoryBarrier release(
+			vk::AccessFlagBits::eTransferWrite,
+			vk::AccessFlagBits::eNone,
+			this->TransferFamily,
+			this->GraphicsFamily,
+			buffer,
+			0,
+			VK_WHOLE_SIZE);
+
+		this->PostCopyBarriers.SrcStages |= vk::PipelineStageFlagBits::eTransfer;
+		this->PostCopyBarriers.DstStages |= vk::PipelineStageFlagBits::eBottomOfPipe;
+		this->PostCopyBarriers.BufferBarriers.push_back(release);
+
+		auto acquire = release;
+		acquire.srcAccessMask = vk::AccessFlagBits::eNone;
+		acquire.dstAccessMask = dstAccess;
+
+		this->PendingAcquires.push_back({ this->NextValue, dstStage, acquire, std::nullopt });
+	}
+
+	UploadTicket UploadContext::UploadBuffer(
+		vk::Buffer& dst,
+		const void* src,
+		vk::DeviceSize size,
+		vk::PipelineStageFlags dstStage,
+		vk::AccessFlags dstAccess)
+	{
+		EnqueueBufferCopy(dst, 0, src, size);
+		EnqueueBufferRelease(dst, dstStage, dstAccess);
+
+		return CurrentTicket();
+	}
+
+	UploadTicket UploadContext::UploadImage(
+		vk::Image& dst,
+		const void* src,
+		uint32_t width,
+		uint32_t height,
+		uint32_t texelSize,
+		uint32_t mipLevels)
+	{
+		EnqueueImageTransition(dst, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, mipLevels);
+		EnqueueImageCopy(dst, src, width, height, TexelBlock{ texelSize });
+
+		if (mipLevels > 1)
+			EnqueueMipChain(dst, width, height, mipLevels);
+		else
+			EnqueueImageTransition(dst, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+		return CurrentTicket();
+	}
+
+	UploadTicket UploadContext::UploadImageLevels(
+		vk::Image& dst,
+		std::span<const void* const> levels,
+		uint32_t width,
+		uint32_t height,
+		const TexelBlock& block)
+	{
+		const auto mipLevels = static_cast<uint32_t>(levels.size());
+
+		EnqueueImageTransition(dst, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, mipLevels);
+
+		for (uint32_t level = 0; level < mipLevels; level++)
+			EnqueueImageCopy(dst, levels[level], std::max(1u, width >> level), std::max(1u, height >> level), block, level);
+
+		EnqueueImageTransition(dst, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, mipLevels);
+
+		return CurrentTicket();
+	}
+
+	UploadTicket UploadContext::UploadStagedImage(
+		vk::Image& dst,
+		DecodeStagingAllocation& staged,
+		std::span<const void* const> levels,
+		uint32_t width,
+		uint32_t height,
+		const TexelBlock& block,
+		uint32_t mipLevels)
+	{
+		const auto base = static_cast<const uint8_t*>(staged.Region.Data);
+		const auto levelCount = static_cast<uint32_t>(levels.size());
+
+		if (levelCount == 0 || (levelCount < mipLevels && levelCount != 1))
+			throw std::invalid_argument("Staged uploads need every level, or just level 0 to blit from.");
+
+		// Copy offsets have to be a multiple of the block size, and of 4
+		for (const auto* level : levels)
+		{
+			const auto offset = static_cast<vk::DeviceSize>(static_cast<const uint8_t*>(level) - base);
+			if (offset >= staged.Region.Size || (staged.Region.Offset + offset) % std::max(4u, block.Size) != 0)
+				throw std::invalid_argument("Staged level isn't a suitably aligned part of the allocation.");
+		}
+
+		EnqueueImageTransition(dst, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, mipLevels);
+
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			const auto offset = static_cast<vk::DeviceSize>(static_cast<const uint8_t*>(levels[level]) - base);
+			EnqueueStagedImageCopy(dst, staged.Region.Buffer, staged.Region.Offset + offset,
+				std::max(1u, width >> level), std::max(1u, height >> level), level);
+		}
+
+		if (levelCount < mipLevels)
+			EnqueueMipChain(dst, width, height, mipLevels);
+		else
+			EnqueueImageTransition(dst, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, mipLevels);
+
+		// Nothing above flushes, so the copies all land in the batch this ticket belongs to
+		const auto ticket = CurrentTicket();
+		staged.Retire(ticket.Value);
+
+		return ticket;
+	}
+
+	void UploadContext::Wait(const UploadTicket& ticket)
+	{
+		if (ticket.Value >= this->NextValue)
+			Flush();
+
+		vk::SemaphoreWaitInfo waitInfo({}, 1, &this->Timeline, &ticket.Value);
+		vk::resultCheck(this->LogicalDevice.waitSemaphores(waitInfo, UINT64_MAX),
+			"Failed to wait for upload.");
+	}
+
+	void UploadContext::RecordAcquires(vk::CommandBuffer& commandBuffer)
+	{
+		const auto completed = CompletedValue();
+
+		UploadBarrierBatch acquires;
+		acquires.SrcStages = vk::PipelineStageFlagBits::eTopOfPipe;
+
+		std::vector<QueuedMipChain> mipChains;
+
+		// Only pick up uploads that have already finished, so the wait on the timeline never stalls
+		auto it = std::remove_if(this->PendingAcquires.begin(), this->PendingAcquires.end(),
+			[&](const PendingAcquire& acquire)
+			{
+				if (acquire.Value > completed)
+					return false;
+
+				if (acquire.BufferBarrier.has_value())
+					acquires.BufferBarriers.push_back(acquire.BufferBarrier.value());
+				if (acquire.ImageBarrier.has_value())
+					acquires.ImageBarriers.push_back(acquire.ImageBarrier.value());
+
+				if (acquire.Mips.has_value())
+					mipChains.push_back(acquire.Mips.value());
+
+				acquires.DstStages |= acquire.DstStage;
+				return true;
+			});
+		this->PendingAcquires.erase(it, this->PendingAcquires.end());
+
+		acquires.Record(commandBuffer);
+
+		for (const auto& chain : mipChains)
+			RecordMipChain(commandBuffer, chain.Image, chain.Width, chain.Height, chain.MipLevels);
+
+		this->AcquiredValue = std::max(this->AcquiredValue, completed);
+
+		this->Staging->Reclaim();
+		this->DecodeStaging->Reclaim(completed);
+		RecycleCommandBuffers();
+	}
+
+	void UploadContext::Destroy()
+	{
+		Flush();
+
+		Wait(UploadTicket{ this->NextValue - 1 });
+		RecycleCommandBuffers();
+
+		this->Staging->Destroy();
+		this->DecodeStaging->Destroy();
+
+		this->LogicalDevice.destroySemaphore(this->Timeline);
+		this->LogicalDevice.destroyCommandPool(this->CommandPool);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <span>
+#include <cstdint>
+
+#include "renderer/queue.h"
+#include "renderer/vulkanmem.h"
+#include "renderer/staging.h"
+
+namespace Engine
+{
+	// Bytes per texel, or per block (and the block's size in texels) for block compressed formats
+	struct TexelBlock
+	{
+		uint32_t Size;
+		uint32_t Width = 1;
+		uint32_t Height = 1;
+	};
+
+	// Handed out by UploadContext. The upload is done once the upload timeline reaches Value.
+	struct UploadTicket
+	{
+		uint64_t Value = 0;
+	};
+
+	// Barriers for one phase of a batch, recorded as a single pipelineBarrier
+	struct UploadBarrierBatch
+	{
+		vk::PipelineStageFlags SrcStages;
+		vk::PipelineStageFlags DstStages;
+		std::vector<vk::BufferMemoryBarrier> BufferBarriers;
+		std::vector<vk::ImageMemoryBarrier> ImageBarriers;
+
+		bool Empty() const
+		{
+			return this->BufferBarriers.empty() && this->ImageBarriers.empty();
+		}
+
+		void Record(vk::CommandBuffer& commandBuffer);
+		void Clear();
+	};
+
+	// Fills levels 1..mipLevels-1 of image from level 0 with linear blits, which needs a graphics
+	// queue. Expects every level in eTransferDstOptimal and leaves all of them in
+	// eShaderReadOnlyOptimal, visible to fragment shaders.
+	void RecordMipChain(vk::CommandBuffer& commandBuffer, vk::Image image, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+	// Batches copies for the transfer queue and signals a timeline semaphore when they finish.
+	// Copies and layout transitions are queued up and Flush records the whole batch into one
+	// command buffer as [pre-copy barriers][copies][post-copy barriers] and submits it once.
+	// If the transfer queue is a different family from graphics, resources are released on the
+	// transfer queue and RecordAcquires picks them up on the graphics side.
+	class UploadContext
+	{
+	private:
+		struct QueuedBufferCopy
+		{
+			vk::Buffer Dst;
+			vk::BufferCopy Region;
+		};
+
+		struct QueuedImageCopy
+		{
+			vk::Buffer Src;
+			vk::Image Dst;
+			vk::BufferImageCopy Region;
+		};
+
+		struct QueuedMipChain
+		{
+			vk::Image Image;
+			uint32_t Width;
+			uint32_t Height;
+			uint32_t MipLevels;
+		};
+
+		struct InFlightSubmit
+		{
+			uint64_t Value;
+			vk::CommandBuffer CommandBuffer;
+		};
+
+		// One-off staging for a chunk too big for the ring, freed once Value has passed
+		struct DedicatedStaging
+		{
+			uint64_t Value;
+			vk::Buffer Buffer;
+			MemAllocation Allocation;
+		};
+
+		// Graphics side half of a queue family ownership transfer
+		struct PendingAcquire
+		{
+			uint64_t Value;
+			vk::PipelineStageFlags DstStage;
+			std::optional<vk::BufferMemoryBarrier> BufferBarrier;
+			std::optional<vk::ImageMemoryBarrier> ImageBarrier;
+
+			// Mips the transfer queue couldn't blit, generated right after the acquire
+			std::optional<QueuedMipChain> Mips;
+		};
+
+		vk::Device& LogicalDevice;
+		VulkanMemManager& MemManager;
+		VulkanQueues& Queues;
+
+		uint32_t TransferFamily;
+		uint32_t GraphicsFamily;
+		vk::Extent3D ImageGranularity;
+
+		vk::CommandPool CommandPool;
+
+		vk::Semaphore Timeline;
+		uint64_t NextValue = 1;
+
+		// Everything up to this value has been acquired by a graphics command buffer
+		uint64_t AcquiredValue = 0;
+
+		std::unique_ptr<StagingRing> Staging;
+
+		// Decode workers write here directly, see UploadStagedImage
+		std::unique_ptr<DecodeStagingRing> DecodeStaging;
+
+		std::deque<InFlightSubmit> InFlight;
+		std::deque<DedicatedStaging> DedicatedStagingBuffers;
+		std::vector<PendingAcquire> PendingAcquires;
+
+		// The batch the next Flush submits
+		UploadBarrierBatch PreCopyBarriers;
+		std::vector<QueuedBufferCopy> BufferCopies;
+		std::vector<QueuedImageCopy> ImageCopies;
+		std::vector<QueuedMipChain> MipChains;
+		UploadBarrierBatch PostCopyBarriers;
+
+		bool NeedsOwnershipTransfer() const
+		{
+			return this->TransferFamily != this->GraphicsFamily;
+		}
+
+		bool HasQueuedWork() const
+		{
+			return !this->PreCopyBarriers.Empty()
+				|| !this->BufferCopies.empty()
+				|| !this->ImageCopies.empty()
+				|| !this->MipChains.empty()
+				|| !this->PostCopyBarriers.Empty();
+		}
+
+		// Stage a chunk, flushing the batch if the ring is full of it
+		void AllocateStaging(vk::DeviceSize size, StagingRegion& out);
+
+		// For chunks that can't be split to fit the ring, e.g. whole levels on a queue without
+		// a row granularity. Lives until the batch being queued has run.
+		void AllocateDedicatedStaging(vk::DeviceSize size, StagingRegion& out);
+
+		// Frees dedicated staging the timeline has passed
+		void FreeDedicatedStaging(uint64_t completed);
+
+		void RecycleCommandBuffers();
+
+	public:
+		// Stage size bytes and queue a copy into dst at dstOffset
+		void EnqueueBufferCopy(
+			vk::Buffer& dst,
+			vk::DeviceSize dstOffset,
+			const void* src,
+			vk::DeviceSize size);
+
+		// Stage a tightly packed image level and queue copies into dst, which must be in
+		// eTransferDstOptimal by the time the batch runs. width/height are the level's own size
+		// in texels. Large levels are split into bands of (block) rows, or staged on their own if
+		// the queue can't copy partial levels.
+		void EnqueueImageCopy(
+			vk::Image& dst,
+			const void* src,
+			uint32_t width,
+			uint32_t height,
+			const TexelBlock& block,
+			uint32_t mipLevel = 0);
+
+		// Queue a copy of a whole level that's already sitting in staging memory, e.g. decode staging
+		void EnqueueStagedImageCopy(
+			vk::Image& dst,
+			vk::Buffer src,
+			vk::DeviceSize srcOffset,
+			uint32_t width,
+			uint32_t height,
+			uint32_t mipLevel = 0);
+
+		// eUndefined -> eTransferDstOptimal goes before the copies, eTransferDstOptimal ->
+		// eShaderReadOnlyOptimal after them (as an ownership release if needed)
+		void EnqueueImageTransition(
+			vk::Image& image,
+			vk::ImageLayout oldLayout,
+			vk::ImageLayout newLayout,
+			uint32_t mipLevels = 1);
+
+		// Generate the rest of the mip chain from level 0 once its copies have run, and take the
+		// image to eShaderReadOnlyOptimal. Blits need a graphics queue, so if the transfer queue
+		// is a different family the image is released as is and the blits run after the acquire.
+		void EnqueueMipChain(
+			vk::Image& image,
+			uint32_t width,
+			uint32_t height,
+			uint32_t mipLevels);
+
+		// Release a buffer written by this batch to the graphics queue
+		void EnqueueBufferRelease(
+			vk::Buffer& buffer,
+			vk::PipelineStageFlags dstStage,
+			vk::AccessFlags dstAccess);
+
+		// Ticket for everything queued so far, valid once the next Flush has run
+		UploadTicket CurrentTicket() const
+		{
+			return UploadTicket{ this->NextValue };
+		}
+
+		// Records the queued batch into one command buffer and submits it. No-op if nothing is queued.
+		void Flush();
+
+		// Queue a whole buffer upload. dstStage/dstAccess describe how the graphics queue will consume it.
+		UploadTicket UploadBuffer(
+			vk::Buffer& dst,
+			const void* src,
+			vk::DeviceSize size,
+			vk::PipelineStageFlags dstStage,
+			vk::AccessFlags dstAccess);
+
+		// Takes dst from eUndefined to eShaderReadOnlyOptimal. With mipLevels > 1 the rest of the
+		// chain is blitted from src, so the format must support linear blits.
+		UploadTicket UploadImage(
+			vk::Image& dst,
+			const void* src,
+			uint32_t width,
+			uint32_t height,
+			uint32_t texelSize,
+			uint32_t mipLevels = 1);
+
+		// Same, but every level comes from the caller. levels[i] is level i, tightly packed.
+		// Works for block compressed formats.
+		UploadTicket UploadImageLevels(
+			vk::Image& dst,
+			std::span<const void* const> levels,
+			uint32_t width,
+			uint32_t height,
+			const TexelBlock& block);
+
+		// Same as UploadImageLevels, but the levels were decoded straight into staged and are copied
+		// from there. Given only level 0, the rest of mipLevels are blitted from it. staged is
+		// retired to this upload's ticket.
+		UploadTicket UploadStagedImage(
+			vk::Image& dst,
+			DecodeStagingAllocation& staged,
+			std::span<const void* const> levels,
+			uint32_t width,
+			uint32_t height,
+			const TexelBlock& block,
+			uint32_t mipLevels);
+
+		// Safe to allocate from on any thread
+		DecodeStagingRing& GetDecodeStaging()
+		{
+			return *this->DecodeStaging;
+		}
+
+		uint64_t CompletedValue()
+		{
+			return this->LogicalDevice.getSemaphoreCounterValue(this->Timeline);
+		}
+
+		// The copy has finished on the transfer queue
+		bool IsComplete(const UploadTicket& ticket)
+		{
+			return ticket.Value <= CompletedValue();
+		}
+
+		// The resource has been acquired by a graphics command buffer and can be drawn with
+		// in that command buffer and anything submitted after it
+		bool IsResident(const UploadTicket& ticket) const
+		{
+			return ticket.Value <= this->AcquiredValue;
+		}
+
+		// Flushes first if the ticket belongs to the batch that's still being queued
+		void Wait(const UploadTicket& ticket);
+
+		// Records ownership acquires for every finished upload into a graphics command buffer.
+		// The submit has to wait on Timeline at GetAcquiredValue().
+		void RecordAcquires(vk::CommandBuffer& commandBuffer);
+
+		uint64_t GetAcquiredValue() const
+		{
+			return this->AcquiredValue;
+		}
+
+		vk::Semaphore GetTimeline() const
+		{
+			return this->Timeline;
+		}
+
+		void Destroy();
+
+		UploadContext(
+			vk::Device& device,
+			vk::PhysicalDevice& physicalDevice,
+			VulkanMemManager& memManager,
+			VulkanQueues& queues,
+			const QueueFamilyIndices& indices);
+	};
+}
\ No newline at end of file
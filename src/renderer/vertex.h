@@ -21,6 +21,8 @@ namespace Engine
 		glm::vec2 texCoord;
 
 		constexpr static vk::BufferUsageFlagBits BufferType = vk::BufferUsageFlagBits::eVertexBuffer;
+		constexpr static vk::AccessFlagBits AccessType = vk::AccessFlagBits::eVertexAttributeRead;
+		constexpr static MemoryCategory Category = MemoryCategory::Vertex;
 
 		constexpr static void GetBindingDescription(vk::VertexInputBindingDescription& bindingDescription)
 		{
@@ -48,11 +50,44 @@ namespace Engine
 		}
 	};
 
+	// Per instance attributes, binding 1 stepped once per instance. The model matrix takes up a
+	// location per column.
+	struct InstanceData
+	{
+		glm::mat4 model;
+		uint32_t textureIndex;
+
+		constexpr static void GetBindingDescription(vk::VertexInputBindingDescription& bindingDescription)
+		{
+			bindingDescription.binding = 1;
+			bindingDescription.stride = sizeof(InstanceData);
+			bindingDescription.inputRate = vk::VertexInputRate::eInstance;
+		}
+
+		constexpr static void GetAttributeDescriptions(std::array<vk::VertexInputAttributeDescription, 5>& attributeDescriptions)
+		{
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				attributeDescriptions[i].binding = 1;
+				attributeDescriptions[i].location = 3 + i;
+				attributeDescriptions[i].format = vk::Format::eR32G32B32A32Sfloat; // vec4
+				attributeDescriptions[i].offset = offsetof(InstanceData, model) + sizeof(glm::vec4) * i;
+			}
+
+			attributeDescriptions[4].binding = 1;
+			attributeDescriptions[4].location = 7;
+			attributeDescriptions[4].format = vk::Format::eR32Uint; // uint
+			attributeDescriptions[4].offset = offsetof(InstanceData, textureIndex);
+		}
+	};
+
 	struct Index
 	{
 		uint32_t index;
 
 		constexpr static vk::BufferUsageFlagBits BufferType = vk::BufferUsageFlagBits::eIndexBuffer;
+		constexpr static vk::AccessFlagBits AccessType = vk::AccessFlagBits::eIndexRead;
+		constexpr static MemoryCategory Category = MemoryCategory::Index;
 		constexpr static vk::IndexType IndexType = vk::IndexType::eUint32;
 
 		constexpr Index(uint32_t idx) : index(idx) {}
@@ -67,43 +102,44 @@ namespace Engine
 	public:
 		std::vector<T> Objects;
 		vk::Buffer Buffer;
-		vk::DeviceMemory BufferMemory;
+		MemAllocation BufferAllocation;
+		vk::DeviceSize BufferSize = 0;
 
+		// Transfer source so the defragmenter can copy it somewhere else
+		constexpr static vk::BufferUsageFlags Usage = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc | T::BufferType;
+
+		// Don't draw with Buffer until the uploader says this is resident
+		UploadTicket Ticket;
+
+		// Freed once the frames in flight are done with it
 		void Destroy()
 		{
-			this->DeviceContext->MemManager->DestroyBuffer(this->Buffer, this->BufferMemory);
+			this->DeviceContext->Deletion->DeferBuffer(this->Buffer, this->BufferAllocation);
+
+			this->Buffer = VK_NULL_HANDLE;
+			this->BufferAllocation = MemAllocation{};
 		}
 
 		VertexInputBuffer(std::shared_ptr<VulkanDeviceContext> devCtx, const std::vector<T>& verts)
 			: Objects(verts), DeviceContext(devCtx)
 		{
 			const vk::DeviceSize bufferSize = sizeof(Objects[0]) * Objects.size();
-
-			// Create staging buffer
-			vk::Buffer stagingBuffer;
-			vk::DeviceMemory stagingBufferMemory;
-			this->DeviceContext->MemManager->CreateBuffer(
-				stagingBuffer,
-				stagingBufferMemory,
-				bufferSize,
-				vk::BufferUsageFlagBits::eTransferSrc,
-				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-
-			// Copy vertices to staging buffer
-			auto data = this->DeviceContext->MemManager->MapMemory(stagingBufferMemory, 0, bufferSize);
-			std::memcpy(data, Objects.data(), static_cast<size_t>(bufferSize));
-			this->DeviceContext->MemManager->UnmapMemory(stagingBufferMemory);
+			this->BufferSize = bufferSize;
 
 			this->DeviceContext->MemManager->CreateBuffer(
 				this->Buffer,
-				this->BufferMemory,
+				this->BufferAllocation,
 				bufferSize,
-				vk::BufferUsageFlagBits::eTransferDst | T::BufferType,
-				vk::MemoryPropertyFlagBits::eDeviceLocal);
+				Usage,
+				vk::MemoryPropertyFlagBits::eDeviceLocal,
+				T::Category);
 
-			this->DeviceContext->MemManager->CopyBuffer(this->Buffer, stagingBuffer, bufferSize);
-
-			this->DeviceContext->MemManager->DestroyBuffer(stagingBuffer, stagingBufferMemory);
+			this->Ticket = this->DeviceContext->Uploader->UploadBuffer(
+				this->Buffer, 
+				Objects.data(), 
+				bufferSize,
+				vk::PipelineStageFlagBits::eVertexInput,
+				T::AccessType);
 		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,395 @@
+#include "renderer/vulkanallocator.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace Engine
+{
+	// Large heaps get fixed size blocks, small heaps (e.g. the 256MB BAR heap) get a fraction
+	constexpr vk::DeviceSize LargeHeapThreshold = 1024ull * 1024 * 1024;
+	constexpr vk::DeviceSize LargeHeapBlockSize = 256ull * 1024 * 1024;
+
+	static constexpr vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Do the last byte of one resource and the first byte of another fall on the same page?
+	static constexpr bool OnSamePage(vk::DeviceSize endA, vk::DeviceSize startB, vk::DeviceSize pageSize)
+	{
+		return (endA & ~(pageSize - 1)) == (startB & ~(pageSize - 1));
+	}
+
+	bool VulkanMemBlock::TryAllocate(
+		vk::DeviceSize size,
+		vk::DeviceSize alignment,
+		AllocationKind kind,
+		vk::DeviceSize granularity,
+		vk::DeviceSize& outOffset)
+	{
+		size_t bestIndex = this->Ranges.size();
+		vk::DeviceSize bestOffset = 0;
+		vk::DeviceSize bestLeftover = std::numeric_limits<vk::DeviceSize>::max();
+
+		// Best fit over the free ranges
+		for (size_t i = 0; i < this->Ranges.size(); i++)
+		{
+			const auto& range = this->Ranges[i];
+			if (!range.Free || range.Size < size)
+				continue;
+
+			auto offset = AlignUp(range.Offset, alignment);
+
+			if (i > 0)
+			{
+				const auto& prev = this->Ranges[i - 1];
+				if (!prev.Free && prev.Kind != kind && OnSamePage(prev.Offset + prev.Size - 1, offset, granularity))
+					offset = AlignUp(offset, granularity);
+			}
+
+			if (offset + size > range.Offset + range.Size)
+				continue;
+
+			if (i + 1 < this->Ranges.size())
+			{
+				const auto& next = this->Ranges[i + 1];
+				if (!next.Free && next.Kind != kind && OnSamePage(offset + size - 1, next.Offset, granularity))
+					continue;
+			}
+
+			auto leftover = range.Offset + range.Size - (offset + size);
+			if (leftover < bestLeftover)
+			{
+				bestIndex = i;
+				bestOffset = offset;
+				bestLeftover = leftover;
+
+				if (leftover == 0)
+					break;
+			}
+		}
+
+		if (bestIndex == this->Ranges.size())
+			return false;
+
+		// Split [padding][allocation][leftover]
+		const auto range = this->Ranges[bestIndex];
+		const auto padding = bestOffset - range.Offset;
+
+		std::vector<Range> split;
+		if (padding > 0)
+			split.push_back({ range.Offset, padding, true, AllocationKind::Linear });
+		split.push_back({ bestOffset, size, false, kind });
+		if (bestLeftover > 0)
+			split.push_back({ bestOffset + size, bestLeftover, true, AllocationKind::Linear });
+
+		this->Ranges.erase(this->Ranges.begin() + bestIndex);
+		this->Ranges.insert(this->Ranges.begin() + bestIndex, split.begin(), split.end());
+
+		this->UsedBytes += size;
+		this->AllocationCount++;
+
+		outOffset = bestOffset;
+		return true;
+	}
+
+	void VulkanMemBlock::Free(vk::DeviceSize offset)
+	{
+		auto it = std::lower_bound(this->Ranges.begin(), this->Ranges.end(), offset,
+			[](const Range& range, vk::DeviceSize value) { return range.Offset < value; });
+
+		if (it == this->Ranges.end() || it->Offset != offset || it->Free)
+			throw std::invalid_argument("Freeing a range that was never allocated.");
+
+		it->Free = true;
+		this->UsedBytes -= it->Size;
+		this->AllocationCount--;
+
+		// Coalesce with the right neighbour, then the left
+		auto next = it + 1;
+		if (next != this->Ranges.end() && next->Free)
+		{
+			it->Size += next->Size;
+			it = this->Ranges.erase(next) - 1;
+		}
+
+		if (it != this->Ranges.begin())
+		{
+			auto prev = it - 1;
+			if (prev->Free)
+			{
+				prev->Size += it->Size;
+				this->Ranges.erase(it);
+			}
+		}
+	}
+
+	VulkanAllocator::VulkanAllocator(vk::Device& device, vk::PhysicalDevice& physicalDevice) :
+		LogicalDevice(device),
+		PhysicalDevice(physicalDevice)
+	{
+		this->MemoryProperties = this->PhysicalDevice.getMemoryProperties();
+
+		auto limits = this->PhysicalDevice.getProperties().limits;
+		this->BufferImageGranularity = limits.bufferImageGranularity;
+		this->MaxAllocationCount = limits.maxMemoryAllocationCount;
+	}
+
+	uint32_t VulkanAllocator::FindMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties)
+	{
+		for (uint32_t i = 0; i < this->MemoryProperties.memoryTypeCount; i++)
+		{
+			if ((typeFilter & (1 << i)) &&
+				((this->MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties))
+			{
+				return i;
+			}
+		}
+
+		throw std::runtime_error("Failed to find suitable memory type.");
+	}
+
+	vk::DeviceSize VulkanAllocator::PreferredBlockSize(uint32_t memoryType)
+	{
+		auto heapIndex = this->MemoryProperties.memoryTypes[memoryType].heapIndex;
+		auto heapSize = this->MemoryProperties.memoryHeaps[heapIndex].size;
+
+		if (heapSize > LargeHeapThreshold)
+			return LargeHeapBlockSize;
+
+		return AlignUp(heapSize / 8, 32);
+	}
+
+	VulkanMemBlock* VulkanAllocator::CreateBlock(uint32_t memoryType, vk::DeviceSize size, bool dedicated)
+	{
+		if (this->DeviceAllocationCount >= this->MaxAllocationCount)
+			throw std::runtime_error("Exceeded maxMemoryAllocationCount.");
+
+		vk::MemoryAllocateInfo allocInfo(size, memoryType);
+		auto memory = this->LogicalDevice.allocateMemory(allocInfo);
+
+		// Host visible blocks stay mapped for their whole lifetime
+		void* mapped = nullptr;
+		if (this->MemoryProperties.memoryTypes[memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)
+			mapped = this->LogicalDevice.mapMemory(memory, 0, VK_WHOLE_SIZE);
+
+		this->DeviceAllocationCount++;
+
+		auto& blocks = this->Blocks[memoryType];
+		blocks.push_back(std::make_unique<VulkanMemBlock>(memory, size, memoryType, mapped, dedicated));
+
+		return blocks.back().get();
+	}
+
+	void VulkanAllocator::DestroyBlock(uint32_t memoryType, VulkanMemBlock* block)
+	{
+		if (block->MappedData)
+			this->LogicalDevice.unmapMemory(block->Memory);
+
+		this->LogicalDevice.freeMemory(block->Memory);
+		this->DeviceAllocationCount--;
+
+		auto& blocks = this->Blocks[memoryType];
+		blocks.erase(std::find_if(blocks.begin(), blocks.end(),
+			[block](const auto& b) { return b.get() == block; }));
+	}
+
+	void VulkanAllocator::FillAllocation(VulkanMemBlock* block, vk::DeviceSize offset, vk::DeviceSize size, MemoryCategory category, MemAllocation& out)
+	{
+		out.Memory = block->Memory;
+		out.Offset = offset;
+		out.Size = size;
+		out.MemoryType = block->MemoryType;
+		out.Category = category;
+		out.MappedData = block->MappedData ? static_cast<uint8_t*>(block->MappedData) + offset : nullptr;
+		out.Block = block;
+
+		this->Categories[static_cast<size_t>(category)].Add(size);
+	}
+
+	void VulkanAllocator::Allocate(
+		const vk::MemoryRequirements& memoryRequirements,
+		vk::MemoryPropertyFlags properties,
+		AllocationKind kind,
+		MemoryCategory category,
+		MemAllocation& out)
+	{
+		auto memoryType = FindMemoryType(memoryRequirements.memoryTypeBits, properties);
+		auto blockSize = PreferredBlockSize(memoryType);
+
+		VulkanMemBlock* block = nullptr;
+		vk::DeviceSize offset = 0;
+
+		// Anything bigger than half a block gets its own allocation, it would only fragment the shared ones
+		if (memoryRequirements.size > blockSize / 2)
+		{
+			block = CreateBlock(memoryType, memoryRequirements.size, true);
+			block->TryAllocate(memoryRequirements.size, 1, kind, this->BufferImageGranularity, offset);
+		}
+		else
+		{
+			for (auto& candidate : this->Blocks[memoryType])
+			{
+				if (candidate->Dedicated)
+					continue;
+
+				if (candidate->TryAllocate(memoryRequirements.size, memoryRequirements.alignment, kind, this->BufferImageGranularity, offset))
+				{
+					block = candidate.get();
+					break;
+				}
+			}
+
+			if (!block)
+			{
+				block = CreateBlock(memoryType, blockSize, false);
+				if (!block->TryAllocate(memoryRequirements.size, memoryRequirements.alignment, kind, this->BufferImageGranularity, offset))
+					throw std::runtime_error("Failed to sub-allocate from a fresh memory block.");
+			}
+		}
+
+		FillAllocation(block, offset, memoryRequirements.size, category, out);
+	}
+
+	void VulkanAllocator::Free(MemAllocation& allocation)
+	{
+		auto block = allocation.Block;
+		if (!block)
+			return;
+
+		block->Free(allocation.Offset);
+
+		this->Categories[static_cast<size_t>(allocation.Category)].Remove(allocation.Size);
+
+		if (block->IsEmpty())
+		{
+			// Keep one empty shared block around per memory type so alloc/free churn
+			// doesn't turn into vkAllocateMemory/vkFreeMemory churn
+			auto& blocks = this->Blocks[block->MemoryType];
+			auto emptyShared = std::count_if(blocks.begin(), blocks.end(),
+				[](const auto& b) { return !b->Dedicated && b->IsEmpty(); });
+
+			if (block->Dedicated || emptyShared > 1)
+				DestroyBlock(block->MemoryType, block);
+		}
+
+		allocation = MemAllocation{};
+	}
+
+	bool VulkanAllocator::AllocateForMove(
+		const vk::MemoryRequirements& memoryRequirements,
+		const MemAllocation& current,
+		AllocationKind kind,
+		MemAllocation& out)
+	{
+		const auto memoryType = current.MemoryType;
+		if (!(memoryRequirements.memoryTypeBits & (1 << memoryType)) || !current.Block)
+			return false;
+
+		std::vector<VulkanMemBlock*> candidates;
+		for (auto& block : this->Blocks[memoryType])
+		{
+			if (!block->Dedicated && block.get() != current.Block && block->UsedBytes > current.Block->UsedBytes)
+				candidates.push_back(block.get());
+		}
+
+		// Fullest first, so the emptier blocks drain
+		std::sort(candidates.begin(), candidates.end(),
+			[](const VulkanMemBlock* a, const VulkanMemBlock* b) { return a->UsedBytes > b->UsedBytes; });
+
+		for (auto block : candidates)
+		{
+			vk::DeviceSize offset = 0;
+			if (!block->TryAllocate(memoryRequirements.size, memoryRequirements.alignment, kind, this->BufferImageGranularity, offset))
+				continue;
+
+			FillAllocation(block, offset, memoryRequirements.size, current.Category, out);
+			return true;
+		}
+
+		return false;
+	}
+
+	VulkanMemBlock* VulkanAllocator::PickCompactionSource(uint32_t memoryType)
+	{
+		VulkanMemBlock* source = nullptr;
+		uint32_t inUse = 0;
+
+		for (auto& block : this->Blocks[memoryType])
+		{
+			if (block->Dedicated || block->IsEmpty())
+				continue;
+
+			inUse++;
+
+			if (!source || block->UsedBytes < source->UsedBytes)
+				source = block.get();
+		}
+
+		return inUse > 1 ? source : nullptr;
+	}
+
+	void VulkanAllocator::TrackExternal(MemoryCategory category, vk::DeviceSize size)
+	{
+		this->Categories[static_cast<size_t>(category)].Add(size);
+	}
+
+	void VulkanAllocator::UntrackExternal(MemoryCategory category, vk::DeviceSize size)
+	{
+		this->Categories[static_cast<size_t>(category)].Remove(size);
+	}
+
+	void VulkanAllocator::GetStats(AllocatorStats& stats)
+	{
+		stats = AllocatorStats{};
+
+		for (uint32_t type = 0; type < this->MemoryProperties.memoryTypeCount; type++)
+		{
+			auto& typeStats = stats.MemoryTypes[type];
+
+			for (const auto& block : this->Blocks[type])
+			{
+				typeStats.BlockCount++;
+				typeStats.AllocationCount += block->AllocationCount;
+				typeStats.BlockBytes += block->Size;
+				typeStats.UsedBytes += block->UsedBytes;
+
+				for (const auto& range : block->Ranges)
+				{
+					if (!range.Free)
+						continue;
+
+					typeStats.FreeRangeCount++;
+					typeStats.LargestFreeRange = std::max(typeStats.LargestFreeRange, range.Size);
+				}
+			}
+
+			stats.Total.BlockCount += typeStats.BlockCount;
+			stats.Total.AllocationCount += typeStats.AllocationCount;
+			stats.Total.FreeRangeCount += typeStats.FreeRangeCount;
+			stats.Total.BlockBytes += typeStats.BlockBytes;
+			stats.Total.UsedBytes += typeStats.UsedBytes;
+			stats.Total.LargestFreeRange = std::max(stats.Total.LargestFreeRange, typeStats.LargestFreeRange);
+		}
+
+		stats.DeviceAllocationCount = this->DeviceAllocationCount;
+	}
+
+	void VulkanAllocator::Destroy()
+	{
+		for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; type++)
+		{
+			for (auto& block : this->Blocks[type])
+			{
+				if (block->MappedData)
+					this->LogicalDevice.unmapMemory(block->Memory);
+
+				this->LogicalDevice.freeMemory(block->Memory);
+			}
+
+			this->Blocks[type].clear();
+		}
+
+		this->DeviceAllocationCount = 0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "renderer/memstats.h"
+
+namespace Engine
+{
+	// Buffers and linear images must not share a bufferImageGranularity "page"
+	// with optimal images, so every range remembers what kind of resource lives in it.
+	enum class AllocationKind : uint8_t
+	{
+		Linear,
+		Optimal
+	};
+
+	class VulkanMemBlock;
+
+	// A sub-allocated range of a VulkanMemBlock. Resources bind to Memory at Offset.
+	struct MemAllocation
+	{
+		vk::DeviceMemory Memory = VK_NULL_HANDLE;
+		vk::DeviceSize Offset = 0;
+		vk::DeviceSize Size = 0;
+		uint32_t MemoryType = 0;
+		MemoryCategory Category = MemoryCategory::Count;
+
+		// Non-null when the owning block is host visible (blocks are persistently mapped)
+		void* MappedData = nullptr;
+
+		VulkanMemBlock* Block = nullptr;
+	};
+
+	// One vkAllocateMemory call, carved up into ranges.
+	class VulkanMemBlock
+	{
+	public:
+		struct Range
+		{
+			vk::DeviceSize Offset;
+			vk::DeviceSize Size;
+			bool Free;
+			AllocationKind Kind;
+		};
+
+		vk::DeviceMemory Memory = VK_NULL_HANDLE;
+		vk::DeviceSize Size = 0;
+		uint32_t MemoryType = 0;
+		void* MappedData = nullptr;
+
+		// Dedicated blocks hold exactly one resource and are freed with it
+		bool Dedicated = false;
+
+		// Sorted by offset and always covers the whole block. Adjacent free ranges are
+		// merged on free, so a free range never has a free neighbour.
+		std::vector<Range> Ranges;
+
+		vk::DeviceSize UsedBytes = 0;
+		uint32_t AllocationCount = 0;
+
+		bool TryAllocate(
+			vk::DeviceSize size,
+			vk::DeviceSize alignment,
+			AllocationKind kind,
+			vk::DeviceSize granularity,
+			vk::DeviceSize& outOffset);
+
+		void Free(vk::DeviceSize offset);
+
+		bool IsEmpty() const
+		{
+			return this->AllocationCount == 0;
+		}
+
+		VulkanMemBlock(vk::DeviceMemory memory, vk::DeviceSize size, uint32_t memoryType, void* mapped, bool dedicated) :
+			Memory(memory),
+			Size(size),
+			MemoryType(memoryType),
+			MappedData(mapped),
+			Dedicated(dedicated)
+		{
+			this->Ranges.push_back({ 0, size, true, AllocationKind::Linear });
+		}
+	};
+
+	class VulkanAllocator
+	{
+	private:
+		vk::Device& LogicalDevice;
+		vk::PhysicalDevice& PhysicalDevice;
+
+		vk::PhysicalDeviceMemoryProperties MemoryProperties;
+		vk::DeviceSize BufferImageGranularity;
+		uint32_t MaxAllocationCount;
+		uint32_t DeviceAllocationCount = 0;
+
+		std::array<std::vector<std::unique_ptr<VulkanMemBlock>>, VK_MAX_MEMORY_TYPES> Blocks;
+
+		std::array<MemCounter, MemoryCategoryCount> Categories;
+
+		uint32_t FindMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties);
+		vk::DeviceSize PreferredBlockSize(uint32_t memoryType);
+
+		VulkanMemBlock* CreateBlock(uint32_t memoryType, vk::DeviceSize size, bool dedicated);
+		void DestroyBlock(uint32_t memoryType, VulkanMemBlock* block);
+		void FillAllocation(VulkanMemBlock* block, vk::DeviceSize offset, vk::DeviceSize size, MemoryCategory category, MemAllocation& out);
+
+	public:
+		void Allocate(
+			const vk::MemoryRequirements& memoryRequirements,
+			vk::MemoryPropertyFlags properties,
+			AllocationKind kind,
+			MemoryCategory category,
+			MemAllocation& out);
+
+		void Free(MemAllocation& allocation);
+
+		// Sub-allocates for a resource that currently lives in current, from an existing shared
+		// block of the same memory type that is fuller than current's block. Never creates a
+		// block, so resources only ever move towards the blocks that are already busy.
+		bool AllocateForMove(
+			const vk::MemoryRequirements& memoryRequirements,
+			const MemAllocation& current,
+			AllocationKind kind,
+			MemAllocation& out);
+
+		// Least used non-empty shared block of memoryType, if there's another one worth
+		// packing it into. Null when the type is already as compact as it gets.
+		VulkanMemBlock* PickCompactionSource(uint32_t memoryType);
+
+		// For memory the driver allocates behind our back (swapchain images), so it
+		// still shows up under its category. Not part of any heap or type totals.
+		void TrackExternal(MemoryCategory category, vk::DeviceSize size);
+		void UntrackExternal(MemoryCategory category, vk::DeviceSize size);
+
+		void GetStats(AllocatorStats& stats);
+
+		void GetCategoryStats(std::array<MemCounter, MemoryCategoryCount>& categories)
+		{
+			categories = this->Categories;
+		}
+
+		const vk::PhysicalDeviceMemoryProperties& GetMemoryProperties() const
+		{
+			return this->MemoryProperties;
+		}
+
+		void Destroy();
+
+		VulkanAllocator(vk::Device& device, vk::PhysicalDevice& physicalDevice);
+	};
+}
\ No newline at end of file
@@ -1,7 +1,53 @@
 #include "renderer/vulkandevicecontext.h"
+#include "renderer/texturecache.h"
 
 namespace Engine
 {
+	VulkanDeviceContext::VulkanDeviceContext(GLFWwindow* Window, bool EnableValidationLayers) :
+		ValidationLayersEnabled(EnableValidationLayers)
+	{
+		CreateVulkanInstance();
+		CreateRenderSurface(Window);
+		PickPhysicalDevice();
+		CreateLogicalDevice();
+
+		this->MemManager = std::make_unique<VulkanMemManager>(this->LogicalDevice, this->PhysicalDevice, this->MemoryBudgetSupported);
+		this->Uploader = std::make_unique<UploadContext>(this->LogicalDevice, this->PhysicalDevice, *this->MemManager, this->Queues, this->QueueFamilies);
+		this->Frames = std::make_unique<FrameTimeline>(this->LogicalDevice);
+		this->Deletion = std::make_unique<DeletionQueue>(this->LogicalDevice, *this->MemManager, *this->Frames);
+		this->Samplers = std::make_unique<SamplerCache>(this->LogicalDevice, this->PhysicalDeviceProperties.limits);
+		this->Textures = std::make_unique<TextureCache>(*this);
+	}
+
+	VulkanDeviceContext::~VulkanDeviceContext()
+	{
+		// Joins the decode workers. Cached images hold this context, so the cache has
+		// to be destroyed by whoever owns them before we can get here.
+		this->Textures.reset();
+
+		// Anything still waiting on a frame, the device is idle by now
+		this->Deletion->Flush();
+
+		// Frame timeline
+		this->Frames->Destroy();
+
+		// Samplers
+		this->Samplers->Destroy();
+
+		// Uploads
+		this->Uploader->Destroy();
+
+		// Device memory blocks
+		this->MemManager->Destroy();
+
+		// Surface
+		this->VulkanInstance.destroySurfaceKHR(this->Surface);
+
+		// Device and instance
+		this->LogicalDevice.destroy();
+		this->VulkanInstance.destroy();
+	}
+
 	void VulkanDeviceContext::QuerySwapChainSupport(const vk::PhysicalDevice& device, const vk::SurfaceKHR& surface, SwapChainSupportDetails& details)
 	{
 		vk::resultCheck(device.getSurfaceCapabilitiesKHR(surface, &details.Capabilities),
@@ -47,7 +93,7 @@ namespace Engine
 			VK_MAKE_VERSION(1, 0, 0),
 			"No Engine",
 			VK_MAKE_VERSION(1, 0, 0),
-			VK_API_VERSION_1_0);
+			VK_API_VERSION_1_2);
 
 		uint32_t glfwExtensionCount = 0;
 		auto glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
@@ -105,12 +151,24 @@ namespace Engine
 			swapChainAdequate = !details.Formats.empty() && !details.PresentModes.empty();
 		}
 
-		auto supportedFeatures = device.getFeatures();
+		// Timeline semaphores and descriptor indexing are core in 1.2
+		if (device.getProperties().apiVersion < VK_API_VERSION_1_2)
+			return false;
+
+		auto features = device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+		const auto& supportedFeatures = features.get<vk::PhysicalDeviceFeatures2>().features;
+		const auto& supportedFeatures12 = features.get<vk::PhysicalDeviceVulkan12Features>();
 
 		return indices.IsComplete() 
 			&& extensionsSupported 
 			&& swapChainAdequate
-			&& supportedFeatures.samplerAnisotropy;
+			&& supportedFeatures.samplerAnisotropy
+			&& supportedFeatures.drawIndirectFirstInstance
+			&& supportedFeatures12.timelineSemaphore
+			&& supportedFeatures12.runtimeDescriptorArray
+			&& supportedFeatures12.descriptorBindingPartiallyBound
+			&& supportedFeatures12.descriptorBindingSampledImageUpdateAfterBind
+			&& supportedFeatures12.shaderSampledImageArrayNonUniformIndexing;
 	}
 
 	void VulkanDeviceContext::PickPhysicalDevice()
@@ -131,11 +189,14 @@ namespace Engine
 
 	void VulkanDeviceContext::CreateLogicalDevice()
 	{
-		QueueFamilyIndices indices;
+		auto& indices = this->QueueFamilies;
 
 		indices.FindQueueFamilies(this->PhysicalDevice, this->Surface);
 
-		const std::unordered_set<uint32_t> uniqueQueueFamilies = { indices.GraphicsFamily.value(), indices.PresentationFamily.value() };
+		const std::unordered_set<uint32_t> uniqueQueueFamilies = { 
+			indices.GraphicsFamily.value(), 
+			indices.PresentationFamily.value(),
+			indices.TransferFamily.value() };
 
 		std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
 
@@ -156,14 +217,63 @@ namespace Engine
 		// Enable anisotropy
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+		// GPU culling writes indirect draws that start at an instance offset. Drawing them all in
+		// one call needs multi draw indirect, or the draw count from the buffer, both optional.
+		auto supported = this->PhysicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+		this->MultiDrawIndirectSupported = supported.get<vk::PhysicalDeviceFeatures2>().features.multiDrawIndirect;
+		this->DrawIndirectCountSupported = supported.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount;
+
+		deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+		deviceFeatures.multiDrawIndirect = this->MultiDrawIndirectSupported;
+
+		// Upload completion is tracked with a timeline semaphore
+		vk::PhysicalDeviceVulkan12Features deviceFeatures12{};
+		deviceFeatures12.timelineSemaphore = VK_TRUE;
+		deviceFeatures12.drawIndirectCount = this->DrawIndirectCountSupported;
+
+		// Bindless texture table
+		deviceFeatures12.runtimeDescriptorArray = VK_TRUE;
+		deviceFeatures12.descriptorBindingPartiallyBound = VK_TRUE;
+		deviceFeatures12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		deviceFeatures12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+
+		std::vector<const char*> extensions(this->DeviceExtentions.begin(), this->DeviceExtentions.end());
+
+		// Driver side budget/usage numbers for the memory report
+		this->MemoryBudgetSupported = CheckDeviceExtensionSupport(this->PhysicalDevice, std::span{ this->MemoryBudgetExtension });
+		if (this->MemoryBudgetSupported)
+			extensions.insert(extensions.end(), this->MemoryBudgetExtension.begin(), this->MemoryBudgetExtension.end());
+
+		// Lets the frame pacing wait until a frame is actually on screen
+		vk::PhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+		vk::PhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+		if (CheckDeviceExtensionSupport(this->PhysicalDevice, std::span{ this->PresentWaitExtensions }))
+		{
+			auto features = this->PhysicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>();
+
+			this->PresentWaitSupported = features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId
+				&& features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+		}
+
+		if (this->PresentWaitSupported)
+		{
+			extensions.insert(extensions.end(), this->PresentWaitExtensions.begin(), this->PresentWaitExtensions.end());
+
+			presentIdFeatures.presentId = VK_TRUE;
+			presentWaitFeatures.presentWait = VK_TRUE;
+			presentIdFeatures.pNext = &presentWaitFeatures;
+			deviceFeatures12.pNext = &presentIdFeatures;
+		}
+
 		vk::DeviceCreateInfo createInfo(
 			{},
 			queueCreateInfos.size(),
 			queueCreateInfos.data(),
 			0, nullptr,
-			this->DeviceExtentions.size(),
-			this->DeviceExtentions.data(),
+			extensions.size(),
+			extensions.data(),
 			&deviceFeatures);
+		createInfo.pNext = &deviceFeatures12;
 
 		// This is here for compatibility with older implementations
 		if (this->ValidationLayersEnabled)
@@ -177,18 +287,12 @@ namespace Engine
 
 		// Get queues
 		Queues.GetQueues(this->LogicalDevice, indices);
-	}
-
-	void VulkanDeviceContext::CreateCommandPool()
-	{
-		QueueFamilyIndices queueFamilyIndices;
-		queueFamilyIndices.FindQueueFamilies(this->PhysicalDevice, this->Surface);
 
-		vk::CommandPoolCreateInfo poolInfo(
-			vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
-			queueFamilyIndices.GraphicsFamily.value());
-
-		this->CommandPool = this->LogicalDevice.createCommandPool(poolInfo);
+		if (this->PresentWaitSupported)
+		{
+			this->WaitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(this->LogicalDevice.getProcAddr("vkWaitForPresentKHR"));
+			this->PresentWaitSupported = this->WaitForPresent != nullptr;
+		}
 	}
 
 	void VulkanDeviceContext::CreateRenderSurface(GLFWwindow* Window)
@@ -12,10 +12,16 @@
 #include <unordered_set>
 
 #include "renderer/vulkanmem.h"
+#include "renderer/upload.h"
+#include "renderer/frametimeline.h"
+#include "renderer/deletion.h"
+#include "renderer/sampler.h"
 #include "renderer/queue.h"
 
 namespace Engine
 {
+	class TextureCache;
+
 	struct SwapChainSupportDetails
 	{
 		vk::SurfaceCapabilitiesKHR Capabilities;
@@ -23,7 +29,8 @@ namespace Engine
 		std::vector<vk::PresentModeKHR> PresentModes;
 	};
 
-	class VulkanDeviceContext
+	// Always owned by a shared_ptr, images loaded through the texture cache hold one
+	class VulkanDeviceContext : public std::enable_shared_from_this<VulkanDeviceContext>
 	{
 	private:
 		/*
@@ -36,6 +43,15 @@ namespace Engine
 			VK_KHR_SWAPCHAIN_EXTENSION_NAME
 		};
 
+		// Enabled when the device has them, nothing depends on them being there
+		const std::array<const char*, 1> MemoryBudgetExtension = {
+			VK_EXT_MEMORY_BUDGET_EXTENSION_NAME
+		};
+		const std::array<const char*, 2> PresentWaitExtensions = {
+			VK_KHR_PRESENT_ID_EXTENSION_NAME,
+			VK_KHR_PRESENT_WAIT_EXTENSION_NAME
+		};
+
 		template<std::size_t N>
 		bool CheckVulkanLayerSupport(std::span<const char* const, N> layers);
 		template<std::size_t N>
@@ -44,7 +60,6 @@ namespace Engine
 		bool IsPhysicalDeviceSuitable(const vk::PhysicalDevice& device);
 		void PickPhysicalDevice();
 		void CreateLogicalDevice();
-		void CreateCommandPool();
 		void CreateRenderSurface(GLFWwindow* Window);
 
 	public:
@@ -53,9 +68,25 @@ namespace Engine
 		
 		vk::Device LogicalDevice;
 		std::unique_ptr<VulkanMemManager> MemManager;
-		vk::CommandPool CommandPool;
+		std::unique_ptr<UploadContext> Uploader;
+		std::unique_ptr<FrameTimeline> Frames;
+		std::unique_ptr<DeletionQueue> Deletion;
+		std::unique_ptr<SamplerCache> Samplers;
+		std::unique_ptr<TextureCache> Textures;
 
+		QueueFamilyIndices QueueFamilies;
 		VulkanQueues Queues;
+
+		bool MemoryBudgetSupported = false;
+
+		// vkCmdDrawIndexedIndirectCount and more than one draw per indirect call
+		bool DrawIndirectCountSupported = false;
+		bool MultiDrawIndirectSupported = false;
+
+		// Set if VK_KHR_present_wait is enabled. It isn't exported by the loader, so it's fetched
+		// from the device. Presents then take a VkPresentIdKHR.
+		bool PresentWaitSupported = false;
+		PFN_vkWaitForPresentKHR WaitForPresent = nullptr;
 		vk::SurfaceKHR Surface;
 
 		vk::Instance VulkanInstance;
@@ -63,30 +94,8 @@ namespace Engine
 
 		static void QuerySwapChainSupport(const vk::PhysicalDevice& device, const vk::SurfaceKHR& surface, SwapChainSupportDetails& details);
 
-		VulkanDeviceContext(GLFWwindow* Window, bool EnableValidationLayers) :
-			ValidationLayersEnabled(EnableValidationLayers)
-		{
-			CreateVulkanInstance();
-			CreateRenderSurface(Window);
-			PickPhysicalDevice();
-			CreateLogicalDevice();
-
-			CreateCommandPool();
-
-			this->MemManager = std::make_unique<VulkanMemManager>(this->LogicalDevice, this->PhysicalDevice, this->CommandPool, this->Queues);
-		}
-
-		~VulkanDeviceContext()
-		{
-			// Command pool
-			this->LogicalDevice.destroyCommandPool(this->CommandPool);
-
-			// Surface
-			this->VulkanInstance.destroySurfaceKHR(this->Surface);
-
-			// Device and instance
-			this->LogicalDevice.destroy();
-			this->VulkanInstance.destroy();
-		}
+		// Both out of line, TextureCache is incomplete here
+		VulkanDeviceContext(GLFWwindow* Window, bool EnableValidationLayers);
+		~VulkanDeviceContext();
 	};
 }
\ No newline at end of file
@@ -2,43 +2,93 @@
 
 namespace Engine
 {
-	uint32_t VulkanMemManager::FindMemoryType(vk::PhysicalDevice& device, uint32_t typeFilter, vk::MemoryPropertyFlags properties)
+	static vk::ImageCreateInfo MakeImageInfo(
+		uint32_t width,
+		uint32_t height,
+		uint32_t mipLevels,
+		vk::Format format,
+		vk::ImageTiling tiling,
+		vk::ImageUsageFlags usage)
+	{
+		vk::ImageCreateInfo imageInfo{};
+		imageInfo.imageType = vk::ImageType::e2D;
+		imageInfo.extent.width = width;
+		imageInfo.extent.height = height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = mipLevels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = format;
+		imageInfo.tiling = tiling;
+		imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+		imageInfo.usage = usage;
+		imageInfo.samples = vk::SampleCountFlagBits::e1;
+		imageInfo.sharingMode = vk::SharingMode::eExclusive;
+
+		return imageInfo;
+	}
+
+	void VulkanMemManager::AllocMemory(const vk::MemoryRequirements& memoryRequirements, vk::MemoryPropertyFlags properties, AllocationKind kind, MemoryCategory category, MemAllocation& out)
+	{
+		this->Allocator->Allocate(memoryRequirements, properties, kind, category, out);
+	}
+
+	void VulkanMemManager::GetReport(MemoryReport& report)
 	{
-		auto memProperties = device.getMemoryProperties();
+		report = MemoryReport{};
 
+		const auto& memProperties = this->Allocator->GetMemoryProperties();
+
+		this->Allocator->GetStats(report.Allocator);
+		this->Allocator->GetCategoryStats(report.Categories);
+
+		report.Heaps.resize(memProperties.memoryHeapCount);
+		for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++)
+		{
+			report.Heaps[i].Size = memProperties.memoryHeaps[i].size;
+			report.Heaps[i].DeviceLocal = static_cast<bool>(memProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+		}
+
+		report.MemoryTypeCount = memProperties.memoryTypeCount;
 		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
 		{
-			if ((typeFilter & (1 << i)) &&
-				((memProperties.memoryTypes[i].propertyFlags & properties) == properties))
-			{
-				return i;
-			}
+			const auto heapIndex = memProperties.memoryTypes[i].heapIndex;
+			const auto& typeStats = report.Allocator.MemoryTypes[i];
+			auto& heap = report.Heaps[heapIndex];
+
+			report.MemoryTypeHeaps[i] = heapIndex;
+
+			heap.BlockBytes += typeStats.BlockBytes;
+			heap.UsedBytes += typeStats.UsedBytes;
+			heap.AllocationCount += typeStats.AllocationCount;
 		}
 
-		throw std::runtime_error("Failed to find suitable memory type.");
-	}
+		report.BudgetSupported = this->BudgetSupported;
+		if (!this->BudgetSupported)
+			return;
 
-	void VulkanMemManager::AllocMemory(const vk::MemoryRequirements& memoryRequirements, vk::MemoryPropertyFlags properties, vk::DeviceMemory& out)
-	{
-		vk::MemoryAllocateInfo allocInfo(
-			memoryRequirements.size,
-			FindMemoryType(this->PhysicalDevice, memoryRequirements.memoryTypeBits, properties));
+		auto properties = this->PhysicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+		const auto& budget = properties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
 
-		out = this->LogicalDevice.allocateMemory(allocInfo);
+		for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++)
+		{
+			report.Heaps[i].Budget = budget.heapBudget[i];
+			report.Heaps[i].Usage = budget.heapUsage[i];
+		}
 	}
 
-	void VulkanMemManager::DestroyBuffer(vk::Buffer& buffer, vk::DeviceMemory& deviceMemory)
+	void VulkanMemManager::DestroyBuffer(vk::Buffer& buffer, MemAllocation& allocation)
 	{
 		this->LogicalDevice.destroyBuffer(buffer);
-		this->LogicalDevice.freeMemory(deviceMemory);
+		this->Allocator->Free(allocation);
 	}
 
 	void VulkanMemManager::CreateBuffer(
 		vk::Buffer& buffer,
-		vk::DeviceMemory& bufferMemory,
+		MemAllocation& allocation,
 		vk::DeviceSize size,
 		vk::BufferUsageFlags usage,
-		vk::MemoryPropertyFlags properties)
+		vk::MemoryPropertyFlags properties,
+		MemoryCategory category)
 	{
 		vk::BufferCreateInfo bufferInfo(
 			{},
@@ -49,168 +99,98 @@ namespace Engine
 
 		auto memRequirements = this->LogicalDevice.getBufferMemoryRequirements(buffer);
 
-		AllocMemory(memRequirements, properties, bufferMemory);
+		AllocMemory(memRequirements, properties, AllocationKind::Linear, category, allocation);
 
-		this->LogicalDevice.bindBufferMemory(buffer, bufferMemory, 0);
+		this->LogicalDevice.bindBufferMemory(buffer, allocation.Memory, allocation.Offset);
 	}
 
-	void VulkanMemManager::BeginOneTimeCommands(vk::CommandBuffer& out)
+	void VulkanMemManager::DestroyImage(vk::Image& image, MemAllocation& allocation)
 	{
-		out = this->LogicalDevice.allocateCommandBuffers(this->CommandBufferAllocInfo).front(); // TODO: This is retarded
-
-		vk::CommandBufferBeginInfo beginInfo(
-			vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-		out.begin(beginInfo);
+		this->LogicalDevice.destroyImage(image);
+		this->Allocator->Free(allocation);
 	}
 
-	void VulkanMemManager::EndOneTimeCommands(vk::CommandBuffer& commandBuffer)
+	void VulkanMemManager::CreateImage(
+		vk::Image& image,
+		MemAllocation& allocation,
+		uint32_t width,
+		uint32_t height,
+		uint32_t mipLevels,
+		vk::Format format,
+		vk::ImageTiling tiling,
+		vk::ImageUsageFlags usage,
+		vk::MemoryPropertyFlags properties,
+		MemoryCategory category)
 	{
-		commandBuffer.end();
-
-		vk::SubmitInfo submitInfo{};
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-
-		// TODO: Maybe use fence here?
-		this->Queues.GraphicsQueue.submit(1, &submitInfo, VK_NULL_HANDLE);
-		this->Queues.GraphicsQueue.waitIdle();
+		auto imageInfo = MakeImageInfo(width, height, mipLevels, format, tiling, usage);
 
-		this->LogicalDevice.freeCommandBuffers(this->CommandPool, 1, &commandBuffer);
-	}
+		image = this->LogicalDevice.createImage(imageInfo);
 
-	void VulkanMemManager::CopyBuffer(
-		vk::Buffer& dst,
-		vk::Buffer& src,
-		vk::DeviceSize size)
-	{
-		vk::CommandBuffer commandBuffer;
-		BeginOneTimeCommands(commandBuffer);
+		auto memRequirements = this->LogicalDevice.getImageMemoryRequirements(image);
 
-		vk::BufferCopy copyRegion(0, 0, size);
-		commandBuffer.copyBuffer(src, dst, 1, &copyRegion);
+		auto kind = tiling == vk::ImageTiling::eOptimal ? AllocationKind::Optimal : AllocationKind::Linear;
+		AllocMemory(memRequirements, properties, kind, category, allocation);
 
-		EndOneTimeCommands(commandBuffer);
+		this->LogicalDevice.bindImageMemory(image, allocation.Memory, allocation.Offset);
 	}
 
-	void VulkanMemManager::CopyBufferToImage(
-		vk::Image& dst, 
-		vk::Buffer& src, 
-		uint32_t width, 
-		uint32_t height)
+	bool VulkanMemManager::RelocateBuffer(
+		vk::Buffer& buffer,
+		MemAllocation& allocation,
+		vk::DeviceSize size,
+		vk::BufferUsageFlags usage,
+		const MemAllocation& current)
 	{
-		vk::CommandBuffer commandBuffer;
-		BeginOneTimeCommands(commandBuffer);
-
-		vk::BufferImageCopy region{};
-		region.bufferOffset = 0;
-		region.bufferRowLength = 0;
-		region.bufferImageHeight = 0;
-
-		region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-		region.imageSubresource.mipLevel = 0;
-		region.imageSubresource.baseArrayLayer = 0;
-		region.imageSubresource.layerCount = 1;
-
-		region.imageOffset = vk::Offset3D{ 0, 0, 0 };
-		region.imageExtent = vk::Extent3D{ width, height, 1 };
-
-		commandBuffer.copyBufferToImage(src, dst, vk::ImageLayout::eTransferDstOptimal, 1, &region);
+		vk::BufferCreateInfo bufferInfo(
+			{},
+			size,
+			usage);
 
-		EndOneTimeCommands(commandBuffer);
-	}
+		auto newBuffer = this->LogicalDevice.createBuffer(bufferInfo);
 
-	void VulkanMemManager::TransitionImageLayout(
-		vk::Image& image, 
-		vk::Format format, 
-		vk::ImageLayout oldLayout, 
-		vk::ImageLayout newLayout)
-	{
-		vk::CommandBuffer commandBuffer;
-		BeginOneTimeCommands(commandBuffer);
-
-		vk::ImageMemoryBarrier barrier{};
-		barrier.oldLayout = oldLayout;
-		barrier.newLayout = newLayout;
-		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-		barrier.image = image;
-		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-		barrier.subresourceRange.baseMipLevel = 0;
-		barrier.subresourceRange.levelCount = 1;
-		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount = 1;
-
-		vk::PipelineStageFlags srcStage;
-		vk::PipelineStageFlags dstStage;
-
-		// TODO: Find a more elegant way of doing this
-		if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eTransferDstOptimal)
-		{
-			barrier.srcAccessMask = vk::AccessFlagBits::eNone;
-			barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+		auto memRequirements = this->LogicalDevice.getBufferMemoryRequirements(newBuffer);
 
-			srcStage = vk::PipelineStageFlagBits::eTopOfPipe;
-			dstStage = vk::PipelineStageFlagBits::eTransfer;
-		}
-		else if (oldLayout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
+		MemAllocation newAllocation;
+		if (!this->Allocator->AllocateForMove(memRequirements, current, AllocationKind::Linear, newAllocation))
 		{
-			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-			barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-
-			srcStage = vk::PipelineStageFlagBits::eTransfer;
-			dstStage = vk::PipelineStageFlagBits::eFragmentShader;
+			this->LogicalDevice.destroyBuffer(newBuffer);
+			return false;
 		}
-		else
-			throw std::invalid_argument("Unsupported layout transition");
-
-		commandBuffer.pipelineBarrier(
-			srcStage,
-			dstStage,
-			{},
-			0, nullptr,
-			0, nullptr,
-			1, &barrier);
 
-		EndOneTimeCommands(commandBuffer);
-	}
+		this->LogicalDevice.bindBufferMemory(newBuffer, newAllocation.Memory, newAllocation.Offset);
 
-	void VulkanMemManager::DestroyImage(vk::Image& image, vk::DeviceMemory& imageMemory)
-	{
-		this->LogicalDevice.destroyImage(image);
-		this->LogicalDevice.freeMemory(imageMemory);
+		buffer = newBuffer;
+		allocation = newAllocation;
+		return true;
 	}
 
-	void VulkanMemManager::CreateImage(
+	bool VulkanMemManager::RelocateImage(
 		vk::Image& image,
-		vk::DeviceMemory& imageMemory,
+		MemAllocation& allocation,
 		uint32_t width,
 		uint32_t height,
+		uint32_t mipLevels,
 		vk::Format format,
-		vk::ImageTiling tiling,
 		vk::ImageUsageFlags usage,
-		vk::MemoryPropertyFlags properties)
+		const MemAllocation& current)
 	{
-		vk::ImageCreateInfo imageInfo{};
-		imageInfo.imageType = vk::ImageType::e2D;
-		imageInfo.extent.width = width;
-		imageInfo.extent.height = height;
-		imageInfo.extent.depth = 1;
-		imageInfo.mipLevels = 1;
-		imageInfo.arrayLayers = 1;
-		imageInfo.format = format;
-		imageInfo.tiling = tiling;
-		imageInfo.initialLayout = vk::ImageLayout::eUndefined;
-		imageInfo.usage = usage;
-		imageInfo.samples = vk::SampleCountFlagBits::e1;
-		imageInfo.sharingMode = vk::SharingMode::eExclusive;
+		auto imageInfo = MakeImageInfo(width, height, mipLevels, format, vk::ImageTiling::eOptimal, usage);
 
-		image = this->LogicalDevice.createImage(imageInfo);
+		auto newImage = this->LogicalDevice.createImage(imageInfo);
 
-		auto memRequirements = this->LogicalDevice.getImageMemoryRequirements(image);
+		auto memRequirements = this->LogicalDevice.getImageMemoryRequirements(newImage);
+
+		MemAllocation newAllocation;
+		if (!this->Allocator->AllocateForMove(memRequirements, current, AllocationKind::Optimal, newAllocation))
+		{
+			this->LogicalDevice.destroyImage(newImage);
+			return false;
+		}
 
-		AllocMemory(memRequirements, properties, imageMemory);
+		this->LogicalDevice.bindImageMemory(newImage, newAllocation.Memory, newAllocation.Offset);
 
-		this->LogicalDevice.bindImageMemory(image, imageMemory, 0);
+		image = newImage;
+		allocation = newAllocation;
+		return true;
 	}
 }
\ No newline at end of file
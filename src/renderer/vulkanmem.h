@@ -3,8 +3,9 @@
 #include <vulkan/vulkan.hpp>
 
 #include <cstdint>
+#include <memory>
 
-#include "renderer/queue.h"
+#include "renderer/vulkanallocator.h"
 
 namespace Engine
 {
@@ -13,84 +14,123 @@ namespace Engine
 	private:
 		vk::Device& LogicalDevice;
 		vk::PhysicalDevice& PhysicalDevice;
-		vk::CommandPool& CommandPool;
-		VulkanQueues& Queues;
 
-		// TODO: SET ME FREE
-		vk::CommandBufferAllocateInfo CommandBufferAllocInfo;
+		std::unique_ptr<VulkanAllocator> Allocator;
 
-		uint32_t FindMemoryType(vk::PhysicalDevice& device, uint32_t typeFilter, vk::MemoryPropertyFlags properties);
+		// VK_EXT_memory_budget was enabled on the device
+		bool BudgetSupported;
 
-		void AllocMemory(const vk::MemoryRequirements& memoryRequirements, vk::MemoryPropertyFlags properties, vk::DeviceMemory& out);
-
-		// TODO: THESE DONT BELONG HERE
-		void BeginOneTimeCommands(vk::CommandBuffer& out);
-		void EndOneTimeCommands(vk::CommandBuffer& commandBuffer);
+		void AllocMemory(const vk::MemoryRequirements& memoryRequirements, vk::MemoryPropertyFlags properties, AllocationKind kind, MemoryCategory category, MemAllocation& out);
 
 	public:
-		void* MapMemory(vk::DeviceMemory& memory, vk::DeviceSize offset, vk::DeviceSize size)
+		// Host visible blocks are persistently mapped, so this is just a pointer into the block
+		void* MapMemory(const MemAllocation& allocation)
+		{
+			if (!allocation.MappedData)
+				throw std::runtime_error("Tried to map device memory that isn't host visible.");
+
+			return allocation.MappedData;
+		}
+
+		void GetStats(AllocatorStats& stats)
+		{
+			this->Allocator->GetStats(stats);
+		}
+
+		// Per heap, per memory type and per category numbers, with the driver's budget if available
+		void GetReport(MemoryReport& report);
+
+		void TrackExternal(MemoryCategory category, vk::DeviceSize size)
+		{
+			this->Allocator->TrackExternal(category, size);
+		}
+
+		void UntrackExternal(MemoryCategory category, vk::DeviceSize size)
 		{
-			return this->LogicalDevice.mapMemory(memory, offset, size);
+			this->Allocator->UntrackExternal(category, size);
 		}
 
-		void UnmapMemory(vk::DeviceMemory& memory)
+		// Raw memory for resources the caller creates and binds itself, e.g. images aliasing each other
+		void AllocateMemory(const vk::MemoryRequirements& memoryRequirements, vk::MemoryPropertyFlags properties, MemoryCategory category, MemAllocation& out)
 		{
-			this->LogicalDevice.unmapMemory(memory);
+			AllocMemory(memoryRequirements, properties, AllocationKind::Optimal, category, out);
 		}
 
-		void DestroyBuffer(vk::Buffer& buffer, vk::DeviceMemory& deviceMemory);
+		void FreeMemory(MemAllocation& allocation)
+		{
+			this->Allocator->Free(allocation);
+		}
+
+		void DestroyBuffer(vk::Buffer& buffer, MemAllocation& allocation);
 
 		void CreateBuffer(
 			vk::Buffer& buffer, 
-			vk::DeviceMemory& bufferMemory, 
+			MemAllocation& allocation, 
 			vk::DeviceSize size, 
 			vk::BufferUsageFlags usage, 
-			vk::MemoryPropertyFlags properties);
-
-		void CopyBuffer(
-			vk::Buffer& dst,
-			vk::Buffer& src,
-			vk::DeviceSize size);
+			vk::MemoryPropertyFlags properties,
+			MemoryCategory category);
 
-		void CopyBufferToImage(
-			vk::Image& dst, 
-			vk::Buffer& src, 
-			uint32_t width, 
-			uint32_t height);
-
-		void DestroyImage(vk::Image& image, vk::DeviceMemory& imageMemory);
+		void DestroyImage(vk::Image& image, MemAllocation& allocation);
 
 		void CreateImage(
 			vk::Image& image,
-			vk::DeviceMemory& imageMemory,
+			MemAllocation& allocation,
 			uint32_t width,
 			uint32_t height, 
+			uint32_t mipLevels,
 			vk::Format format, 
 			vk::ImageTiling tiling,
 			vk::ImageUsageFlags usage,
-			vk::MemoryPropertyFlags properties);
+			vk::MemoryPropertyFlags properties,
+			MemoryCategory category);
 
-		void TransitionImageLayout(
-			vk::Image& image, 
-			vk::Format format, 
-			vk::ImageLayout oldLayout, 
-			vk::ImageLayout newLayout);
+		// Defragmentation support. The Relocate* functions create a new resource with the same
+		// description as the one backed by current, in a fuller block of the same memory type.
+		// They return false (and leave everything untouched) when there's no room for it.
+		VulkanMemBlock* PickCompactionSource(uint32_t memoryType)
+		{
+			return this->Allocator->PickCompactionSource(memoryType);
+		}
+
+		const vk::PhysicalDeviceMemoryProperties& GetMemoryProperties() const
+		{
+			return this->Allocator->GetMemoryProperties();
+		}
+
+		bool RelocateBuffer(
+			vk::Buffer& buffer,
+			MemAllocation& allocation,
+			vk::DeviceSize size,
+			vk::BufferUsageFlags usage,
+			const MemAllocation& current);
+
+		bool RelocateImage(
+			vk::Image& image,
+			MemAllocation& allocation,
+			uint32_t width,
+			uint32_t height,
+			uint32_t mipLevels,
+			vk::Format format,
+			vk::ImageUsageFlags usage,
+			const MemAllocation& current);
+
+		// Must run before the logical device is destroyed
+		void Destroy()
+		{
+			this->Allocator->Destroy();
+		}
 
 		VulkanMemManager() = delete;
 
-		constexpr VulkanMemManager(
+		VulkanMemManager(
 			vk::Device& device, 
-			vk::PhysicalDevice& physicalDevice, 
-			vk::CommandPool& commandPool,
-			VulkanQueues& queues) : 
+			vk::PhysicalDevice& physicalDevice,
+			bool budgetSupported) : 
 		LogicalDevice(device),
 		PhysicalDevice(physicalDevice),
-		CommandPool(commandPool),
-		Queues(queues) 
-		{
-			this->CommandBufferAllocInfo.level = vk::CommandBufferLevel::ePrimary;
-			this->CommandBufferAllocInfo.commandPool = CommandPool;
-			this->CommandBufferAllocInfo.commandBufferCount = 1;
-		};
+		Allocator(std::make_unique<VulkanAllocator>(device, physicalDevice)),
+		BudgetSupported(budgetSupported)
+		{};
 	};
 }
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+namespace Engine
+{
+	ThreadPool::ThreadPool(uint32_t threadCount)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+		this->Workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++)
+			this->Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard lock(this->Mutex);
+			this->Stopping = true;
+		}
+		this->JobAvailable.notify_all();
+
+		for (auto& worker : this->Workers)
+			worker.join();
+	}
+
+	void ThreadPool::Submit(std::function<void()> job)
+	{
+		{
+			std::lock_guard lock(this->Mutex);
+			this->Jobs.push_back(std::move(job));
+			this->Outstanding++;
+		}
+		this->JobAvailable.notify_one();
+	}
+
+	void ThreadPool::WaitIdle()
+	{
+		std::unique_lock lock(this->Mutex);
+		this->JobsDone.wait(lock, [this]() { return this->Outstanding == 0; });
+	}
+
+	void ThreadPool::WorkerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> job;
+
+			{
+				std::unique_lock lock(this->Mutex);
+				this->JobAvailable.wait(lock, [this]() { return this->Stopping || !this->Jobs.empty(); });
+
+				// Drain the queue before stopping
+				if (this->Jobs.empty())
+					return;
+
+				job = std::move(this->Jobs.front());
+				this->Jobs.pop_front();
+			}
+
+			job();
+
+			{
+				std::lock_guard lock(this->Mutex);
+				this->Outstanding--;
+				if (this->Outstanding == 0)
+					this->JobsDone.notify_all();
+			}
+		}
+	}
+}
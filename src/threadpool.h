@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+namespace Engine
+{
+	// Fixed set of worker threads pulling jobs off one queue
+	class ThreadPool
+	{
+	private:
+		std::vector<std::thread> Workers;
+
+		std::mutex Mutex;
+		std::condition_variable JobAvailable;
+		std::condition_variable JobsDone;
+
+		std::deque<std::function<void()>> Jobs;
+
+		// Queued plus currently running
+		uint32_t Outstanding = 0;
+		bool Stopping = false;
+
+		void WorkerLoop();
+
+	public:
+		// Jobs must not throw, catch and hand errors back through whatever the job fills in
+		void Submit(std::function<void()> job);
+
+		// Blocks until every submitted job has finished
+		void WaitIdle();
+
+		uint32_t GetThreadCount() const
+		{
+			return static_cast<uint32_t>(this->Workers.size());
+		}
+
+		// 0 means one thread per hardware thread
+		explicit ThreadPool(uint32_t threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+	};
+}
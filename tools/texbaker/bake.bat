@@ -0,0 +1 @@
+..\..\bin\texbaker_x64_Release.exe ..\..\textures\queen.jpg ..\..\textures\texture.jpg
\ No newline at end of file
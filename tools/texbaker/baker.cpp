@@ -0,0 +1,206 @@
+#include "baker.h"
+#include "bcenc.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace TexBaker
+{
+	static float SrgbToLinear(float v)
+	{
+		return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+	}
+
+	static float LinearToSrgb(float v)
+	{
+		return v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+	}
+
+	static const std::array<float, 256>& SrgbTable()
+	{
+		static const auto table = [] {
+			std::array<float, 256> t{};
+			for (int i = 0; i < 256; i++)
+				t[i] = SrgbToLinear(static_cast<float>(i) / 255.0f);
+			return t;
+		}();
+		return table;
+	}
+
+	static uint8_t ToUnorm8(float v)
+	{
+		return static_cast<uint8_t>(std::clamp(v * 255.0f + 0.5f, 0.0f, 255.0f));
+	}
+
+	RgbaImage Downsample(const RgbaImage& image, const BakeSettings& settings)
+	{
+		RgbaImage mip;
+		mip.Width = std::max(1u, image.Width / 2);
+		mip.Height = std::max(1u, image.Height / 2);
+		mip.Pixels.resize(static_cast<size_t>(mip.Width) * mip.Height * 4);
+
+		const auto& srgb = SrgbTable();
+		const bool gammaCorrect = settings.Kind == BakeKind::Color && !settings.Linear;
+
+		for (uint32_t y = 0; y < mip.Height; y++)
+		{
+			for (uint32_t x = 0; x < mip.Width; x++)
+			{
+				// 2x2 box, odd edges just reuse the last row/column
+				const uint32_t xs[2] = { std::min(x * 2, image.Width - 1), std::min(x * 2 + 1, image.Width - 1) };
+				const uint32_t ys[2] = { std::min(y * 2, image.Height - 1), std::min(y * 2 + 1, image.Height - 1) };
+
+				float sum[4] = {};
+				for (auto sy : ys)
+				{
+					for (auto sx : xs)
+					{
+						const auto* p = &image.Pixels[(static_cast<size_t>(sy) * image.Width + sx) * 4];
+						for (int c = 0; c < 4; c++)
+						{
+							if (settings.Kind == BakeKind::Normal && c < 3)
+								sum[c] += static_cast<float>(p[c]) / 127.5f - 1.0f;
+							else if (gammaCorrect && c < 3)
+								sum[c] += srgb[p[c]];
+							else
+								sum[c] += static_cast<float>(p[c]) / 255.0f;
+						}
+					}
+				}
+
+				auto* out = &mip.Pixels[(static_cast<size_t>(y) * mip.Width + x) * 4];
+				if (settings.Kind == BakeKind::Normal)
+				{
+					auto length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+					if (length < 1e-6f)
+					{
+						sum[0] = sum[1] = 0;
+						sum[2] = length = 1;
+					}
+
+					for (int c = 0; c < 3; c++)
+						out[c] = ToUnorm8((sum[c] / length) * 0.5f + 0.5f);
+					out[3] = ToUnorm8(sum[3] * 0.25f);
+				}
+				else
+				{
+					for (int c = 0; c < 4; c++)
+					{
+						const auto v = sum[c] * 0.25f;
+						out[c] = ToUnorm8(gammaCorrect && c < 3 ? LinearToSrgb(v) : v);
+					}
+				}
+			}
+		}
+
+		return mip;
+	}
+
+	// 4x4 texels at block (bx, by), edges clamped for levels that aren't a multiple of 4
+	static void GatherBlock(const RgbaImage& image, uint32_t bx, uint32_t by, uint8_t* block)
+	{
+		for (uint32_t y = 0; y < 4; y++)
+		{
+			const auto sy = std::min(by * 4 + y, image.Height - 1);
+			for (uint32_t x = 0; x < 4; x++)
+			{
+				const auto sx = std::min(bx * 4 + x, image.Width - 1);
+				std::copy_n(&image.Pixels[(static_cast<size_t>(sy) * image.Width + sx) * 4], 4, block + (y * 4 + x) * 4);
+			}
+		}
+	}
+
+	std::vector<uint8_t> EncodeLevel(const RgbaImage& image, const BakeSettings& settings, Engine::ThreadPool& pool)
+	{
+		const auto blocksX = (image.Width + 3) / 4;
+		const auto blocksY = (image.Height + 3) / 4;
+
+		std::vector<uint8_t> blocks(static_cast<size_t>(blocksX) * blocksY * 16);
+
+		// A few bands per thread so uneven rows still balance out
+		const auto bandCount = std::min(blocksY, pool.GetThreadCount() * 4);
+		const auto rowsPerBand = (blocksY + bandCount - 1) / bandCount;
+
+		for (uint32_t first = 0; first < blocksY; first += rowsPerBand)
+		{
+			const auto last = std::min(blocksY, first + rowsPerBand);
+			pool.Submit([&image, &settings, &blocks, blocksX, first, last] {
+				uint8_t texels[64];
+				for (uint32_t by = first; by < last; by++)
+				{
+					for (uint32_t bx = 0; bx < blocksX; bx++)
+					{
+						GatherBlock(image, bx, by, texels);
+
+						auto* out = &blocks[(static_cast<size_t>(by) * blocksX + bx) * 16];
+						if (settings.Kind == BakeKind::Normal)
+							EncodeBc5Block(texels, out, settings.Simd);
+						else
+							EncodeBc7Block(texels, out, settings.Simd);
+					}
+				}
+			});
+		}
+
+		pool.WaitIdle();
+		return blocks;
+	}
+
+	RgbaImage DecodeLevel(const std::vector<uint8_t>& blocks, uint32_t width, uint32_t height, const BakeSettings& settings)
+	{
+		RgbaImage image;
+		image.Width = width;
+		image.Height = height;
+		image.Pixels.resize(static_cast<size_t>(width) * height * 4);
+
+		const auto blocksX = (width + 3) / 4;
+		const auto blocksY = (height + 3) / 4;
+
+		uint8_t texels[64];
+		for (uint32_t by = 0; by < blocksY; by++)
+		{
+			for (uint32_t bx = 0; bx < blocksX; bx++)
+			{
+				const auto* block = &blocks[(static_cast<size_t>(by) * blocksX + bx) * 16];
+				if (settings.Kind == BakeKind::Normal)
+					DecodeBc5Block(block, texels);
+				else
+					DecodeBc7Block(block, texels);
+
+				for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+					for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+						std::copy_n(texels + (y * 4 + x) * 4, 4, &image.Pixels[((static_cast<size_t>(by) * 4 + y) * width + bx * 4 + x) * 4]);
+			}
+		}
+
+		return image;
+	}
+
+	BakedTexture Bake(const RgbaImage& image, const BakeSettings& settings, Engine::ThreadPool& pool)
+	{
+		BakedTexture baked;
+		baked.Width = image.Width;
+		baked.Height = image.Height;
+
+		if (settings.Kind == BakeKind::Normal)
+			baked.Format = BakeFormat::Bc5Unorm;
+		else
+			baked.Format = settings.Linear ? BakeFormat::Bc7Unorm : BakeFormat::Bc7Srgb;
+
+		baked.Levels.push_back(EncodeLevel(image, settings, pool));
+
+		if (settings.Mips)
+		{
+			// Each level is filtered from the one above it, down to 1x1
+			auto level = image;
+			while (level.Width > 1 || level.Height > 1)
+			{
+				level = Downsample(level, settings);
+				baked.Levels.push_back(EncodeLevel(level, settings, pool));
+			}
+		}
+
+		return baked;
+	}
+}
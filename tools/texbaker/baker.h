@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "threadpool.h"
+#include "ktx2writer.h"
+
+namespace TexBaker
+{
+	enum class BakeKind
+	{
+		Color,		// BC7, sRGB unless Linear is set
+		Normal,		// BC5 of X and Y, mips renormalized
+	};
+
+	struct BakeSettings
+	{
+		BakeKind Kind = BakeKind::Color;
+		bool Linear = false;
+		bool Simd = true;
+		bool Mips = true;
+	};
+
+	struct RgbaImage
+	{
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		std::vector<uint8_t> Pixels;
+	};
+
+	struct BakedTexture
+	{
+		BakeFormat Format = BakeFormat::Bc7Srgb;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+
+		// Level 0 is the full size image
+		std::vector<std::vector<uint8_t>> Levels;
+	};
+
+	// Next mip of image, filtered in linear light for sRGB color and renormalized for normals
+	RgbaImage Downsample(const RgbaImage& image, const BakeSettings& settings);
+
+	// Compresses one level, rows of blocks are spread over the pool
+	std::vector<uint8_t> EncodeLevel(const RgbaImage& image, const BakeSettings& settings, Engine::ThreadPool& pool);
+
+	// Decompresses a level encoded with the same settings, for error reporting
+	RgbaImage DecodeLevel(const std::vector<uint8_t>& blocks, uint32_t width, uint32_t height, const BakeSettings& settings);
+
+	BakedTexture Bake(const RgbaImage& image, const BakeSettings& settings, Engine::ThreadPool& pool);
+}
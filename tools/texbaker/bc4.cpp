@@ -0,0 +1,190 @@
+#include "bcenc.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace TexBaker
+{
+	// Always the 8 value mode: code 0 is the max, 1 the min, 2..7 interpolate from max to min.
+	// k is how many sevenths of the way from min to max the value is.
+	static uint8_t CodeFromStep(int32_t k)
+	{
+		return static_cast<uint8_t>(k == 7 ? 0 : (k == 0 ? 1 : 8 - k));
+	}
+
+	static void PackBc4(uint8_t hi, uint8_t lo, const uint8_t codes[16], uint8_t* out)
+	{
+		out[0] = hi;
+		out[1] = lo;
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 16; i++)
+			bits |= static_cast<uint64_t>(codes[i] & 7) << (i * 3);
+
+		for (int i = 0; i < 6; i++)
+			out[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+	}
+
+	static void EncodeBc4Scalar(const uint8_t* values, uint8_t* out)
+	{
+		uint8_t lo = 255, hi = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			lo = std::min(lo, values[i]);
+			hi = std::max(hi, values[i]);
+		}
+
+		uint8_t codes[16] = {};
+		if (hi != lo)
+		{
+			const auto scale = 7.0f / static_cast<float>(hi - lo);
+			for (int i = 0; i < 16; i++)
+				codes[i] = CodeFromStep(static_cast<int32_t>(static_cast<float>(values[i] - lo) * scale + 0.5f));
+		}
+
+		PackBc4(hi, lo, codes, out);
+	}
+
+#if defined(TEXBAKER_SSE41)
+	static void EncodeBc4Simd(const uint8_t* values, uint8_t* out)
+	{
+		const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+
+		// Horizontal min/max over the 16 bytes
+		auto lo16 = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+		auto hi16 = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+		lo16 = _mm_min_epu8(lo16, _mm_srli_si128(lo16, 4));
+		hi16 = _mm_max_epu8(hi16, _mm_srli_si128(hi16, 4));
+		lo16 = _mm_min_epu8(lo16, _mm_srli_si128(lo16, 2));
+		hi16 = _mm_max_epu8(hi16, _mm_srli_si128(hi16, 2));
+		lo16 = _mm_min_epu8(lo16, _mm_srli_si128(lo16, 1));
+		hi16 = _mm_max_epu8(hi16, _mm_srli_si128(hi16, 1));
+
+		const auto lo = static_cast<uint8_t>(_mm_cvtsi128_si32(lo16));
+		const auto hi = static_cast<uint8_t>(_mm_cvtsi128_si32(hi16));
+
+		alignas(16) uint8_t codes[16] = {};
+		if (hi != lo)
+		{
+			const auto scale = _mm_set1_ps(7.0f / static_cast<float>(hi - lo));
+			const auto loF = _mm_set1_ps(static_cast<float>(lo));
+			const auto half = _mm_set1_ps(0.5f);
+			const auto zero = _mm_setzero_si128();
+			const auto one = _mm_set1_epi32(1);
+			const auto eight = _mm_set1_epi32(8);
+
+			// Byte shifts need immediates, so the four groups of texels are split up front
+			const __m128i groups[4] = { v, _mm_srli_si128(v, 4), _mm_srli_si128(v, 8), _mm_srli_si128(v, 12) };
+
+			__m128i code[4];
+			for (int i = 0; i < 4; i++)
+			{
+				const auto x = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(groups[i]));
+				const auto k = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(x, loF), scale), half));
+
+				// 8 - k, then k == 7 -> 0 and k == 0 -> 1
+				auto c = _mm_sub_epi32(eight, k);
+				c = _mm_blendv_epi8(c, zero, _mm_cmpeq_epi32(c, one));
+				c = _mm_blendv_epi8(c, one, _mm_cmpeq_epi32(c, eight));
+				code[i] = c;
+			}
+
+			const auto packed = _mm_packus_epi16(_mm_packus_epi32(code[0], code[1]), _mm_packus_epi32(code[2], code[3]));
+			_mm_store_si128(reinterpret_cast<__m128i*>(codes), packed);
+		}
+
+		PackBc4(hi, lo, codes, out);
+	}
+#endif
+
+	void EncodeBc4Block(const uint8_t* values, uint8_t* out, bool simd)
+	{
+#if defined(TEXBAKER_SSE41)
+		if (simd)
+		{
+			EncodeBc4Simd(values, out);
+			return;
+		}
+#else
+		(void)simd;
+#endif
+		EncodeBc4Scalar(values, out);
+	}
+
+	void DecodeBc4Block(const uint8_t* block, uint8_t* values)
+	{
+		const int32_t r0 = block[0];
+		const int32_t r1 = block[1];
+
+		int32_t palette[8] = { r0, r1 };
+		if (r0 > r1)
+		{
+			for (int i = 1; i < 7; i++)
+				palette[i + 1] = ((7 - i) * r0 + i * r1) / 7;
+		}
+		else
+		{
+			for (int i = 1; i < 5; i++)
+				palette[i + 1] = ((5 - i) * r0 + i * r1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; i++)
+			bits |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+
+		for (int i = 0; i < 16; i++)
+			values[i] = static_cast<uint8_t>(palette[(bits >> (i * 3)) & 7]);
+	}
+
+	void EncodeBc5Block(const uint8_t* rgba, uint8_t* out, bool simd)
+	{
+		alignas(16) uint8_t red[16], green[16];
+#if defined(TEXBAKER_SSE41)
+		if (simd)
+		{
+			// Each 16 byte load is 4 texels, pull their R and G bytes into the low and high halves
+			const auto split = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+
+			__m128i rg[4];
+			for (int i = 0; i < 4; i++)
+				rg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + i * 16)), split);
+
+			const auto lo = _mm_unpacklo_epi32(rg[0], rg[1]);	// R0 R1 G0 G1
+			const auto hi = _mm_unpacklo_epi32(rg[2], rg[3]);	// R2 R3 G2 G3
+			_mm_store_si128(reinterpret_cast<__m128i*>(red), _mm_unpacklo_epi64(lo, hi));
+			_mm_store_si128(reinterpret_cast<__m128i*>(green), _mm_unpackhi_epi64(lo, hi));
+
+			EncodeBc4Simd(red, out);
+			EncodeBc4Simd(green, out + 8);
+			return;
+		}
+#endif
+
+		for (int i = 0; i < 16; i++)
+		{
+			red[i] = rgba[i * 4];
+			green[i] = rgba[i * 4 + 1];
+		}
+
+		EncodeBc4Block(red, out, simd);
+		EncodeBc4Block(green, out + 8, simd);
+	}
+
+	void DecodeBc5Block(const uint8_t* block, uint8_t* rgba)
+	{
+		uint8_t red[16], green[16];
+		DecodeBc4Block(block, red);
+		DecodeBc4Block(block + 8, green);
+
+		for (int i = 0; i < 16; i++)
+		{
+			rgba[i * 4] = red[i];
+			rgba[i * 4 + 1] = green[i];
+			rgba[i * 4 + 2] = 0;
+			rgba[i * 4 + 3] = 255;
+		}
+	}
+}
@@ -0,0 +1,597 @@
+#include "bcenc.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace TexBaker
+{
+	// 4 bit index interpolation weights, out of 64
+	alignas(32) static const int32_t Bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// Channel major so the kernels can load 4 or 8 texels of one channel at a time
+	struct Bc7Pixels
+	{
+		alignas(32) int32_t C[4][16];
+	};
+
+	struct Bc7Endpoints
+	{
+		// 7 bit values and the p-bit, the dequantized endpoint is (Q << 1) | P
+		uint8_t Q[2][4];
+		uint8_t P[2];
+		int32_t E[2][4];
+	};
+
+	static int32_t Interpolate(int32_t e0, int32_t e1, int32_t weight)
+	{
+		return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+	}
+
+	static void QuantizeEndpoint(const float value[4], Bc7Endpoints& endpoints, int which)
+	{
+		// Try both p-bits, keep whichever lands closer
+		float bestError = 1e30f;
+		for (int p = 0; p < 2; p++)
+		{
+			uint8_t q[4];
+			float error = 0;
+			for (int c = 0; c < 4; c++)
+			{
+				const auto v = static_cast<int>((value[c] - p) * 0.5f + 0.5f);
+				q[c] = static_cast<uint8_t>(std::clamp(v, 0, 127));
+
+				const auto d = value[c] - static_cast<float>((q[c] << 1) | p);
+				error += d * d;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				std::memcpy(endpoints.Q[which], q, 4);
+				endpoints.P[which] = static_cast<uint8_t>(p);
+			}
+		}
+
+		for (int c = 0; c < 4; c++)
+			endpoints.E[which][c] = (endpoints.Q[which][c] << 1) | endpoints.P[which];
+	}
+
+	// Projects every texel onto the endpoint line for its index, returns the squared error
+	static uint32_t SelectIndicesScalar(const Bc7Pixels& px, const Bc7Endpoints& ep, uint8_t indices[16])
+	{
+		float d[4];
+		float length = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			d[c] = static_cast<float>(ep.E[1][c] - ep.E[0][c]);
+			length += d[c] * d[c];
+		}
+		const auto scale = length > 0 ? 15.0f / length : 0.0f;
+
+		uint32_t error = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			float dot = 0;
+			for (int c = 0; c < 4; c++)
+				dot += (static_cast<float>(px.C[c][i]) - static_cast<float>(ep.E[0][c])) * d[c];
+
+			const auto t = std::clamp(dot * scale + 0.5f, 0.0f, 15.0f);
+			const auto index = static_cast<int32_t>(t);
+			const auto weight = Bc7Weights4[index];
+			indices[i] = static_cast<uint8_t>(index);
+
+			for (int c = 0; c < 4; c++)
+			{
+				const auto diff = px.C[c][i] - Interpolate(ep.E[0][c], ep.E[1][c], weight);
+				error += static_cast<uint32_t>(diff * diff);
+			}
+		}
+
+		return error;
+	}
+
+#if defined(TEXBAKER_AVX2)
+	// 8 texels per step, weights come from a gather
+	static uint32_t SelectIndicesSimd(const Bc7Pixels& px, const Bc7Endpoints& ep, uint8_t indices[16])
+	{
+		__m256 d[4];
+		__m256 e0f[4];
+		__m256i e0[4];
+		__m256i e1[4];
+		float length = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			const auto dc = static_cast<float>(ep.E[1][c] - ep.E[0][c]);
+			length += dc * dc;
+
+			d[c] = _mm256_set1_ps(dc);
+			e0f[c] = _mm256_set1_ps(static_cast<float>(ep.E[0][c]));
+			e0[c] = _mm256_set1_epi32(ep.E[0][c]);
+			e1[c] = _mm256_set1_epi32(ep.E[1][c]);
+		}
+
+		const auto scale = _mm256_set1_ps(length > 0 ? 15.0f / length : 0.0f);
+		const auto half = _mm256_set1_ps(0.5f);
+		const auto maxIndex = _mm256_set1_ps(15.0f);
+		const auto sixtyFour = _mm256_set1_epi32(64);
+		const auto rounding = _mm256_set1_epi32(32);
+
+		auto errorSum = _mm256_setzero_si256();
+		for (int i = 0; i < 16; i += 8)
+		{
+			__m256i texel[4];
+			auto dot = _mm256_setzero_ps();
+			for (int c = 0; c < 4; c++)
+			{
+				texel[c] = _mm256_load_si256(reinterpret_cast<const __m256i*>(&px.C[c][i]));
+				const auto diff = _mm256_sub_ps(_mm256_cvtepi32_ps(texel[c]), e0f[c]);
+				dot = _mm256_add_ps(dot, _mm256_mul_ps(diff, d[c]));
+			}
+
+			auto t = _mm256_add_ps(_mm256_mul_ps(dot, scale), half);
+			t = _mm256_min_ps(_mm256_max_ps(t, _mm256_setzero_ps()), maxIndex);
+
+			const auto index = _mm256_cvttps_epi32(t);
+			const auto weight = _mm256_i32gather_epi32(Bc7Weights4, index, 4);
+			const auto inverse = _mm256_sub_epi32(sixtyFour, weight);
+
+			for (int c = 0; c < 4; c++)
+			{
+				auto rec = _mm256_add_epi32(_mm256_mullo_epi32(inverse, e0[c]), _mm256_mullo_epi32(weight, e1[c]));
+				rec = _mm256_srai_epi32(_mm256_add_epi32(rec, rounding), 6);
+
+				const auto diff = _mm256_sub_epi32(texel[c], rec);
+				errorSum = _mm256_add_epi32(errorSum, _mm256_mullo_epi32(diff, diff));
+			}
+
+			// 8 x int32 down to 8 bytes
+			const auto packed16 = _mm_packus_epi32(_mm256_castsi256_si128(index), _mm256_extracti128_si256(index, 1));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(indices + i), _mm_packus_epi16(packed16, packed16));
+		}
+
+		auto sum = _mm_add_epi32(_mm256_castsi256_si128(errorSum), _mm256_extracti128_si256(errorSum, 1));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+		return static_cast<uint32_t>(_mm_cvtsi128_si32(sum));
+	}
+#elif defined(TEXBAKER_SSE41)
+	// 4 texels per step, weights come from a pshufb table lookup
+	static uint32_t SelectIndicesSimd(const Bc7Pixels& px, const Bc7Endpoints& ep, uint8_t indices[16])
+	{
+		__m128 d[4];
+		__m128 e0f[4];
+		__m128i e0[4];
+		__m128i e1[4];
+		float length = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			const auto dc = static_cast<float>(ep.E[1][c] - ep.E[0][c]);
+			length += dc * dc;
+
+			d[c] = _mm_set1_ps(dc);
+			e0f[c] = _mm_set1_ps(static_cast<float>(ep.E[0][c]));
+			e0[c] = _mm_set1_epi32(ep.E[0][c]);
+			e1[c] = _mm_set1_epi32(ep.E[1][c]);
+		}
+
+		const auto scale = _mm_set1_ps(length > 0 ? 15.0f / length : 0.0f);
+		const auto half = _mm_set1_ps(0.5f);
+		const auto maxIndex = _mm_set1_ps(15.0f);
+		const auto sixtyFour = _mm_set1_epi32(64);
+		const auto rounding = _mm_set1_epi32(32);
+		const auto weightTable = _mm_setr_epi8(0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64);
+
+		auto errorSum = _mm_setzero_si128();
+		for (int i = 0; i < 16; i += 4)
+		{
+			__m128i texel[4];
+			auto dot = _mm_setzero_ps();
+			for (int c = 0; c < 4; c++)
+			{
+				texel[c] = _mm_load_si128(reinterpret_cast<const __m128i*>(&px.C[c][i]));
+				const auto diff = _mm_sub_ps(_mm_cvtepi32_ps(texel[c]), e0f[c]);
+				dot = _mm_add_ps(dot, _mm_mul_ps(diff, d[c]));
+			}
+
+			auto t = _mm_add_ps(_mm_mul_ps(dot, scale), half);
+			t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), maxIndex);
+
+			const auto index = _mm_cvttps_epi32(t);
+			const auto index8 = _mm_packus_epi16(_mm_packus_epi32(index, index), _mm_setzero_si128());
+			const auto weight = _mm_cvtepu8_epi32(_mm_shuffle_epi8(weightTable, index8));
+			const auto inverse = _mm_sub_epi32(sixtyFour, weight);
+
+			for (int c = 0; c < 4; c++)
+			{
+				auto rec = _mm_add_epi32(_mm_mullo_epi32(inverse, e0[c]), _mm_mullo_epi32(weight, e1[c]));
+				rec = _mm_srai_epi32(_mm_add_epi32(rec, rounding), 6);
+
+				const auto diff = _mm_sub_epi32(texel[c], rec);
+				errorSum = _mm_add_epi32(errorSum, _mm_mullo_epi32(diff, diff));
+			}
+
+			const auto packed = _mm_cvtsi128_si32(index8);
+			std::memcpy(indices + i, &packed, 4);
+		}
+
+		errorSum = _mm_add_epi32(errorSum, _mm_shuffle_epi32(errorSum, _MM_SHUFFLE(1, 0, 3, 2)));
+		errorSum = _mm_add_epi32(errorSum, _mm_shuffle_epi32(errorSum, _MM_SHUFFLE(2, 3, 0, 1)));
+		return static_cast<uint32_t>(_mm_cvtsi128_si32(errorSum));
+	}
+#endif
+
+	static uint32_t SelectIndices(const Bc7Pixels& px, const Bc7Endpoints& ep, uint8_t indices[16], bool simd)
+	{
+#if defined(TEXBAKER_SSE41)
+		if (simd)
+			return SelectIndicesSimd(px, ep, indices);
+#else
+		(void)simd;
+#endif
+		return SelectIndicesScalar(px, ep, indices);
+	}
+
+	// Adds up 16 floats in the same order as the SIMD path: 4 lanes, each taking every 4th
+	// value, then the lanes pairwise. Float addition isn't associative, so any other order
+	// can round differently and pick different endpoints.
+	static float LaneOrderSum(const float x[16])
+	{
+		float lanes[4] = {};
+		for (int i = 0; i < 16; i++)
+			lanes[i % 4] += x[i];
+
+		return (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+	}
+
+	static void ComputeMomentsScalar(const Bc7Pixels& px, float mean[4], float cov[4][4])
+	{
+		float v[4][16];
+		for (int c = 0; c < 4; c++)
+		{
+			for (int i = 0; i < 16; i++)
+				v[c][i] = static_cast<float>(px.C[c][i]);
+
+			mean[c] = LaneOrderSum(v[c]) / 16.0f;
+
+			for (int i = 0; i < 16; i++)
+				v[c][i] -= mean[c];
+		}
+
+		for (int a = 0; a < 4; a++)
+			for (int b = 0; b < 4; b++)
+				cov[a][b] = 0;
+
+		for (int a = 0; a < 4; a++)
+		{
+			for (int b = a; b < 4; b++)
+			{
+				float products[16];
+				for (int i = 0; i < 16; i++)
+					products[i] = v[a][i] * v[b][i];
+
+				cov[a][b] = LaneOrderSum(products);
+			}
+		}
+	}
+
+	static void ProjectExtentScalar(const Bc7Pixels& px, const float mean[4], const float axis[4], float& lo, float& hi)
+	{
+		lo = 1e30f;
+		hi = -1e30f;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = 0;
+			for (int c = 0; c < 4; c++)
+				t += (static_cast<float>(px.C[c][i]) - mean[c]) * axis[c];
+
+			lo = std::min(lo, t);
+			hi = std::max(hi, t);
+		}
+	}
+
+#if defined(TEXBAKER_SSE41)
+	static float HorizontalSum(__m128 v)
+	{
+		v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+		v = _mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+		return _mm_cvtss_f32(v);
+	}
+
+	// Both of these are a handful of horizontal sums, 4 wide is plenty even on AVX2
+	static void ComputeMomentsSimd(const Bc7Pixels& px, float mean[4], float cov[4][4])
+	{
+		__m128 v[4][4];
+		for (int c = 0; c < 4; c++)
+		{
+			auto sum = _mm_setzero_ps();
+			for (int i = 0; i < 4; i++)
+			{
+				v[c][i] = _mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(&px.C[c][i * 4])));
+				sum = _mm_add_ps(sum, v[c][i]);
+			}
+			mean[c] = HorizontalSum(sum) / 16.0f;
+
+			const auto m = _mm_set1_ps(mean[c]);
+			for (int i = 0; i < 4; i++)
+				v[c][i] = _mm_sub_ps(v[c][i], m);
+		}
+
+		for (int a = 0; a < 4; a++)
+		{
+			for (int b = a; b < 4; b++)
+			{
+				auto sum = _mm_setzero_ps();
+				for (int i = 0; i < 4; i++)
+					sum = _mm_add_ps(sum, _mm_mul_ps(v[a][i], v[b][i]));
+				cov[a][b] = HorizontalSum(sum);
+			}
+		}
+	}
+
+	static void ProjectExtentSimd(const Bc7Pixels& px, const float mean[4], const float axis[4], float& lo, float& hi)
+	{
+		auto minimum = _mm_set1_ps(1e30f);
+		auto maximum = _mm_set1_ps(-1e30f);
+		for (int i = 0; i < 16; i += 4)
+		{
+			auto t = _mm_setzero_ps();
+			for (int c = 0; c < 4; c++)
+			{
+				const auto x = _mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(&px.C[c][i])));
+				t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(x, _mm_set1_ps(mean[c])), _mm_set1_ps(axis[c])));
+			}
+
+			minimum = _mm_min_ps(minimum, t);
+			maximum = _mm_max_ps(maximum, t);
+		}
+
+		minimum = _mm_min_ps(minimum, _mm_movehl_ps(minimum, minimum));
+		minimum = _mm_min_ss(minimum, _mm_shuffle_ps(minimum, minimum, _MM_SHUFFLE(1, 1, 1, 1)));
+		maximum = _mm_max_ps(maximum, _mm_movehl_ps(maximum, maximum));
+		maximum = _mm_max_ss(maximum, _mm_shuffle_ps(maximum, maximum, _MM_SHUFFLE(1, 1, 1, 1)));
+
+		lo = _mm_cvtss_f32(minimum);
+		hi = _mm_cvtss_f32(maximum);
+	}
+#endif
+
+	// Endpoints along the principal axis of the block's colors, clipped to the texels' extent
+	static void FitPrincipalAxis(const Bc7Pixels& px, float e0[4], float e1[4], bool simd)
+	{
+		float mean[4];
+		float cov[4][4];
+#if !defined(TEXBAKER_SSE41)
+		(void)simd;
+#else
+		if (simd)
+			ComputeMomentsSimd(px, mean, cov);
+		else
+#endif
+			ComputeMomentsScalar(px, mean, cov);
+
+		for (int a = 0; a < 4; a++)
+			for (int b = 0; b < a; b++)
+				cov[a][b] = cov[b][a];
+
+		// Power iteration, seeded with the channel that varies the most
+		int seed = 0;
+		for (int c = 1; c < 4; c++)
+			if (cov[c][c] > cov[seed][seed])
+				seed = c;
+
+		float axis[4] = { cov[seed][0], cov[seed][1], cov[seed][2], cov[seed][3] };
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			for (int a = 0; a < 4; a++)
+				for (int b = 0; b < 4; b++)
+					next[a] += cov[a][b] * axis[b];
+
+			const auto length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+			if (length < 1e-6f)
+				break;
+
+			for (int c = 0; c < 4; c++)
+				axis[c] = next[c] / length;
+		}
+
+		const auto axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3]);
+		if (axisLength < 1e-6f)
+		{
+			// Flat block
+			for (int c = 0; c < 4; c++)
+				e0[c] = e1[c] = mean[c];
+			return;
+		}
+
+		for (int c = 0; c < 4; c++)
+			axis[c] /= axisLength;
+
+		float lo, hi;
+#if defined(TEXBAKER_SSE41)
+		if (simd)
+			ProjectExtentSimd(px, mean, axis, lo, hi);
+		else
+#endif
+			ProjectExtentScalar(px, mean, axis, lo, hi);
+
+		for (int c = 0; c < 4; c++)
+		{
+			e0[c] = std::clamp(mean[c] + axis[c] * lo, 0.0f, 255.0f);
+			e1[c] = std::clamp(mean[c] + axis[c] * hi, 0.0f, 255.0f);
+		}
+	}
+
+	// Least squares endpoints for a fixed set of indices, false if they're degenerate
+	static bool RefitEndpoints(const Bc7Pixels& px, const uint8_t indices[16], float e0[4], float e1[4])
+	{
+		float aa = 0, ab = 0, bb = 0;
+		float x0[4] = {};
+		float x1[4] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			const auto w = static_cast<float>(Bc7Weights4[indices[i]]) / 64.0f;
+			const auto iw = 1.0f - w;
+
+			aa += iw * iw;
+			ab += iw * w;
+			bb += w * w;
+
+			for (int c = 0; c < 4; c++)
+			{
+				x0[c] += iw * static_cast<float>(px.C[c][i]);
+				x1[c] += w * static_cast<float>(px.C[c][i]);
+			}
+		}
+
+		const auto det = aa * bb - ab * ab;
+		if (std::fabs(det) < 1e-6f)
+			return false;
+
+		const auto invDet = 1.0f / det;
+		for (int c = 0; c < 4; c++)
+		{
+			e0[c] = std::clamp((bb * x0[c] - ab * x1[c]) * invDet, 0.0f, 255.0f);
+			e1[c] = std::clamp((aa * x1[c] - ab * x0[c]) * invDet, 0.0f, 255.0f);
+		}
+
+		return true;
+	}
+
+	// Writes LSB first into a 128 bit block, no field straddles more than the two words
+	struct BitWriter
+	{
+		uint64_t Words[2] = {};
+		uint32_t Position = 0;
+
+		void Put(uint64_t value, uint32_t bits)
+		{
+			const auto word = this->Position >> 6;
+			const auto shift = this->Position & 63;
+
+			this->Words[word] |= value << shift;
+			if (shift + bits > 64)
+				this->Words[1] |= value >> (64 - shift);
+
+			this->Position += bits;
+		}
+
+		void Store(uint8_t* out) const
+		{
+			for (int i = 0; i < 16; i++)
+				out[i] = static_cast<uint8_t>(this->Words[i >> 3] >> ((i & 7) * 8));
+		}
+	};
+
+	struct BitReader
+	{
+		const uint8_t* In;
+		uint32_t Position = 0;
+
+		uint32_t Get(uint32_t bits)
+		{
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < bits; i++, this->Position++)
+				value |= ((this->In[this->Position >> 3] >> (this->Position & 7)) & 1u) << i;
+			return value;
+		}
+	};
+
+	static void PackMode6(Bc7Endpoints ep, uint8_t indices[16], uint8_t* out)
+	{
+		// The first index's top bit is implied zero, swap the endpoints if it'd be set
+		if (indices[0] & 8)
+		{
+			std::swap(ep.Q[0], ep.Q[1]);
+			std::swap(ep.P[0], ep.P[1]);
+			for (int i = 0; i < 16; i++)
+				indices[i] = static_cast<uint8_t>(15 - indices[i]);
+		}
+
+		BitWriter writer;
+
+		writer.Put(1u << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			writer.Put(ep.Q[0][c], 7);
+			writer.Put(ep.Q[1][c], 7);
+		}
+		writer.Put(ep.P[0], 1);
+		writer.Put(ep.P[1], 1);
+
+		writer.Put(indices[0], 3);
+		for (int i = 1; i < 16; i++)
+			writer.Put(indices[i], 4);
+
+		writer.Store(out);
+	}
+
+	void EncodeBc7Block(const uint8_t* rgba, uint8_t* out, bool simd)
+	{
+		Bc7Pixels px;
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < 4; c++)
+				px.C[c][i] = rgba[i * 4 + c];
+
+		float e0[4], e1[4];
+		FitPrincipalAxis(px, e0, e1, simd);
+
+		Bc7Endpoints best;
+		QuantizeEndpoint(e0, best, 0);
+		QuantizeEndpoint(e1, best, 1);
+
+		uint8_t bestIndices[16];
+		auto bestError = SelectIndices(px, best, bestIndices, simd);
+
+		// One least squares pass usually pulls the endpoints in past the outliers
+		if (bestError > 0 && RefitEndpoints(px, bestIndices, e0, e1))
+		{
+			Bc7Endpoints refit;
+			QuantizeEndpoint(e0, refit, 0);
+			QuantizeEndpoint(e1, refit, 1);
+
+			uint8_t indices[16];
+			const auto error = SelectIndices(px, refit, indices, simd);
+			if (error < bestError)
+			{
+				best = refit;
+				std::memcpy(bestIndices, indices, 16);
+			}
+		}
+
+		PackMode6(best, bestIndices, out);
+	}
+
+	void DecodeBc7Block(const uint8_t* block, uint8_t* rgba)
+	{
+		BitReader reader{ block };
+		if (reader.Get(7) != (1u << 6))
+		{
+			// Not mode 6, decoders return transparent black for what they don't understand
+			std::memset(rgba, 0, 64);
+			return;
+		}
+
+		uint32_t q[2][4];
+		for (int c = 0; c < 4; c++)
+		{
+			q[0][c] = reader.Get(7);
+			q[1][c] = reader.Get(7);
+		}
+		const auto p0 = reader.Get(1);
+		const auto p1 = reader.Get(1);
+
+		for (int i = 0; i < 16; i++)
+		{
+			const auto index = reader.Get(i == 0 ? 3 : 4);
+			for (int c = 0; c < 4; c++)
+			{
+				const auto e0 = static_cast<int32_t>((q[0][c] << 1) | p0);
+				const auto e1 = static_cast<int32_t>((q[1][c] << 1) | p1);
+				rgba[i * 4 + c] = static_cast<uint8_t>(Interpolate(e0, e1, Bc7Weights4[index]));
+			}
+		}
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+namespace TexBaker
+{
+	// All blocks are 4x4 texels, row major, 4 bytes (RGBA8) per texel unless noted.
+	// simd = false forces the scalar kernels, for benchmarking and checking the SIMD ones.
+	// Both give bit identical blocks.
+
+	// BC7 mode 6: one subset, RGBA with 7 bit endpoints plus a p-bit, 4 bit indices.
+	// Endpoints come from the principal axis, refined once with least squares.
+	void EncodeBc7Block(const uint8_t* rgba, uint8_t* out, bool simd);
+
+	// Only decodes mode 6, which is all EncodeBc7Block produces
+	void DecodeBc7Block(const uint8_t* block, uint8_t* rgba);
+
+	// 16 single channel values
+	void EncodeBc4Block(const uint8_t* values, uint8_t* out, bool simd);
+	void DecodeBc4Block(const uint8_t* block, uint8_t* values);
+
+	// Red and green of rgba, e.g. a tangent space normal's X and Y
+	void EncodeBc5Block(const uint8_t* rgba, uint8_t* out, bool simd);
+	void DecodeBc5Block(const uint8_t* block, uint8_t* rgba);
+}
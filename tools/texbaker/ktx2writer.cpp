@@ -0,0 +1,139 @@
+#include "ktx2writer.h"
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace TexBaker
+{
+	static constexpr std::array<uint8_t, 12> Ktx2Identifier = {
+		0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+	};
+
+	// Khronos Data Format values for the basic descriptor block
+	static constexpr uint32_t KhrDfModelBc5 = 132;	// RGTC
+	static constexpr uint32_t KhrDfModelBc7 = 134;	// BPTC
+	static constexpr uint32_t KhrDfPrimariesBt709 = 1;
+	static constexpr uint32_t KhrDfTransferLinear = 1;
+	static constexpr uint32_t KhrDfTransferSrgb = 2;
+
+	struct ByteWriter
+	{
+		std::vector<uint8_t> Bytes;
+
+		void U8(uint8_t value) { this->Bytes.push_back(value); }
+		void U16(uint16_t value) { U8(value & 0xFF); U8(value >> 8); }
+		void U32(uint32_t value) { U16(value & 0xFFFF); U16(value >> 16); }
+		void U64(uint64_t value) { U32(static_cast<uint32_t>(value)); U32(static_cast<uint32_t>(value >> 32)); }
+
+		void Align(size_t alignment)
+		{
+			while (this->Bytes.size() % alignment)
+				U8(0);
+		}
+	};
+
+	static std::vector<uint8_t> BuildDfd(BakeFormat format)
+	{
+		const bool bc5 = format == BakeFormat::Bc5Unorm;
+		const uint32_t sampleCount = bc5 ? 2 : 1;
+		const uint32_t blockSize = 24 + 16 * sampleCount;
+
+		ByteWriter dfd;
+		dfd.U32(4 + blockSize);
+
+		// Vendor 0 (Khronos), descriptor type 0, version 2
+		dfd.U32(0);
+		dfd.U16(2);
+		dfd.U16(static_cast<uint16_t>(blockSize));
+
+		dfd.U8(static_cast<uint8_t>(bc5 ? KhrDfModelBc5 : KhrDfModelBc7));
+		dfd.U8(KhrDfPrimariesBt709);
+		dfd.U8(format == BakeFormat::Bc7Srgb ? KhrDfTransferSrgb : KhrDfTransferLinear);
+		dfd.U8(0);
+
+		// 4x4x1 texel blocks, stored minus one
+		dfd.U8(3);
+		dfd.U8(3);
+		dfd.U8(0);
+		dfd.U8(0);
+
+		// 16 bytes per block, one plane
+		dfd.U8(16);
+		for (int i = 0; i < 7; i++)
+			dfd.U8(0);
+
+		// BC5 is two 64 bit BC4 halves for red then green, BC7 is one 128 bit sample
+		for (uint32_t sample = 0; sample < sampleCount; sample++)
+		{
+			dfd.U16(static_cast<uint16_t>(bc5 ? sample * 64 : 0));
+			dfd.U8(bc5 ? 63 : 127);
+			dfd.U8(static_cast<uint8_t>(bc5 ? sample : 0));
+			dfd.U32(0);
+			dfd.U32(0);
+			dfd.U32(0xFFFFFFFF);
+		}
+
+		return dfd.Bytes;
+	}
+
+	void WriteKtx2(const std::string& path, BakeFormat format, uint32_t width, uint32_t height,
+		const std::vector<std::vector<uint8_t>>& levels)
+	{
+		const auto levelCount = static_cast<uint32_t>(levels.size());
+		const auto dfd = BuildDfd(format);
+		const auto dfdOffset = static_cast<uint32_t>(80 + 24 * levelCount);
+
+		// Level data goes smallest first, each level aligned to the 16 byte block size
+		std::vector<uint64_t> offsets(levelCount);
+		uint64_t offset = dfdOffset + dfd.size();
+		for (uint32_t level = levelCount; level-- > 0;)
+		{
+			offset = (offset + 15) & ~15ull;
+			offsets[level] = offset;
+			offset += levels[level].size();
+		}
+
+		ByteWriter file;
+		file.Bytes.insert(file.Bytes.end(), Ktx2Identifier.begin(), Ktx2Identifier.end());
+		file.U32(static_cast<uint32_t>(format));
+		file.U32(1);	// typeSize, 1 for block compressed formats
+		file.U32(width);
+		file.U32(height);
+		file.U32(0);	// pixelDepth
+		file.U32(0);	// layerCount
+		file.U32(1);	// faceCount
+		file.U32(levelCount);
+		file.U32(0);	// no supercompression
+		file.U32(dfdOffset);
+		file.U32(static_cast<uint32_t>(dfd.size()));
+		file.U32(0);	// no key/value data
+		file.U32(0);
+		file.U64(0);	// no supercompression global data
+		file.U64(0);
+
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			file.U64(offsets[level]);
+			file.U64(levels[level].size());
+			file.U64(levels[level].size());
+		}
+
+		file.Bytes.insert(file.Bytes.end(), dfd.begin(), dfd.end());
+
+		for (uint32_t level = levelCount; level-- > 0;)
+		{
+			file.Align(16);
+			file.Bytes.insert(file.Bytes.end(), levels[level].begin(), levels[level].end());
+		}
+
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out)
+			throw std::runtime_error("Failed to open " + path + " for writing.");
+
+		out.write(reinterpret_cast<const char*>(file.Bytes.data()), static_cast<std::streamsize>(file.Bytes.size()));
+		if (!out)
+			throw std::runtime_error("Failed to write " + path + ".");
+	}
+}
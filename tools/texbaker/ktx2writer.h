@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace TexBaker
+{
+	// VkFormat values, the baker doesn't pull in the Vulkan headers for three numbers
+	enum class BakeFormat : uint32_t
+	{
+		Bc5Unorm = 141,
+		Bc7Unorm = 145,
+		Bc7Srgb = 146,
+	};
+
+	// levels[0] is the full size image, each one already block compressed.
+	// Throws std::runtime_error if the file can't be written.
+	void WriteKtx2(const std::string& path, BakeFormat format, uint32_t width, uint32_t height,
+		const std::vector<std::vector<uint8_t>>& levels);
+}
@@ -0,0 +1,226 @@
+/*
+	texbaker: bakes images into block compressed KTX2 files the renderer uploads as is.
+
+		texbaker [options] <image>...
+			--normal        BC5 (X/Y) instead of BC7, mips are renormalized
+			--linear        BC7 UNORM instead of sRGB
+			--no-mips       base level only
+			--scalar        skip the SIMD kernels
+			--threads <n>   worker count, 0 is one per hardware thread
+			-o <dir>        output directory, defaults to next to the input
+			--bench         time the encoders instead of writing files
+
+	The output keeps the input's name with a .ktx2 extension, which is where
+	Image::Decode looks for a baked copy before falling back to the original.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "baker.h"
+#include "simd.h"
+
+using namespace TexBaker;
+
+static RgbaImage LoadImage(const std::string& path)
+{
+	int width, height, channels;
+	auto* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (pixels == nullptr)
+		throw std::runtime_error("Failed to load " + path + ": " + stbi_failure_reason());
+
+	RgbaImage image;
+	image.Width = static_cast<uint32_t>(width);
+	image.Height = static_cast<uint32_t>(height);
+	image.Pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+
+	stbi_image_free(pixels);
+	return image;
+}
+
+// Smooth gradients, hard edges and some noise, so the benchmark runs without any files around
+static RgbaImage MakeBenchImage(uint32_t size)
+{
+	RgbaImage image;
+	image.Width = image.Height = size;
+	image.Pixels.resize(static_cast<size_t>(size) * size * 4);
+
+	uint32_t seed = 0x12345678;
+	for (uint32_t y = 0; y < size; y++)
+	{
+		for (uint32_t x = 0; x < size; x++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			const auto noise = static_cast<int>(seed >> 28) - 8;
+			const auto checker = ((x / 37) + (y / 53)) & 1 ? 60 : 0;
+
+			auto* p = &image.Pixels[(static_cast<size_t>(y) * size + x) * 4];
+			p[0] = static_cast<uint8_t>(std::clamp(static_cast<int>(x * 255 / size) + noise, 0, 255));
+			p[1] = static_cast<uint8_t>(std::clamp(static_cast<int>(y * 255 / size) + checker + noise, 0, 255));
+			p[2] = static_cast<uint8_t>(std::clamp(128 + static_cast<int>(100 * std::sin((x + y) * 0.02)) + noise, 0, 255));
+			p[3] = 255;
+		}
+	}
+
+	return image;
+}
+
+// Over the channels the format keeps
+static double Psnr(const RgbaImage& a, const RgbaImage& b, int channels)
+{
+	double error = 0;
+	for (size_t i = 0; i < a.Pixels.size(); i += 4)
+	{
+		for (int c = 0; c < channels; c++)
+		{
+			const double d = static_cast<double>(a.Pixels[i + c]) - b.Pixels[i + c];
+			error += d * d;
+		}
+	}
+
+	const auto mse = error / (static_cast<double>(a.Pixels.size() / 4) * channels);
+	return mse > 0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+static void Benchmark(const RgbaImage& image, uint32_t threadCount)
+{
+	Engine::ThreadPool single(1);
+	Engine::ThreadPool pool(threadCount);
+
+	const auto megabytes = static_cast<double>(image.Pixels.size()) / 1e6;
+	std::printf("%ux%u RGBA8 (%.1f MB), %s kernels, %u threads\n",
+		image.Width, image.Height, megabytes, SimdName(), pool.GetThreadCount());
+
+	for (auto kind : { BakeKind::Color, BakeKind::Normal })
+	{
+		for (bool simd : { false, true })
+		{
+			// Nothing compiled in, the SIMD rows would just be the scalar ones again
+			if (simd && std::strcmp(SimdName(), "scalar") == 0)
+				continue;
+
+			for (auto* workers : { &single, &pool })
+			{
+				BakeSettings settings;
+				settings.Kind = kind;
+				settings.Simd = simd;
+
+				// Warm up once, keep the best of three
+				auto blocks = EncodeLevel(image, settings, *workers);
+				double best = 1e30;
+				for (int run = 0; run < 3; run++)
+				{
+					const auto start = std::chrono::steady_clock::now();
+					blocks = EncodeLevel(image, settings, *workers);
+					best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+				}
+
+				const auto decoded = DecodeLevel(blocks, image.Width, image.Height, settings);
+				const auto threads = workers->GetThreadCount();
+
+				std::printf("  %s %-6s %2u threads: %8.1f MB/s, %8.1f MB/s per core, %.2f dB\n",
+					kind == BakeKind::Normal ? "BC5" : "BC7",
+					simd ? SimdName() : "scalar",
+					threads,
+					megabytes / best,
+					megabytes / best / threads,
+					Psnr(image, decoded, kind == BakeKind::Normal ? 2 : 4));
+			}
+		}
+	}
+}
+
+static void PrintUsage()
+{
+	std::printf("usage: texbaker [--normal] [--linear] [--no-mips] [--scalar] [--threads n] [-o dir] <image>...\n");
+	std::printf("       texbaker --bench [--threads n] [image]\n");
+}
+
+int main(int argc, char** argv)
+{
+	BakeSettings settings;
+	uint32_t threadCount = 0;
+	bool bench = false;
+	std::filesystem::path outputDir;
+	std::vector<std::string> inputs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+
+		if (arg == "--normal")
+			settings.Kind = BakeKind::Normal;
+		else if (arg == "--linear")
+			settings.Linear = true;
+		else if (arg == "--no-mips")
+			settings.Mips = false;
+		else if (arg == "--scalar")
+			settings.Simd = false;
+		else if (arg == "--bench")
+			bench = true;
+		else if (arg == "--threads" && i + 1 < argc)
+			threadCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (arg == "-o" && i + 1 < argc)
+			outputDir = argv[++i];
+		else if (arg == "-h" || arg == "--help" || arg.starts_with("-"))
+		{
+			PrintUsage();
+			return arg.starts_with("-h") || arg == "--help" ? 0 : 1;
+		}
+		else
+			inputs.push_back(arg);
+	}
+
+	try
+	{
+		if (bench)
+		{
+			Benchmark(inputs.empty() ? MakeBenchImage(2048) : LoadImage(inputs.front()), threadCount);
+			return 0;
+		}
+
+		if (inputs.empty())
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		Engine::ThreadPool pool(threadCount);
+
+		for (const auto& input : inputs)
+		{
+			const auto image = LoadImage(input);
+
+			const auto start = std::chrono::steady_clock::now();
+			const auto baked = Bake(image, settings, pool);
+			const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			auto output = std::filesystem::path(input).replace_extension(".ktx2");
+			if (!outputDir.empty())
+				output = outputDir / output.filename();
+
+			WriteKtx2(output.string(), baked.Format, baked.Width, baked.Height, baked.Levels);
+
+			std::printf("%s -> %s: %ux%u, %zu levels, %.2fs (%.1f MB/s)\n",
+				input.c_str(), output.string().c_str(), baked.Width, baked.Height, baked.Levels.size(),
+				seconds, static_cast<double>(image.Pixels.size()) / 1e6 / seconds);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::fprintf(stderr, "texbaker: %s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// x64 builds use /arch:AVX2 (see texbaker.vcxproj), which MSVC reports with __AVX2__.
+// Anything else falls back to the scalar kernels.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TEXBAKER_AVX2 1
+#define TEXBAKER_SSE41 1
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define TEXBAKER_SSE41 1
+#endif
+
+namespace TexBaker
+{
+	inline const char* SimdName()
+	{
+#if defined(TEXBAKER_AVX2)
+		return "AVX2";
+#elif defined(TEXBAKER_SSE41)
+		return "SSE4.1";
+#else
+		return "scalar";
+#endif
+	}
+}